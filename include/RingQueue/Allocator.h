@@ -0,0 +1,409 @@
+
+#ifndef _JIMI_ALLOCATOR_H_
+#define _JIMI_ALLOCATOR_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "vs_stdint.h"
+#include "port.h"
+
+#if defined(__linux__)
+#define JIMI_HAS_HUGE_PAGES     1
+#include <unistd.h>
+#include <sys/mman.h>       // For mmap(), madvise(), mlock()
+#include <sys/syscall.h>    // For SYS_mbind
+#else
+#define JIMI_HAS_HUGE_PAGES     0
+#endif  // __linux__
+
+#if defined(__linux__) && defined(SYS_mbind)
+#define JIMI_HAS_NUMA           1
+#else
+#define JIMI_HAS_NUMA           0
+#endif
+
+#if defined(_WIN32) || defined(__MINGW32__)
+#include <malloc.h>         // For _aligned_malloc()
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <new>              // For placement new
+
+///
+/// The allocators of the ring storage (the entries and the flag arrays),
+/// pass one of them as the Allocator template parameter of the queue.
+///
+/// An allocator must provide:
+///
+///   static void * allocate(size_t size);
+///
+///       Returns size bytes aligned to JIMI_CACHELINE_SIZE at least, or NULL.
+///       The memory may hold garbage, the queue constructs (or clears) its
+///       entries in place, see new_array().
+///
+///   static void deallocate(void * p, size_t size);
+///
+///       Release the memory of allocate(), with the same size.
+///
+
+namespace jimi {
+
+///////////////////////////////////////////////////////////////////
+// class HeapAllocator
+///////////////////////////////////////////////////////////////////
+
+///
+/// Cache line aligned memory from the system heap, the default allocator.
+///
+class HeapAllocator
+{
+public:
+    static const size_t kAlignment = JIMI_CACHELINE_SIZE;
+
+    static void * allocate(size_t size) {
+#if defined(_WIN32) || defined(__MINGW32__)
+        return _aligned_malloc(size, kAlignment);
+#else
+        void * p;
+        if (posix_memalign(&p, kAlignment, size) != 0)
+            return NULL;
+        return p;
+#endif
+    }
+
+    static void deallocate(void * p, size_t /* size */) {
+#if defined(_WIN32) || defined(__MINGW32__)
+        _aligned_free(p);
+#else
+        ::free(p);
+#endif
+    }
+};
+
+typedef HeapAllocator   DefaultAllocator;
+
+///////////////////////////////////////////////////////////////////
+// class HugePageAllocator<Flags>
+///////////////////////////////////////////////////////////////////
+
+enum PageAllocFlags {
+    // Back the memory with 2 MB pages.
+    PAGE_ALLOC_HUGE     = 0x01,
+    // Fault all the pages in at allocation time, not on the first pass.
+    PAGE_ALLOC_POPULATE = 0x02,
+    // mlock() the pages, so they are never swapped out.
+    PAGE_ALLOC_LOCK     = 0x04
+};
+
+///
+/// Anonymous mmap() memory for big rings (Linux only, the heap elsewhere).
+///
+/// With PAGE_ALLOC_HUGE it first tries MAP_HUGETLB, which needs pages
+/// reserved in /proc/sys/vm/nr_hugepages. If there are none, it maps
+/// 2 MB aligned normal pages and asks for transparent huge pages with
+/// madvise(MADV_HUGEPAGE). PAGE_ALLOC_POPULATE pre-faults the pages, and
+/// PAGE_ALLOC_LOCK mlock()s them, an mlock() over RLIMIT_MEMLOCK is
+/// silently ignored. The size is rounded up to whole huge pages.
+///
+template <uint32_t Flags = PAGE_ALLOC_HUGE>
+class HugePageAllocator
+{
+public:
+    static const size_t kHugePageSize = 2 * 1024 * 1024;
+    static const size_t kPageSize     = 4096;
+
+    static size_t round_size(size_t size) {
+        return (size + kHugePageSize - 1) & ~(kHugePageSize - 1);
+    }
+
+    static void * allocate(size_t size) {
+#if defined(JIMI_HAS_HUGE_PAGES) && (JIMI_HAS_HUGE_PAGES != 0)
+        size_t allocSize, offset;
+        char * base;
+        void * p = MAP_FAILED;
+        int mapFlags;
+
+        allocSize = round_size(size);
+        mapFlags = MAP_PRIVATE | MAP_ANONYMOUS;
+        if ((Flags & PAGE_ALLOC_POPULATE) != 0)
+            mapFlags |= MAP_POPULATE;
+
+#if defined(MAP_HUGETLB)
+        if ((Flags & PAGE_ALLOC_HUGE) != 0)
+            p = mmap(NULL, allocSize, PROT_READ | PROT_WRITE, mapFlags | MAP_HUGETLB, -1, 0);
+#endif
+        if (p == MAP_FAILED) {
+            // Map one more huge page, then trim it to a 2 MB aligned range,
+            // only whole aligned ranges can become transparent huge pages.
+            base = (char *)mmap(NULL, allocSize + kHugePageSize, PROT_READ | PROT_WRITE,
+                                mapFlags & ~MAP_POPULATE, -1, 0);
+            if (base == (char *)MAP_FAILED)
+                return NULL;
+
+            offset = (kHugePageSize - ((uintptr_t)base & (kHugePageSize - 1))) & (kHugePageSize - 1);
+            if (offset > 0)
+                munmap(base, offset);
+            munmap(base + offset + allocSize, kHugePageSize - offset);
+            p = (void *)(base + offset);
+
+#if defined(MADV_HUGEPAGE)
+            if ((Flags & PAGE_ALLOC_HUGE) != 0)
+                madvise(p, allocSize, MADV_HUGEPAGE);
+#endif
+            if ((Flags & PAGE_ALLOC_POPULATE) != 0)
+                populate(p, allocSize);
+        }
+
+        if ((Flags & PAGE_ALLOC_LOCK) != 0)
+            mlock(p, allocSize);
+        return p;
+#else
+        return HeapAllocator::allocate(size);
+#endif
+    }
+
+    static void deallocate(void * p, size_t size) {
+#if defined(JIMI_HAS_HUGE_PAGES) && (JIMI_HAS_HUGE_PAGES != 0)
+        if (p != NULL)
+            munmap(p, round_size(size));
+#else
+        HeapAllocator::deallocate(p, size);
+#endif
+    }
+
+protected:
+    // Write one byte per page, after madvise(), so the faults get huge pages.
+    static void populate(void * p, size_t size) {
+        volatile char * addr = (volatile char *)p;
+        size_t offset;
+        for (offset = 0; offset < size; offset += kPageSize)
+            addr[offset] = 0;
+    }
+};
+
+///////////////////////////////////////////////////////////////////
+// class NumaAllocator<Mode, Node>
+///////////////////////////////////////////////////////////////////
+
+// The same values as MPOL_PREFERRED, MPOL_BIND and MPOL_INTERLEAVE.
+enum NumaAllocMode {
+    // Prefer Node, use another node when it's full.
+    NUMA_ALLOC_PREFERRED    = 1,
+    // Only Node.
+    NUMA_ALLOC_BIND         = 2,
+    // Spread the pages over all the nodes, Node is not used.
+    NUMA_ALLOC_INTERLEAVE   = 3
+};
+
+///
+/// Anonymous mmap() memory placed with mbind() before the first touch
+/// (Linux only, through the system call, libnuma is not needed). If
+/// mbind() fails (no such node, or no NUMA support), the memory is
+/// returned unbound, and the pages go to the node which touches them
+/// first, like HeapAllocator.
+///
+/// For first-touch placement, use HeapAllocator and construct the queue
+/// on a thread running on the node, the queue writes all its entries in
+/// the constructor.
+///
+template <uint32_t Mode = NUMA_ALLOC_BIND, uint32_t Node = 0>
+class NumaAllocator
+{
+public:
+    static const size_t kPageSize = 4096;
+
+    static size_t round_size(size_t size) {
+        return (size + kPageSize - 1) & ~(kPageSize - 1);
+    }
+
+    static void * allocate(size_t size) {
+#if defined(JIMI_HAS_NUMA) && (JIMI_HAS_NUMA != 0)
+        size_t allocSize = round_size(size);
+        unsigned long nodeMask;
+        void * p;
+
+        p = mmap(NULL, allocSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            return NULL;
+
+        if (Mode == NUMA_ALLOC_INTERLEAVE)
+            nodeMask = ~0UL;
+        else if (Node < sizeof(nodeMask) * 8)
+            nodeMask = 1UL << Node;
+        else
+            return p;
+
+        // The kernel reads (maxnode - 1) bits of the mask.
+        syscall(SYS_mbind, p, allocSize, (unsigned long)Mode, &nodeMask,
+                (unsigned long)(sizeof(nodeMask) * 8 + 1), 0UL);
+        return p;
+#else
+        return HeapAllocator::allocate(size);
+#endif
+    }
+
+    static void deallocate(void * p, size_t size) {
+#if defined(JIMI_HAS_NUMA) && (JIMI_HAS_NUMA != 0)
+        if (p != NULL)
+            munmap(p, round_size(size));
+#else
+        HeapAllocator::deallocate(p, size);
+#endif
+    }
+};
+
+///////////////////////////////////////////////////////////////////
+// class ArenaAllocator<Tag>
+///////////////////////////////////////////////////////////////////
+
+///
+/// Carves the queues out of one big block, so hundreds of queues cost a
+/// single allocation. Call init() before constructing the first queue,
+/// allocate() just bumps an offset (lock-free, cache line aligned) and
+/// returns NULL when the arena is used up. deallocate() does nothing,
+/// the whole block goes back with release(), after all the queues of the
+/// arena are destroyed. Each Tag is a separate arena.
+///
+template <uint32_t Tag = 0, typename BlockAllocator = HeapAllocator>
+class ArenaAllocator
+{
+public:
+    static const size_t kAlignment = JIMI_CACHELINE_SIZE;
+
+    static int init(size_t size) {
+        if (base != NULL)
+            return -1;
+        base = (char *)BlockAllocator::allocate(size);
+        if (base == NULL)
+            return -1;
+        capacity = size;
+        offset = 0;
+        return 0;
+    }
+
+    static void release() {
+        if (base != NULL) {
+            BlockAllocator::deallocate((void *)base, capacity);
+            base = NULL;
+            capacity = 0;
+            offset = 0;
+        }
+    }
+
+    static size_t used()  { return (size_t)offset; }
+    static size_t size()  { return capacity; }
+
+    static void * allocate(size_t size) {
+        uint64_t oldOffset, newOffset;
+
+        size = (size + kAlignment - 1) & ~(kAlignment - 1);
+        do {
+            oldOffset = offset;
+            newOffset = oldOffset + size;
+            if (base == NULL || newOffset > (uint64_t)capacity)
+                return NULL;
+        } while (jimi_val_compare_and_swap64u(&offset, oldOffset, newOffset) != oldOffset);
+
+        return (void *)(base + oldOffset);
+    }
+
+    static void deallocate(void * /* p */, size_t /* size */) {
+        // Do nothing!
+    }
+
+protected:
+    static char *               base;
+    static size_t               capacity;
+    static volatile uint64_t    offset;
+};
+
+template <uint32_t Tag, typename BlockAllocator>
+char * ArenaAllocator<Tag, BlockAllocator>::base = NULL;
+
+template <uint32_t Tag, typename BlockAllocator>
+size_t ArenaAllocator<Tag, BlockAllocator>::capacity = 0;
+
+template <uint32_t Tag, typename BlockAllocator>
+volatile uint64_t ArenaAllocator<Tag, BlockAllocator>::offset = 0;
+
+///////////////////////////////////////////////////////////////////
+// new_array<T, Allocator>(), delete_array<T, Allocator>()
+///////////////////////////////////////////////////////////////////
+
+///
+/// Allocate an array of count T with Allocator, and default-construct the
+/// items in place, unless T has a trivial default constructor (like
+/// new T[count], the items then hold garbage).
+///
+template <typename T, typename Allocator>
+inline T * new_array(size_t count)
+{
+    T * items = (T *)Allocator::allocate(sizeof(T) * count);
+    size_t i;
+
+    if (items != NULL && !JIMI_IS_TRIVIALLY_CONSTRUCTIBLE(T)) {
+        for (i = 0; i < count; ++i)
+            new ((void *)&items[i]) T();
+    }
+    return items;
+}
+
+template <typename T, typename Allocator>
+inline void delete_array(T * items, size_t count)
+{
+    size_t i;
+
+    if (items == NULL)
+        return;
+
+    if (!JIMI_IS_TRIVIALLY_DESTRUCTIBLE(T)) {
+        for (i = 0; i < count; ++i)
+            items[i].~T();
+    }
+    Allocator::deallocate((void *)items, sizeof(T) * count);
+}
+
+///
+/// Zero the items of a POD T. The events which own resources (e.g.
+/// std::string) are left as new_array() constructed them.
+///
+template <typename T>
+inline void clear_array(T * items, size_t count)
+{
+    if (JIMI_IS_POD(T))
+        memset((void *)items, 0, sizeof(T) * count);
+}
+
+#if defined(JIMI_HAS_CXX11_MOVE) && (JIMI_HAS_CXX11_MOVE != 0)
+
+///
+/// Replace the live T in slot with T(args...), built in place. The slots
+/// of the queues always hold a live T (they are destroyed by delete_array()),
+/// so if the constructor throws, a default T is put back in the slot before
+/// the exception goes on to the caller.
+///
+template <typename T, typename ...Args>
+inline void reconstruct_at(T * slot, Args && ... args)
+{
+    slot->~T();
+#if defined(JIMI_HAS_EXCEPTIONS) && (JIMI_HAS_EXCEPTIONS != 0)
+    try {
+        new ((void *)slot) T(std::forward<Args>(args)...);
+    }
+    catch (...) {
+        new ((void *)slot) T();
+        throw;
+    }
+#else
+    new ((void *)slot) T(std::forward<Args>(args)...);
+#endif
+}
+
+#endif  /* JIMI_HAS_CXX11_MOVE */
+
+}  /* namespace jimi */
+
+#endif  /* _JIMI_ALLOCATOR_H_ */
@@ -0,0 +1,83 @@
+
+#ifndef _JIMI_CLAIM_STRATEGY_H_
+#define _JIMI_CLAIM_STRATEGY_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "vs_stdint.h"
+#include "port.h"
+#include "sleep.h"
+
+#include "WaitStrategy.h"
+
+///
+/// The claim strategies used by the producers of DisruptorRingQueue,
+/// pass one of them as the ClaimStrategy template parameter of the queue.
+/// They only matter with more than one producer, the single producer
+/// never touches the cursor before publish().
+///
+/// A claim strategy must provide:
+///
+///   static const bool kUseFetchAndAdd;
+///
+///       false: claim with a CAS retry loop on the cursor, the claim fails
+///              (push() returns -1) if the ring is full.
+///       true:  claim with a single fetch-and-add on the cursor, then wait
+///              until the claimed slots are free.
+///
+///   static void backoff(uint32_t & loop_cnt);
+///
+///       Called while a fetch-and-add producer waits for its claimed slots.
+///
+
+namespace jimi {
+
+///////////////////////////////////////////////////////////////////
+// class CasClaimStrategy
+///////////////////////////////////////////////////////////////////
+
+///
+/// The original claim loop of DisruptorRingQueue::push(), it's the default
+/// claim strategy. Under heavy producer contention, most of the time is
+/// spent in failed CAS attempts.
+///
+class CasClaimStrategy
+{
+public:
+    static const bool kUseFetchAndAdd = false;
+
+    static void backoff(uint32_t & /* loop_cnt */) {
+        // Do nothing!
+    }
+};
+
+///////////////////////////////////////////////////////////////////
+// class FetchAddClaimStrategy<SpinCount>
+///////////////////////////////////////////////////////////////////
+
+///
+/// Claim with one atomic fetch-and-add, every producer succeeds on the
+/// first try. The producer checks the gating sequence before the claim,
+/// so it doesn't claim into a full ring, but another producer may still
+/// claim in between, then it waits for the consumers after the claim
+/// (spin SpinCount times, then yield) instead of giving up, a claimed
+/// sequence must always be published.
+///
+template <uint32_t SpinCount = 64>
+class FetchAddClaimStrategy
+{
+public:
+    static const bool kUseFetchAndAdd = true;
+
+    static void backoff(uint32_t & loop_cnt) {
+        spin_yield_backoff(loop_cnt, SpinCount);
+    }
+};
+
+typedef CasClaimStrategy    DefaultClaimStrategy;
+
+}  /* namespace jimi */
+
+#endif  /* _JIMI_CLAIM_STRATEGY_H_ */
@@ -23,8 +23,15 @@
 #include <intrin.h>     // For _ReadWriteBarrier(), InterlockedCompareExchange()
 #endif  // _MSC_VER
 #include <emmintrin.h>
+#if defined(__AVX2__)
+#include <immintrin.h>  // For AVX2
+#endif  // __AVX2__
 
 #include "Sequence.h"
+#include "SequenceBarrier.h"
+#include "WaitStrategy.h"
+#include "ClaimStrategy.h"
+#include "Allocator.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -35,14 +42,22 @@
 #define JIMI_ALIGNED_TO(n, alignment)   \
     (((n) + ((alignment) - 1)) & ~(size_t)((alignment) - 1))
 
+// Scan availableBuffer with SSE2 (or AVX2) in getHighestPublishedSequence()
+#ifndef DISRUPTOR_SIMD_SCAN
+#define DISRUPTOR_SIMD_SCAN             1
+#endif
+
 namespace jimi {
 
 ///////////////////////////////////////////////////////////////////
-// class DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>
+// class DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>
 ///////////////////////////////////////////////////////////////////
 
 template <typename T, typename SequenceType = int64_t, uint32_t Capacity = 1024U,
-          uint32_t Producers = 0, uint32_t Consumers = 0, uint32_t NumThreads = 0>
+          uint32_t Producers = 0, uint32_t Consumers = 0, uint32_t NumThreads = 0,
+          typename WaitStrategy = DefaultWaitStrategy,
+          typename ClaimStrategy = DefaultClaimStrategy,
+          typename Allocator = HeapAllocator>
 class DisruptorRingQueue
 {
 public:
@@ -57,6 +72,10 @@ public:
     typedef uint32_t                    index_type;
     typedef SequenceType                sequence_type;
     typedef SequenceBase<SequenceType>  Sequence;
+    typedef WaitStrategy                wait_strategy_type;
+    typedef ClaimStrategy               claim_strategy_type;
+    typedef Allocator                   allocator_type;
+    typedef SequenceBarrier<SequenceType> barrier_type;
 
     
     typedef item_type *                 pointer;
@@ -77,6 +96,44 @@ public:
     static const size_type  kConsumersAlloc = (Consumers <= 1) ? 1 : ((Consumers + 1) & ((size_type)(~1U)));
     static const bool       kIsAllocOnHeap  = true;
 
+    ///
+    /// Only one thread pushes (Producers == 1): the producer claims the
+    /// sequences with a plain store to nextValue, and publishes them by
+    /// advancing the cursor, so the consumers can trust the cursor and
+    /// skip the getHighestPublishedSequence() scan of availableBuffer.
+    ///
+    static const bool       kIsSingleProducer = (Producers == 1);
+
+    ///
+    /// The multi-producer claim: a CAS retry loop on the cursor (default),
+    /// or a single fetch-and-add, see ClaimStrategy.h.
+    ///
+    static const bool       kUseFetchAndAdd = ClaimStrategy::kUseFetchAndAdd;
+
+    ///
+    /// Only one thread pops (Consumers == 1): the consumer keeps its position
+    /// in consumedValue, without the CAS on workSequence, and publishes its
+    /// progress to the producers through workSequence, once per kReleaseBatch
+    /// events or at the end of the available batch. The producers' gating
+    /// check is then a single load of workSequence.
+    ///
+    /// process() is not supported, a pipeline always has more than one consumer,
+    /// except in consume() of the only consumer group (see addConsumerGroup()).
+    ///
+    static const bool       kIsSingleConsumer = (Consumers == 1);
+    static const size_type  kReleaseBatch     = (size_type)JIMI_MAX(kCapacity / 4, 1);
+
+    /// pop() and drain() return it after shutdown(), when all the published
+    /// events have been consumed, the consumer thread can exit now.
+    static const int        kHalted         = -2;
+
+    /// The producerId of push(), push_n(), claim() and tryNext() when the
+    /// producer has no slot from registerProducer(): the calling thread's own
+    /// slot (see localProducerId()), or the gating sequence cache shared by
+    /// all the producers.
+    static const int        kLocalProducer  = -1;
+    static const int        kSharedProducer = -2;
+
     struct PopThreadStackData
     {
         Sequence *      tailSequence;
@@ -107,64 +164,135 @@ public:
     void init_queue(bool bFillQueue = true);
 
     void start();
-    void shutdown(int32_t timeOut = -1);
+    int  shutdown(int32_t timeOut = -1);
+    bool isAlerted() const      { return (this->alerted != 0); };
+    bool isDrained() const      { return (getTailSequence() >= this->cursor.get()); };
 
     Sequence *getGatingSequences(int index);
 
+    int addConsumerGroup();
+    Sequence *getGroupSequence(int group);
+    uint32_t consumerGroups() const { return this->numGroups; };
+
     void publish(sequence_type sequence);
+    void publish(sequence_type lowerBound, sequence_type upperBound);
     void setAvailable(sequence_type sequence);
     bool isAvailable(sequence_type sequence);
     sequence_type getHighestPublishedSequence(sequence_type lowerBound,
                                               sequence_type availableSequence);
+    sequence_type getHighestPublishedSequenceScalar(sequence_type lowerBound,
+                                                    sequence_type availableSequence);
+    sequence_type getHighestPublishedSequenceSimd(sequence_type lowerBound,
+                                                  sequence_type availableSequence);
+
+    static index_type findFirstUnavailable(const flag_type * flags, index_type count, flag_type flag);
+
+    int registerProducer();
+    int localProducerId();
+    bool hasAvailableCapacity(sequence_type wrapPoint, sequence_type current, int producerId);
+    int tryNext(size_type n, sequence_type & nextSequence, int producerId = -1);
 
     int push(const T & entry);
+    int push(const T & entry, int producerId);
+    int push_n(const T * first, size_type n, int producerId = -1);
     int pop (T & entry, PopThreadStackData & data);
 
+#if defined(JIMI_HAS_CXX11_MOVE) && (JIMI_HAS_CXX11_MOVE != 0)
+    int push(T && entry);
+
+    template <typename ...Args>
+    int emplace(Args && ... args);
+#endif  /* JIMI_HAS_CXX11_MOVE */
+
+    T * claim(sequence_type & sequence, int producerId = -1);
+    void commit(sequence_type sequence);
+    int peek(const T * & entry, PopThreadStackData & data);
+    void release(PopThreadStackData & data);
+    void releaseProgress(const PopThreadStackData & data);
+
+    template <typename EventHandler>
+    int drain(EventHandler & handler, PopThreadStackData & data, size_type maxBatch = kCapacity);
+
+    template <typename EventHandler>
+    int process(EventHandler & handler, const barrier_type & barrier, Sequence & sequence,
+                size_type maxBatch = kCapacity);
+
+    template <typename EventHandler>
+    int consume(EventHandler & handler, int group, size_type maxBatch = kCapacity);
+
     sequence_type waitFor(sequence_type sequence);
 
+protected:
+    sequence_type getTailSequence() const;
+
 protected:
     Sequence        cursor, workSequence;
     Sequence        gatingSequences[kConsumersAlloc];
     Sequence        gatingSequenceCache;
     Sequence        gatingSequenceCaches[kProducersAlloc];
 
+    wait_strategy_type  waitStrategy;
+
+    volatile uint32_t   registeredProducers;
+    volatile uint32_t   numGroups;
+    char                padding0[JIMI_CACHELINE_SIZE - sizeof(uint32_t) * 2];
+
+    volatile uint32_t   alerted;
+    char                padding1[JIMI_CACHELINE_SIZE - sizeof(uint32_t) * 1];
+
+    // The last claimed sequence, only used by the single producer.
+    sequence_type       nextValue;
+    char                padding2[JIMI_CACHELINE_SIZE - sizeof(sequence_type) * 1];
+
+    // The last consumed sequence, only used by the single consumer.
+    sequence_type       consumedValue;
+    char                padding3[JIMI_CACHELINE_SIZE - sizeof(sequence_type) * 1];
+
     item_type *     entries;
     flag_type *     availableBuffer;
 };
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
-DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::DisruptorRingQueue(bool bFillQueue /* = true */)
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::DisruptorRingQueue(bool bFillQueue /* = true */)
 {
     init(bFillQueue);
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
-DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::~DisruptorRingQueue()
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::~DisruptorRingQueue()
 {
     // If the queue is allocated on system heap, release them.
     if (kIsAllocOnHeap) {
         if (this->availableBuffer) {
-            delete [] this->availableBuffer;
+            delete_array<flag_type, Allocator>(this->availableBuffer, kCapacity);
             this->availableBuffer = NULL;
         }
 
         if (this->entries != NULL) {
-            delete [] this->entries;
+            delete_array<item_type, Allocator>(this->entries, kCapacity);
             this->entries = NULL;
         }
     }
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
 inline
-void DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::init(bool bFillQueue /* = true */)
+void DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::init(bool bFillQueue /* = true */)
 {
     this->cursor.set(Sequence::INITIAL_CURSOR_VALUE);
     this->workSequence.set(Sequence::INITIAL_CURSOR_VALUE);
+    this->nextValue = Sequence::INITIAL_CURSOR_VALUE;
+    this->consumedValue = Sequence::INITIAL_CURSOR_VALUE;
+    this->alerted = 0;
+    this->registeredProducers = 0;
+    this->numGroups = 0;
 
     for (int i = 0; i < kConsumersAlloc; ++i) {
         this->gatingSequences[i].set(Sequence::INITIAL_CURSOR_VALUE);
     }
+    for (int i = 0; i < kProducersAlloc; ++i) {
+        this->gatingSequenceCaches[i].set(Sequence::INITIAL_CURSOR_VALUE);
+    }
 
     init_queue(bFillQueue);
 
@@ -181,20 +309,20 @@ void DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThre
 #endif  /* _DEBUG */
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
 inline
-void DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::init_queue(bool bFillQueue /* = true */)
+void DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::init_queue(bool bFillQueue /* = true */)
 {
-    item_type *newData = new T[kCapacity];
+    item_type *newData = new_array<item_type, Allocator>(kCapacity);
     if (newData != NULL) {
         if (bFillQueue) {
-            memset((void *)newData, 0, sizeof(item_type) * kCapacity);
+            clear_array(newData, kCapacity);
         }
         Jimi_MemoryBarrier();
         this->entries = newData;
     }
 
-    flag_type *newBufferData = new flag_type[kCapacity];
+    flag_type *newBufferData = new_array<flag_type, Allocator>(kCapacity);
     if (newBufferData != NULL) {
         if (bFillQueue) {
             //memset((void *)newBufferData, 0, sizeof(flag_type) * kCapacity);
@@ -207,15 +335,15 @@ void DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThre
     }
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
-void DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::dump()
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+void DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::dump()
 {
     //ReleaseUtils::dump(&core, sizeof(core));
     dump_memory(this, sizeof(*this), false, 16, 0, 0);
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
-void DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::dump_detail()
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+void DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::dump_detail()
 {
     printf("---------------------------------------------------------\n");
     printf("DisruptorRingQueue: (head = %llu, tail = %llu)\n",
@@ -225,56 +353,85 @@ void DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThre
     printf("\n");
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
 inline
-typename DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::size_type
-DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::sizes() const
+typename DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::size_type
+DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::sizes() const
 {
     sequence_type head, tail;
 
     Jimi_ReadCompilerBarrier();
 
     head = this->cursor.get();
-    tail = this->workSequence.get();
+    tail = getTailSequence();
 
     return (size_type)((head - tail) <= kIndexMask) ? (head - tail) : (size_type)(-1);
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
 inline
-void DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::start()
+void DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::start()
 {
     sequence_type cursor = this->cursor.get();
     this->workSequence.set(cursor);
     this->gatingSequenceCache.set(cursor);
+    this->nextValue = cursor;
+    this->consumedValue = cursor;
+    this->alerted = 0;
 
     int i;
     for (i = 0; i < kConsumersAlloc; ++i) {
         this->gatingSequences[i].set(cursor);
     }
-    /*
     for (i = 0; i < kProducersAlloc; ++i) {
         this->gatingSequenceCaches[i].set(cursor);
     }
-    //*/
+
+    // With consumer groups, only the groups' sequences gate the producers,
+    // the unused ones must never hold them back.
+    if (this->numGroups > 0 && !kIsSingleConsumer) {
+        this->workSequence.setMaxValue();
+        for (i = this->numGroups; i < kConsumersAlloc; ++i) {
+            this->gatingSequences[i].setMaxValue();
+        }
+    }
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+///
+/// Alert all the consumers, and wake up the ones blocked in waitFor().
+/// The consumers still consume all the published events, then pop() and
+/// drain() return kHalted instead of waiting on an empty queue.
+///
+/// Call it after the producers have stopped. It waits until every consumer
+/// (or consumer group) is done with the published events, see
+/// getTailSequence() and wait_until_drained().
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
 inline
-void DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::shutdown(int32_t timeOut /* = -1 */)
+int DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::shutdown(int32_t timeOut /* = -1 */)
 {
-    // TODO: do shutdown procedure
+    this->alerted = 1;
+    Jimi_MemoryBarrier();
+    this->waitStrategy.signalAllWhenBlocking();
+
+    return wait_until_drained(*this, timeOut);
 }
 
 /* static */
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
 inline
-typename DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::sequence_type
-DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::
+typename DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::sequence_type
+DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::
     getMinimumSequence(const Sequence *sequences, const Sequence &workSequence, sequence_type mininum)
 {
     assert(sequences != NULL);
 
+    if (kIsSingleConsumer) {
+        // Only the single consumer advances workSequence.
+        sequence_type cachedWorkSequence = workSequence.get();
+        return (cachedWorkSequence < mininum) ? cachedWorkSequence : mininum;
+    }
+
 #if 0
     sequence_type minSequence = sequences->get();
     for (int i = 1; i < kConsumers; ++i) {
@@ -317,18 +474,45 @@ DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>:
     return minSequence;
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+inline
+void DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::publish(sequence_type sequence)
+{
+    Jimi_WriteCompilerBarrier();
+
+    if (kIsSingleProducer) {
+        // The event is written, let the consumers see it.
+        this->cursor.setOrder(sequence);
+    }
+    else {
+        setAvailable(sequence);
+    }
+
+    this->waitStrategy.signalAllWhenBlocking();
+}
+
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
 inline
-void DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::publish(sequence_type sequence)
+void DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::publish(sequence_type lowerBound,
+                                                                                                                           sequence_type upperBound)
 {
     Jimi_WriteCompilerBarrier();
 
-    setAvailable(sequence);
+    if (kIsSingleProducer) {
+        this->cursor.setOrder(upperBound);
+    }
+    else {
+        // Mark the whole claimed range [lowerBound, upperBound] in one pass.
+        for (sequence_type sequence = lowerBound; sequence <= upperBound; ++sequence) {
+            setAvailable(sequence);
+        }
+    }
+    this->waitStrategy.signalAllWhenBlocking();
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
 inline
-void DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::setAvailable(sequence_type sequence)
+void DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::setAvailable(sequence_type sequence)
 {
     index_type index = (index_type)((index_type)sequence &  kIndexMask);
     flag_type  flag  = (flag_type) (            sequence >> kIndexShift);
@@ -340,9 +524,9 @@ void DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThre
     this->availableBuffer[index] = flag;
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
 inline
-bool DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::isAvailable(sequence_type sequence)
+bool DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::isAvailable(sequence_type sequence)
 {
     index_type index = (index_type)((index_type)sequence &  kIndexMask);
     flag_type  flag  = (flag_type) (            sequence >> kIndexShift);
@@ -352,11 +536,27 @@ bool DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThre
     return (flagValue == flag);
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
 inline
-typename DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::sequence_type
-DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::
+typename DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::sequence_type
+DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::
         getHighestPublishedSequence(sequence_type lowerBound, sequence_type availableSequence)
+{
+#if defined(DISRUPTOR_SIMD_SCAN) && (DISRUPTOR_SIMD_SCAN != 0)
+    // A short range is not worth setting up the vectors.
+    if ((availableSequence - lowerBound) < (sequence_type)8)
+        return getHighestPublishedSequenceScalar(lowerBound, availableSequence);
+    return getHighestPublishedSequenceSimd(lowerBound, availableSequence);
+#else
+    return getHighestPublishedSequenceScalar(lowerBound, availableSequence);
+#endif
+}
+
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+inline
+typename DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::sequence_type
+DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::
+        getHighestPublishedSequenceScalar(sequence_type lowerBound, sequence_type availableSequence)
 {
     for (sequence_type sequence = lowerBound; sequence <= availableSequence; ++sequence) {
         if (!isAvailable(sequence)) {
@@ -367,73 +567,366 @@ DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>:
     return availableSequence;
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
-typename DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::Sequence *
-DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::getGatingSequences(int index)
+///
+/// Same as getHighestPublishedSequenceScalar(), but compares 4 (SSE2) or
+/// 8 (AVX2) flags at a time. All the slots from the index of a sequence to
+/// the end of availableBuffer expect the same round flag, so the range is
+/// scanned in at most two runs: before and after the ring wraps around.
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+inline
+typename DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::sequence_type
+DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::
+        getHighestPublishedSequenceSimd(sequence_type lowerBound, sequence_type availableSequence)
 {
-    if (index >= 0 && index < kCapacity) {
+    sequence_type sequence = lowerBound;
+    while (sequence <= availableSequence) {
+        index_type index = (index_type)((index_type)sequence &  kIndexMask);
+        flag_type  flag  = (flag_type) (            sequence >> kIndexShift);
+
+        index_type count = kCapacity - index;
+        if ((availableSequence - sequence) < (sequence_type)count)
+            count = (index_type)(availableSequence - sequence) + 1;
+
+        index_type matched = findFirstUnavailable(&this->availableBuffer[index], count, flag);
+        Jimi_ReadCompilerBarrier();
+        if (matched < count)
+            return (sequence + (sequence_type)matched - 1);
+
+        sequence += (sequence_type)count;
+    }
+
+    return availableSequence;
+}
+
+/* static */
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+inline
+typename DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::index_type
+DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::
+        findFirstUnavailable(const flag_type * flags, index_type count, flag_type flag)
+{
+    index_type i = 0;
+#if defined(__AVX2__)
+    __m256i flag8 = _mm256_set1_epi32((int)flag);
+    for (; (i + 8) <= count; i += 8) {
+        __m256i values = _mm256_loadu_si256((const __m256i *)(flags + i));
+        uint32_t mask = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(values, flag8)));
+        if (mask != 0xFFU)
+            return (i + jimi_bsf32(~mask & 0xFFU));
+    }
+#endif  /* __AVX2__ */
+    __m128i flag4 = _mm_set1_epi32((int)flag);
+    for (; (i + 4) <= count; i += 4) {
+        __m128i values = _mm_loadu_si128((const __m128i *)(flags + i));
+        uint32_t mask = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(values, flag4)));
+        if (mask != 0x0FU)
+            return (i + jimi_bsf32(~mask & 0x0FU));
+    }
+    for (; i < count; ++i) {
+        if (flags[i] != flag)
+            return i;
+    }
+    return count;
+}
+
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+typename DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::Sequence *
+DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::getGatingSequences(int index)
+{
+    if (index >= 0 && index < (int)kConsumersAlloc) {
         return &this->gatingSequences[index];
     }
     return NULL;
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
 inline
-int DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::push(const T & entry)
+int DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::push(const T & entry)
 {
-    sequence_type current, nextSequence;
-    do {
-        current = this->cursor.get();
-        nextSequence = current + 1;
+    sequence_type nextSequence;
+    // tryNext() gives each producer thread its own gating sequence cache.
+    if (tryNext(1, nextSequence) != 0) {
+        // Push() failed, maybe queue is full.
+        return -1;
+    }
 
-        //sequence_type wrapPoint = nextSequence - kCapacity;
-        sequence_type wrapPoint = current - kIndexMask;
-        sequence_type cachedGatingSequence = this->gatingSequenceCache.get();
-
-        if (wrapPoint > cachedGatingSequence || cachedGatingSequence > current) {
-        //if ((current - cachedGatingSequence) >= kIndexMask) {
-            sequence_type gatingSequence = DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>
-                                            ::getMinimumSequence(this->gatingSequences, this->workSequence, current);
-            //current = this->cursor.get();
-            if (wrapPoint > gatingSequence) {
-            //if ((current - gatingSequence) >= kIndexMask) {
-                // Push() failed, maybe queue is full.
-                //this->gatingSequenceCaches[id].set(gatingSequence);
-#if 0
-                for (int i = 2; i > 0; --i)
-                    jimi_mm_pause();
-                continue;
+    this->entries[nextSequence & kIndexMask] = entry;
+    publish(nextSequence);
+    return 0;
+}
+
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+inline
+int DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::push(const T & entry, int producerId)
+{
+    sequence_type nextSequence;
+    if (tryNext(1, nextSequence, producerId) != 0) {
+        // Push() failed, maybe queue is full.
+        return -1;
+    }
+
+    this->entries[nextSequence & kIndexMask] = entry;
+    publish(nextSequence);
+    return 0;
+}
+
+///
+/// Give the calling producer thread its own gating sequence cache slot.
+/// Call it once per producer thread, then pass the slot to push(), push_n(),
+/// claim() or tryNext(). Returns -1 if all the kProducersAlloc slots are taken,
+/// the producer then uses the shared cache.
+/// The producers which pass no slot get one implicitly, see localProducerId().
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+inline
+int DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::registerProducer()
+{
+    uint32_t producerId = jimi_fetch_and_add32(&this->registeredProducers, 1);
+    if (producerId >= kProducersAlloc)
+        return -1;
+    return (int)producerId;
+}
+
+///
+/// The gating sequence cache slot of the calling thread, for the producers
+/// which don't pass one (push(entry), push_n(), claim() and tryNext() with
+/// producerId = kLocalProducer). It's registered on the thread's first claim and kept
+/// in thread local storage for the last queue the thread pushed to, so a
+/// thread which switches between queues registers again on each switch.
+/// Returns -1 when all the slots are taken, the thread then uses the shared
+/// cache. Two threads
+/// ending up on one slot (e.g. a new queue at the address of a deleted one)
+/// is only slower: every cache holds a sequence the consumers have passed.
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+inline
+int DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::localProducerId()
+{
+#if defined(JIMI_HAS_THREAD_LOCAL) && (JIMI_HAS_THREAD_LOCAL != 0)
+    static JIMI_THREAD_LOCAL const void *   localQueue = NULL;
+    static JIMI_THREAD_LOCAL int            localId = -1;
+
+    if (localQueue != (const void *)this) {
+        localQueue = (const void *)this;
+        localId = registerProducer();
+    }
+    return localId;
 #else
-                return -1;
+    return -1;
 #endif
-            }
+}
 
-            this->gatingSequenceCache.setOrder(gatingSequence);
+///
+/// Add a consumer group, returns the group id, or -1 if there are already
+/// Consumers groups. Every group sees every event (broadcast), a group is
+/// one consumer thread which calls consume() with its id, e.g. a journaler,
+/// a replicator and the business logic. The events are never copied per
+/// group, and the producers only wrap past the slowest group.
+///
+/// Add all the groups before start(), a queue with groups can't be used
+/// with pop() or drain(), they share workSequence instead.
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+inline
+int DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::addConsumerGroup()
+{
+    uint32_t group = jimi_fetch_and_add32(&this->numGroups, 1);
+    if (group >= kConsumers) {
+        jimi_fetch_and_add32(&this->numGroups, -1);
+        return -1;
+    }
+    return (int)group;
+}
+
+///
+/// The gating sequence of a consumer group, the last event it has handled.
+/// The only consumer (Consumers == 1) gates the producers with workSequence.
+/// A downstream stage can depend on it with a SequenceBarrier, and a group
+/// must setMaxValue() it when it exits early.
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+inline
+typename DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::Sequence *
+DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::getGroupSequence(int group)
+{
+    if (group < 0 || group >= (int)this->numGroups)
+        return NULL;
+    if (kIsSingleConsumer)
+        return &this->workSequence;
+    return &this->gatingSequences[group];
+}
+
+///
+/// The last event consumed by all the consumers: the single consumer's
+/// workSequence, or the slowest consumer (group). With many consumers,
+/// workSequence is claimed before the event is read, the gating sequence
+/// of a consumer only moves after it has finished with its event.
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+inline
+typename DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::sequence_type
+DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::getTailSequence() const
+{
+    if (!kIsSingleConsumer) {
+        return DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>
+                ::getMinimumSequence(this->gatingSequences, this->workSequence, this->cursor.get());
+    }
+    return this->workSequence.get();
+}
+
+///
+/// The wrap check of the producers: is the slot at wrapPoint already
+/// consumed by all the consumers? The producer looks at its own cache
+/// first, the shared gatingSequenceCache is only read (and written) when
+/// the local view says the ring might be full, so the producers don't
+/// bounce the shared cache line on every claim.
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+inline
+bool DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::hasAvailableCapacity(sequence_type wrapPoint,
+                                                                                                                                        sequence_type current,
+                                                                                                                                        int producerId)
+{
+    sequence_type cachedGatingSequence;
+    if (producerId >= 0) {
+        assert(producerId < (int)kProducersAlloc);
+        cachedGatingSequence = this->gatingSequenceCaches[producerId].get();
+        if (wrapPoint <= cachedGatingSequence && cachedGatingSequence <= current)
+            return true;
+    }
+
+    cachedGatingSequence = this->gatingSequenceCache.get();
+    if (wrapPoint > cachedGatingSequence || cachedGatingSequence > current) {
+        cachedGatingSequence = DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>
+                                ::getMinimumSequence(this->gatingSequences, this->workSequence, current);
+        if (wrapPoint > cachedGatingSequence) {
+            // Maybe queue is full.
+            return false;
         }
-        else if (this->cursor.compareAndSwap(current, nextSequence) != current) {
-            // Need yiled() or sleep() a while.
-            //jimi_wsleep(0);
+
+        this->gatingSequenceCache.setOrder(cachedGatingSequence);
+    }
+
+    if (producerId >= 0)
+        this->gatingSequenceCaches[producerId].setOrder(cachedGatingSequence);
+    return true;
+}
+
+///
+/// Claim n contiguous sequences with a single CAS on the cursor.
+/// On success, nextSequence is the highest claimed sequence, the range is
+/// [nextSequence - n + 1, nextSequence]. If the ring has not enough free slots
+/// for the whole batch, nothing is claimed and -1 is returned.
+///
+/// With a single producer, there is nobody to race with, the cursor is
+/// left alone until publish() and nextValue is updated with a plain store.
+///
+/// With FetchAddClaimStrategy, the producers claim with one fetch-and-add
+/// instead. The free slots are checked before the claim, but a claim can't
+/// be undone, so if the other producers took them in between, tryNext()
+/// waits for the consumers and never fails after the fetch-and-add.
+///
+/// producerId is the slot returned by registerProducer(), kLocalProducer
+/// (-1) for the calling thread's own slot, or kSharedProducer.
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+inline
+int DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::tryNext(size_type n, sequence_type & nextSequence,
+                                                                                                                          int producerId /* = -1 */)
+{
+    assert(n > 0 && n <= kCapacity);
+
+    sequence_type current, next;
+    if (kIsSingleProducer) {
+        current = this->nextValue;
+        next = current + (sequence_type)n;
+
+        if (!hasAvailableCapacity(next - (sequence_type)kCapacity, current, -1)) {
+            // tryNext() failed, not enough space for the whole batch.
+            return -1;
         }
-        else {
-            // Claim a sequence succeeds.
+
+        this->nextValue = next;
+        nextSequence = next;
+        return 0;
+    }
+
+    // Only the single producer above can use the shared cache for free.
+    if (producerId == kLocalProducer)
+        producerId = localProducerId();
+
+    if (kUseFetchAndAdd) {
+        current = this->cursor.get();
+        next = current + (sequence_type)n;
+
+        if (!hasAvailableCapacity(next - (sequence_type)kCapacity, current, producerId)) {
+            // tryNext() failed, not enough space for the whole batch.
+            return -1;
+        }
+
+        current = this->cursor.fetchAndAdd((sequence_type)n);
+        next = current + (sequence_type)n;
+
+        // The sequences (current, next] are ours now, wait until they are free.
+        uint32_t loop_cnt = 0;
+        while (!hasAvailableCapacity(next - (sequence_type)kCapacity, current, producerId)) {
+            ClaimStrategy::backoff(loop_cnt);
+        }
+
+        nextSequence = next;
+        return 0;
+    }
+
+    do {
+        current = this->cursor.get();
+        next = current + (sequence_type)n;
+
+        if (!hasAvailableCapacity(next - (sequence_type)kCapacity, current, producerId)) {
+            // tryNext() failed, not enough space for the whole batch.
+            return -1;
+        }
+
+        if (this->cursor.compareAndSwap(current, next) == current) {
+            // Claim the sequences (current, next] succeeds.
             break;
         }
     } while (true);
 
-    this->entries[nextSequence & kIndexMask] = entry;
-    //this->entries[nextSequence & kIndexMask].copy(entry);
+    nextSequence = next;
+    return 0;
+}
+
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+inline
+int DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::push_n(const T * first, size_type n,
+                                                                                                                         int producerId /* = -1 */)
+{
+    assert(first != NULL);
+
+    sequence_type lowerBound, upperBound;
+    if (tryNext(n, upperBound, producerId) != 0) {
+        // Push_n() failed, maybe queue is full.
+        return -1;
+    }
+
+    lowerBound = upperBound - (sequence_type)n + 1;
+    for (sequence_type sequence = lowerBound; sequence <= upperBound; ++sequence) {
+        this->entries[sequence & kIndexMask] = *first;
+        ++first;
+    }
 
     Jimi_WriteCompilerBarrier();
 
-    publish(nextSequence);
+    publish(lowerBound, upperBound);
 
     Jimi_WriteCompilerBarrier();
     return 0;
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
 inline
-int DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::pop(T & entry, PopThreadStackData & data)
+int DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::pop(T & entry, PopThreadStackData & data)
 {
     assert(data.tailSequence != NULL);
 
@@ -441,36 +934,48 @@ int DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThrea
     while (true) {
         if (data.processedSequence) {
             data.processedSequence = false;
-            do {
-                cursor  = this->cursor.get();
-                limit = cursor - 1;
-                current = this->workSequence.get();
-                data.nextSequence = current + 1;
-                data.tailSequence->set(current);
+            if (kIsSingleConsumer) {
+                // Nobody to race with, no CAS on workSequence.
+                data.nextSequence = this->consumedValue + 1;
+            }
+            else {
+                do {
+                    cursor  = this->cursor.get();
+                    limit = cursor - 1;
+                    current = this->workSequence.get();
+                    data.nextSequence = current + 1;
+                    data.tailSequence->set(current);
 #if 0
-                if ((current == limit) || (current > limit && (limit - current) > kIndexMask)) {
+                    if ((current == limit) || (current > limit && (limit - current) > kIndexMask)) {
 #if 0
-                    Jimi_ReadCompilerBarrier();
-                    //processedSequence = true;
-                    return -1;
+                        Jimi_ReadCompilerBarrier();
+                        //processedSequence = true;
+                        return -1;
 #else
-                    //jimi_wsleep(0);
+                        //jimi_wsleep(0);
 #endif
-                }
+                    }
 #endif
-            } while (this->workSequence.compareAndSwap(current, data.nextSequence) != current);
+                } while (this->workSequence.compareAndSwap(current, data.nextSequence) != current);
+            }
         }
 
         if (data.cachedAvailableSequence >= data.nextSequence) {
         //if ((cachedAvailableSequence - current) <= kIndexMask * 2) {
         //if ((cachedAvailableSequence - nextSequence) <= (kIndexMask + 1)) {
-            // Read the message data
-            entry = this->entries[data.nextSequence & kIndexMask];
+            // Only this consumer reads the slot, so the event is moved out,
+            // see the note on process().
+            entry = JIMI_MOVE(this->entries[data.nextSequence & kIndexMask]);
 
             Jimi_ReadCompilerBarrier();
             //data.tailSequence->set(data.nextSequence);
             data.processedSequence = true;
 
+            if (kIsSingleConsumer) {
+                this->consumedValue = data.nextSequence;
+                releaseProgress(data);
+            }
+
             Jimi_ReadCompilerBarrier();
             return 0;
         }
@@ -478,56 +983,338 @@ int DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThrea
             // Maybe queue is empty now.
             data.cachedAvailableSequence = waitFor(data.nextSequence);
             //data.tailSequence->set(cachedAvailableSequence);
-            if (data.cachedAvailableSequence < data.nextSequence)
+            if (data.cachedAvailableSequence < data.nextSequence) {
+                // After shutdown(), nothing will be published any more.
+                if (this->alerted != 0 && this->cursor.get() < data.nextSequence)
+                    return kHalted;
                 return -1;
+            }
         }
     }
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+#if defined(JIMI_HAS_CXX11_MOVE) && (JIMI_HAS_CXX11_MOVE != 0)
+
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
 inline
-typename DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::sequence_type
-DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::waitFor(sequence_type sequence)
+int DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::push(T && entry)
 {
-    sequence_type availableSequence;
+    sequence_type sequence;
+    T * slot = claim(sequence);
+    if (slot == NULL) {
+        // Push() failed, maybe queue is full.
+        return -1;
+    }
+
+    *slot = std::move(entry);
+    commit(sequence);
+    return 0;
+}
 
-#if defined(USE_SEQUENCE_SPIN_LOCK) && (USE_SEQUENCE_SPIN_LOCK != 0)
-    static const uint32_t YIELD_THRESHOLD = 20;
+///
+/// Build the event in its slot from args. The claimed sequence can't be given
+/// back, so if T's constructor throws, a default T is published in its place
+/// (see reconstruct_at()) before the exception goes on to the caller.
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+template <typename ...Args>
+inline
+int DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::emplace(Args && ... args)
+{
+    sequence_type sequence;
+    T * slot = claim(sequence);
+    if (slot == NULL) {
+        // Emplace() failed, maybe queue is full.
+        return -1;
+    }
+
+#if defined(JIMI_HAS_EXCEPTIONS) && (JIMI_HAS_EXCEPTIONS != 0)
+    try {
+        reconstruct_at(slot, std::forward<Args>(args)...);
+    }
+    catch (...) {
+        // Otherwise the consumers wait for this sequence forever.
+        commit(sequence);
+        throw;
+    }
 #else
-    static const uint32_t YIELD_THRESHOLD = 8;
+    reconstruct_at(slot, std::forward<Args>(args)...);
 #endif
-    int32_t  pause_cnt;
-    uint32_t loop_cnt, yeild_cnt, spin_cnt;
-
-    loop_cnt = 0;
-    spin_cnt = 1;
-    while ((availableSequence = this->cursor.get()) < sequence) {
-        // Need yiled() or sleep() a while.
-        if (loop_cnt >= YIELD_THRESHOLD) {
-            yeild_cnt = loop_cnt - YIELD_THRESHOLD;
-            if ((yeild_cnt & 63) == 63) {
-                jimi_sleep(1);
-            }
-            else if ((yeild_cnt & 3) == 3) {
-                jimi_sleep(0);
+    commit(sequence);
+    return 0;
+}
+
+#endif  /* JIMI_HAS_CXX11_MOVE */
+
+///
+/// Zero-copy push: claim the next slot and build the event in place,
+/// then commit() the sequence. Returns NULL if the queue is full.
+///
+/// A producer may hold several claims, but with a single producer
+/// (Producers == 1) it must commit them in the order they were claimed:
+/// commit() moves the cursor, which publishes every sequence up to it.
+/// The multi-producer path marks each slot in availableBuffer, there the
+/// claims can be committed in any order.
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+inline
+T * DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::claim(sequence_type & sequence, int producerId /* = -1 */)
+{
+    if (tryNext(1, sequence, producerId) != 0) {
+        // Claim() failed, maybe queue is full.
+        return NULL;
+    }
+    return &this->entries[sequence & kIndexMask];
+}
+
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+inline
+void DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::commit(sequence_type sequence)
+{
+    // The single producer commits its claims in order, see claim().
+    assert(!kIsSingleProducer || this->cursor.get() == sequence - 1);
+
+    Jimi_WriteCompilerBarrier();
+
+    publish(sequence);
+}
+
+///
+/// Zero-copy pop: entry points to the event in the ring, it stays valid
+/// (the producers can't overwrite it) until release() is called.
+/// Calling peek() again before release() returns the same event.
+/// Returns -1 if the queue is empty, or kHalted after shutdown().
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+inline
+int DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::peek(const T * & entry, PopThreadStackData & data)
+{
+    assert(data.tailSequence != NULL);
+
+    sequence_type current;
+    while (true) {
+        if (data.processedSequence) {
+            data.processedSequence = false;
+            if (kIsSingleConsumer) {
+                data.nextSequence = this->consumedValue + 1;
             }
             else {
-                if (!jimi_yield()) {
-                    jimi_sleep(0);
-                    //jimi_mm_pause();
-                }
+                do {
+                    current = this->workSequence.get();
+                    data.nextSequence = current + 1;
+                    // Hold back the producers at the slot we are going to read.
+                    data.tailSequence->set(current);
+                } while (this->workSequence.compareAndSwap(current, data.nextSequence) != current);
             }
         }
+
+        if (data.cachedAvailableSequence >= data.nextSequence) {
+            Jimi_ReadCompilerBarrier();
+            entry = &this->entries[data.nextSequence & kIndexMask];
+            return 0;
+        }
         else {
-            for (pause_cnt = spin_cnt; pause_cnt > 0; --pause_cnt) {
-                jimi_mm_pause();
+            // Maybe queue is empty now.
+            data.cachedAvailableSequence = waitFor(data.nextSequence);
+            if (data.cachedAvailableSequence < data.nextSequence) {
+                // After shutdown(), nothing will be published any more.
+                if (this->alerted != 0 && this->cursor.get() < data.nextSequence)
+                    return kHalted;
+                return -1;
             }
-            spin_cnt = spin_cnt + 1;
         }
-        loop_cnt++;
     }
+}
+
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+inline
+void DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::release(PopThreadStackData & data)
+{
+    assert(!data.processedSequence);
+
+    Jimi_ReadCompilerBarrier();
+    data.processedSequence = true;
+
+    if (kIsSingleConsumer) {
+        this->consumedValue = data.nextSequence;
+        releaseProgress(data);
+    }
+    else {
+        // The slot can be reused by the producers now.
+        data.tailSequence->set(data.nextSequence);
+    }
+}
+
+///
+/// The single consumer publishes its progress to the producers once per
+/// kReleaseBatch events, or when it has consumed all the available events,
+/// so the producers always see the progress before the consumer waits.
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+inline
+void DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::releaseProgress(const PopThreadStackData & data)
+{
+    if ((data.nextSequence == data.cachedAvailableSequence)
+        || ((data.nextSequence & (sequence_type)(kReleaseBatch - 1)) == 0)) {
+        this->workSequence.setOrder(data.nextSequence);
+    }
+}
+
+///
+/// Drain all the published events behind workSequence in one batch.
+/// The batch (at most maxBatch events) is claimed with a single CAS on
+/// workSequence, each event is passed to handler(entry, sequence, endOfBatch),
+/// and the consumer's gating sequence is advanced only once, after the last one.
+/// Returns the number of handled events, -1 if the queue is empty,
+/// or kHalted after shutdown() when all the published events are consumed.
+///
+/// Don't mix pop() and drain() on the same PopThreadStackData, pop() may
+/// still hold a claimed but unprocessed sequence.
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+template <typename EventHandler>
+inline
+int DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::drain(EventHandler & handler,
+                                                                                                                        PopThreadStackData & data,
+                                                                                                                        size_type maxBatch)
+{
+    assert(data.tailSequence != NULL);
+    assert(data.processedSequence);
+    assert(maxBatch > 0);
+
+    sequence_type current, nextSequence, endSequence;
+    do {
+        current = kIsSingleConsumer ? this->consumedValue : this->workSequence.get();
+        nextSequence = current + 1;
+
+        if (data.cachedAvailableSequence < nextSequence) {
+            // Maybe queue is empty now. Don't hold back the producers
+            // with a stale gating sequence while we are waiting.
+            data.tailSequence->set(current);
+            data.cachedAvailableSequence = waitFor(nextSequence);
+            if (data.cachedAvailableSequence < nextSequence) {
+                // After shutdown(), nothing will be published any more.
+                if (this->alerted != 0 && this->cursor.get() < nextSequence)
+                    return kHalted;
+                return -1;
+            }
+        }
+
+        endSequence = data.cachedAvailableSequence;
+        if ((endSequence - current) > (sequence_type)maxBatch)
+            endSequence = current + (sequence_type)maxBatch;
+    } while (!kIsSingleConsumer
+             && this->workSequence.compareAndSwap(current, endSequence) != current);
+
+    Jimi_ReadCompilerBarrier();
+
+    for (sequence_type sequence = nextSequence; sequence <= endSequence; ++sequence) {
+        handler(this->entries[sequence & kIndexMask], sequence, (sequence == endSequence));
+    }
+
+    Jimi_ReadCompilerBarrier();
+
+    // One gating sequence update for the whole batch.
+    if (kIsSingleConsumer) {
+        this->consumedValue = endSequence;
+        this->workSequence.setOrder(endSequence);
+    }
+    else {
+        data.tailSequence->set(endSequence);
+    }
+    data.nextSequence = endSequence;
+
+    return (int)(endSequence - current);
+}
+
+///
+/// One step of a pipeline stage consumer. Unlike pop() and drain(), the
+/// consumer doesn't compete on workSequence, it sees every event, but only
+/// the ones that all the upstream stages in barrier have passed. The events
+/// are passed to handler(entry, sequence, endOfBatch) in place, so the handler
+/// can update them for the downstream stages. sequence is the consumer's own
+/// gating sequence (see getGatingSequences()), it's advanced after each batch.
+///
+/// The first stage uses drain(), the later stages use process(): only drain()
+/// and pop() advance workSequence, which gates the producers unless there are
+/// consumer groups, so the barrier must have at least one upstream stage
+/// (consume() is the one exception). pop() moves the events out of their
+/// slots, so it can't be used by a stage that has downstream stages.
+/// Returns the number of handled events, -1 if nothing is available now,
+/// or kHalted after shutdown() when all the published events are handled.
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+template <typename EventHandler>
+inline
+int DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::process(EventHandler & handler,
+                                                                                                                          const barrier_type & barrier,
+                                                                                                                          Sequence & sequence,
+                                                                                                                          size_type maxBatch)
+{
+    assert(maxBatch > 0);
+    assert(barrier.dependents() > 0 || this->numGroups > 0);
+
+    sequence_type current, nextSequence, availableSequence, endSequence;
+    current = sequence.get();
+    nextSequence = current + 1;
+
+    // Wait for the producers, then for the upstream stages.
+    availableSequence = waitFor(nextSequence);
+    if (availableSequence >= nextSequence)
+        availableSequence = barrier.waitFor(nextSequence, availableSequence);
+
+    if (availableSequence < nextSequence) {
+        // After shutdown(), nothing will be published any more.
+        if (this->alerted != 0 && this->cursor.get() < nextSequence)
+            return kHalted;
+        return -1;
+    }
+
+    endSequence = availableSequence;
+    if ((endSequence - current) > (sequence_type)maxBatch)
+        endSequence = current + (sequence_type)maxBatch;
+
+    Jimi_ReadCompilerBarrier();
+
+    for (sequence_type seq = nextSequence; seq <= endSequence; ++seq) {
+        handler(this->entries[seq & kIndexMask], seq, (seq == endSequence));
+    }
+
+    // The updates of the handler must be visible before the downstream stages see them.
+    Jimi_WriteCompilerBarrier();
+
+    sequence.set(endSequence);
+
+    return (int)(endSequence - current);
+}
+
+///
+/// One step of a consumer group (see addConsumerGroup()), it handles all
+/// the published events after the group's sequence, at most maxBatch,
+/// like process() without upstream stages. Returns the number of handled
+/// events, -1 if nothing is available now, or kHalted after shutdown().
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+template <typename EventHandler>
+inline
+int DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::consume(EventHandler & handler, int group, size_type maxBatch)
+{
+    barrier_type noDependents;
+    Sequence * sequence = getGroupSequence(group);
+    assert(sequence != NULL);
+
+    return process(handler, noDependents, *sequence, maxBatch);
+}
+
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy, typename Allocator>
+inline
+typename DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::sequence_type
+DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>::waitFor(sequence_type sequence)
+{
+    sequence_type availableSequence = this->waitStrategy.waitFor(sequence, this->cursor, this->alerted);
 
-    if (availableSequence < sequence)
+    // The single producer only advances the cursor after the events are written.
+    if (kIsSingleProducer || availableSequence < sequence)
         return availableSequence;
 
     return getHighestPublishedSequence(sequence, availableSequence);
@@ -554,7 +1341,7 @@ void reserve_code()
         }
 
         if (maybeIsFull || tail < wrapPoint || tail > head) {
-            sequence_type gatingSequence = DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads>
+            sequence_type gatingSequence = DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, ClaimStrategy, Allocator>
                                             ::getMinimumSequence(this->gatingSequences, this->workSequence, head);
             if (maybeIsFull || wrapPoint > gatingSequence) {
                 // Push() failed, maybe queue is full.
@@ -25,6 +25,8 @@
 #include <emmintrin.h>
 
 #include "Sequence.h"
+#include "WaitStrategy.h"
+#include "Allocator.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -54,11 +56,13 @@ struct gEntryCell_t<ItemType, EntryCellSize, false>
 };
 
 ///////////////////////////////////////////////////////////////////
-// class DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>
+// class DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>
 ///////////////////////////////////////////////////////////////////
 
 template <typename T, typename SequenceType = int64_t, uint32_t Capacity = 1024U,
-          uint32_t Producers = 0, uint32_t Consumers = 0, uint32_t NumThreads = 0>
+          uint32_t Producers = 0, uint32_t Consumers = 0, uint32_t NumThreads = 0,
+          typename WaitStrategy = DefaultWaitStrategy,
+          typename Allocator = HeapAllocator>
 class DisruptorRingQueueEx
 {
 public:
@@ -73,6 +77,8 @@ public:
     typedef uint32_t                    index_type;
     typedef SequenceType                sequence_type;
     typedef SequenceBase<SequenceType>  Sequence;
+    typedef WaitStrategy                wait_strategy_type;
+    typedef Allocator                   allocator_type;
 
     
     typedef item_type *                 pointer;
@@ -94,12 +100,15 @@ public:
     static const size_type  kEntryCellSize  = JIMI_ROUND_TO_POW2(JIMI_ALIGNED_TO(sizeof(item_type), 4));
     static const index_type kEntryLineSize  = (index_type)JIMI_MAX(JIMI_ROUND_TO_POW2(kCacheLineSize / kEntryCellSize), 1);
     static const index_type kEntryBoxes     = (index_type)JIMI_MAX(JIMI_ROUND_TO_POW2((kCapacity + kEntryLineSize - 1) / kEntryLineSize), 8);
+    static const size_type  kEntryCells     = kEntryBoxes * kEntryLineSize;
 #else
     static const size_type  kEntryCellSize  = JIMI_ALIGNED_TO(sizeof(item_type), kCacheLineSize);
+    static const size_type  kEntryCells     = kCapacity;
 #endif // ENTRIES_ADVANCED_SAVE_MODE != 0
+    // The allocator returns cache line aligned memory.
     static const size_type  kEntryAlignment = kCacheLineSize;
-    static const size_t     kEntryAlignMask     = (~((size_t)kEntryAlignment - 1));
-    static const size_type  kEntryAlignPadding  = kEntryAlignment - 1;
+
+    static const size_type  kAvailableBufferCells = kIndexBoxes * kIndexLineSize;
 
     static const size_type  kProducers      = Producers;
     static const size_type  kConsumers      = Consumers;
@@ -107,6 +116,17 @@ public:
     static const size_type  kConsumersAlloc = (Consumers <= 1) ? 1 : ((Consumers + 1) & ((size_type)(~1U)));
     static const bool       kIsAllocOnHeap  = true;
 
+    /// Only one thread pushes, see DisruptorRingQueue::kIsSingleProducer.
+    static const bool       kIsSingleProducer = (Producers == 1);
+
+    /// Only one thread pops, see DisruptorRingQueue::kIsSingleConsumer.
+    static const bool       kIsSingleConsumer = (Consumers == 1);
+    static const size_type  kReleaseBatch     = (size_type)JIMI_MAX(kCapacity / 4, 1);
+
+    /// pop() returns it after shutdown(), when all the published
+    /// events have been consumed, the consumer thread can exit now.
+    static const int        kHalted         = -2;
+
     struct PopThreadStackData
     {
         Sequence *      tailSequence;
@@ -153,7 +173,9 @@ public:
     void init_queue(bool bFillQueue = true);
 
     void start();
-    void shutdown(int32_t timeOut = -1);
+    int  shutdown(int32_t timeOut = -1);
+    bool isAlerted() const      { return (this->alerted != 0); };
+    bool isDrained() const;
 
     Sequence *getGatingSequences(int index);
 
@@ -163,8 +185,19 @@ public:
     sequence_type getHighestPublishedSequence(sequence_type lowerBound,
                                               sequence_type availableSequence);
 
+    int tryNext(sequence_type & nextSequence);
+    reference entryAt(sequence_type sequence);
+
     int push(T const & entry);
     int pop (T & entry, PopThreadStackData & data);
+    void releaseProgress(const PopThreadStackData & data);
+
+#if defined(JIMI_HAS_CXX11_MOVE) && (JIMI_HAS_CXX11_MOVE != 0)
+    int push(T && entry);
+
+    template <typename ...Args>
+    int emplace(Args && ... args);
+#endif  /* JIMI_HAS_CXX11_MOVE */
 
     sequence_type waitFor(sequence_type sequence);
 
@@ -174,46 +207,58 @@ protected:
     Sequence        gatingSequenceCache;
     Sequence        gatingSequenceCaches[kProducersAlloc];
 
+    wait_strategy_type  waitStrategy;
+
+    volatile uint32_t   alerted;
+    char                padding1[JIMI_CACHELINE_SIZE - sizeof(uint32_t) * 1];
+
+    // The last claimed sequence, only used by the single producer.
+    sequence_type       nextValue;
+    char                padding2[JIMI_CACHELINE_SIZE - sizeof(sequence_type) * 1];
+
+    // The last consumed sequence, only used by the single consumer.
+    sequence_type       consumedValue;
+    char                padding3[JIMI_CACHELINE_SIZE - sizeof(sequence_type) * 1];
+
     cell_type *     entries;
     flag_type *     availableBuffer;
-    item_type *     entriesAlloc;
-    flag_type *     availableBufferAlloc;
 };
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
-DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::DisruptorRingQueueEx(bool bFillQueue /* = true */)
-    : entries(NULL), availableBuffer(NULL), entriesAlloc(NULL), availableBufferAlloc(NULL),
-      cursor(Sequence::INITIAL_CURSOR_VALUE), workSequence(Sequence::INITIAL_CURSOR_VALUE),
-      gatingSequenceCache(Sequence::INITIAL_CURSOR_VALUE)
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
+DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::DisruptorRingQueueEx(bool bFillQueue /* = true */)
+    : cursor(Sequence::INITIAL_CURSOR_VALUE), workSequence(Sequence::INITIAL_CURSOR_VALUE),
+      gatingSequenceCache(Sequence::INITIAL_CURSOR_VALUE),
+      entries(NULL), availableBuffer(NULL)
 {
     init(bFillQueue);
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
-DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::~DisruptorRingQueueEx()
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
+DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::~DisruptorRingQueueEx()
 {
     // If the queue is allocated on system heap, release them.
     if (kIsAllocOnHeap) {
-        if (this->availableBufferAlloc) {
-            delete [] this->availableBufferAlloc;
+        if (this->availableBuffer) {
+            delete_array<flag_type, Allocator>(this->availableBuffer, kAvailableBufferCells);
             this->availableBuffer = NULL;
-            this->availableBufferAlloc = NULL;
         }
 
-        if (this->entriesAlloc != NULL) {
-            delete [] this->entriesAlloc;
+        if (this->entries != NULL) {
+            delete_array<cell_type, Allocator>(this->entries, kEntryCells);
             this->entries = NULL;
-            this->entriesAlloc = NULL;
         }
     }
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
 inline
-void DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::init(bool bFillQueue /* = true */)
+void DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::init(bool bFillQueue /* = true */)
 {
     this->cursor.set(Sequence::INITIAL_CURSOR_VALUE);
     this->workSequence.set(Sequence::INITIAL_CURSOR_VALUE);
+    this->nextValue = Sequence::INITIAL_CURSOR_VALUE;
+    this->consumedValue = Sequence::INITIAL_CURSOR_VALUE;
+    this->alerted = 0;
 
     for (int i = 0; i < kConsumersAlloc; ++i) {
         this->gatingSequences[i].set(Sequence::INITIAL_CURSOR_VALUE);
@@ -234,65 +279,46 @@ void DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumTh
 #endif  /* _DEBUG */
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
 inline
-void DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::init_queue(bool bFillQueue /* = true */)
+void DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::init_queue(bool bFillQueue /* = true */)
 {
     assert(kEntryCellSize >= sizeof(item_type));
     assert((kEntryBoxes * kEntryLineSize) >= kCapacity);
-#if defined(ENTRIES_ADVANCED_SAVE_MODE) && (ENTRIES_ADVANCED_SAVE_MODE != 0)
-    item_type * newEntriesAlloc = (item_type *)::malloc(kEntryBoxes * kEntryLineSize * kEntryCellSize + kEntryAlignPadding);
-    if (newEntriesAlloc != NULL) {
-        cell_type * newEntries = reinterpret_cast<cell_type *>(reinterpret_cast<uintptr_t>(
-            reinterpret_cast<char *>(newEntriesAlloc) + kEntryAlignPadding) & (uintptr_t)kEntryAlignMask);
+    // The cells of a T with a non-trivial constructor are constructed,
+    // the raw memory must hold live events for operator =.
+    cell_type * newEntries = new_array<cell_type, Allocator>(kEntryCells);
+    if (newEntries != NULL) {
         if (bFillQueue) {
-            ::memset((void *)newEntries, 0, kEntryBoxes * kEntryLineSize * kEntryCellSize);
+            clear_array(newEntries, kEntryCells);
         }
         Jimi_MemoryBarrier();
         //Jimi_WriteCompilerBarrier();
         this->entries = newEntries;
-        this->entriesAlloc = newEntriesAlloc;
     }
-#else
-    item_type * newEntriesAlloc = (item_type *)::malloc(kEntryCellSize * kCapacity + kEntryAlignPadding);
-    if (newEntriesAlloc != NULL) {
-        cell_type * newEntries = reinterpret_cast<cell_type *>(reinterpret_cast<uintptr_t>(
-            reinterpret_cast<char *>(newEntriesAlloc) + kEntryAlignPadding) & (uintptr_t)kEntryAlignMask);
-        if (bFillQueue) {
-            ::memset((void *)newEntries, 0, kEntryCellSize * kCapacity);
-        }
-        Jimi_MemoryBarrier();
-        //Jimi_WriteCompilerBarrier();
-        this->entries = newEntries;
-        this->entriesAlloc = newEntriesAlloc;
-    }
-#endif // ENTRIES_ADVANCED_SAVE_MODE != 0
 
-    flag_type * newBufferAlloc = (flag_type *)::malloc(kIndexBoxes * kIndexLineSize * sizeof(flag_type) + kEntryAlignPadding);
-    if (newBufferAlloc != NULL) {
-         flag_type * newBufferData = reinterpret_cast<flag_type *>(reinterpret_cast<uintptr_t>(
-                reinterpret_cast<char *>(newBufferAlloc) + kEntryAlignPadding) & (uintptr_t)kEntryAlignMask);
+    flag_type * newBufferData = new_array<flag_type, Allocator>(kAvailableBufferCells);
+    if (newBufferData != NULL) {
         if (bFillQueue) {
-            for (unsigned i = 0; i < (kIndexBoxes * kIndexLineSize); ++i) {
+            for (unsigned i = 0; i < kAvailableBufferCells; ++i) {
                 newBufferData[i] = (flag_type)(-1);
             }
         }
         Jimi_MemoryBarrier();
         //Jimi_WriteCompilerBarrier();
         this->availableBuffer = newBufferData;
-        this->availableBufferAlloc = newBufferAlloc;
     }
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
-void DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::dump()
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
+void DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::dump()
 {
     //ReleaseUtils::dump(&core, sizeof(core));
     dump_memory(this, sizeof(*this), false, 16, 0, 0);
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
-void DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::dump_detail()
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
+void DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::dump_detail()
 {
     printf("---------------------------------------------------------\n");
     printf("DisruptorRingQueueEx: (head = %llu, tail = %llu)\n",
@@ -302,10 +328,10 @@ void DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumTh
     printf("\n");
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
 inline
-typename DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::size_type
-DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::sizes() const
+typename DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::size_type
+DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::sizes() const
 {
     sequence_type head, tail;
 
@@ -317,13 +343,16 @@ DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads
     return (size_type)((head - tail) <= kIndexMask) ? (head - tail) : (size_type)(-1);
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
 inline
-void DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::start()
+void DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::start()
 {
     sequence_type cursor = this->cursor.get();
     this->workSequence.set(cursor);
     this->gatingSequenceCache.set(cursor);
+    this->nextValue = cursor;
+    this->consumedValue = cursor;
+    this->alerted = 0;
 
     int i;
     for (i = 0; i < kConsumersAlloc; ++i) {
@@ -336,22 +365,54 @@ void DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumTh
     //*/
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+///
+/// Alert all the consumers, and wake up the ones blocked in waitFor().
+/// The consumers still consume all the published events, then pop()
+/// returns kHalted instead of waiting on an empty queue.
+///
+/// Call it after the producers have stopped, it waits until isDrained(),
+/// see wait_until_drained().
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
+inline
+int DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::shutdown(int32_t timeOut /* = -1 */)
+{
+    this->alerted = 1;
+    Jimi_MemoryBarrier();
+    this->waitStrategy.signalAllWhenBlocking();
+
+    return wait_until_drained(*this, timeOut);
+}
+
+///
+/// All the published events are consumed. The consumers claim workSequence
+/// before they read the event, so wait on their gating sequences as well,
+/// like the producers do.
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
 inline
-void DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::shutdown(int32_t timeOut /* = -1 */)
+bool DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::isDrained() const
 {
-    // TODO: do shutdown procedure
+    sequence_type cursor = this->cursor.get();
+    return (DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>
+            ::getMinimumSequence(this->gatingSequences, this->workSequence, cursor) >= cursor);
 }
 
 /* static */
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
 inline
-typename DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::sequence_type
-DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::
+typename DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::sequence_type
+DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::
     getMinimumSequence(const Sequence *sequences, const Sequence &workSequence, sequence_type mininum)
 {
     assert(sequences != NULL);
 
+    if (kIsSingleConsumer) {
+        // Only the single consumer advances workSequence.
+        sequence_type cachedWorkSequence = workSequence.get();
+        return (cachedWorkSequence < mininum) ? cachedWorkSequence : mininum;
+    }
+
 #if 0
     sequence_type minSequence = sequences->get();
     for (int i = 1; i < kConsumers; ++i) {
@@ -394,18 +455,26 @@ DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads
     return minSequence;
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
 inline
-void DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::publish(sequence_type sequence)
+void DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::publish(sequence_type sequence)
 {
     Jimi_WriteCompilerBarrier();
 
-    setAvailable(sequence);
+    if (kIsSingleProducer) {
+        // The event is written, let the consumers see it.
+        this->cursor.setOrder(sequence);
+    }
+    else {
+        setAvailable(sequence);
+    }
+
+    this->waitStrategy.signalAllWhenBlocking();
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
 inline
-void DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::setAvailable(sequence_type sequence)
+void DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::setAvailable(sequence_type sequence)
 {
     index_type index = (index_type)((index_type)sequence &  kIndexMask);
     flag_type  flag  = (flag_type) (            sequence >> kIndexShift);
@@ -418,9 +487,9 @@ void DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumTh
     this->availableBuffer[newIndex] = flag;
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
 inline
-bool DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::isAvailable(sequence_type sequence)
+bool DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::isAvailable(sequence_type sequence)
 {
     index_type index = (index_type)((index_type)sequence &  kIndexMask);
     flag_type  flag  = (flag_type) (            sequence >> kIndexShift);
@@ -431,10 +500,10 @@ bool DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumTh
     return (flagValue == flag);
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
 inline
-typename DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::sequence_type
-DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::
+typename DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::sequence_type
+DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::
         getHighestPublishedSequence(sequence_type lowerBound, sequence_type availableSequence)
 {
     for (sequence_type sequence = lowerBound; sequence <= availableSequence; ++sequence) {
@@ -446,21 +515,44 @@ DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads
     return availableSequence;
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
-typename DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::Sequence *
-DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::getGatingSequences(int index)
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
+typename DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::Sequence *
+DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::getGatingSequences(int index)
 {
-    if (index >= 0 && index < kCapacity) {
+    if (index >= 0 && index < (int)kConsumersAlloc) {
         return &this->gatingSequences[index];
     }
     return NULL;
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
 inline
-int DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::push(T const & entry)
+int DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::tryNext(sequence_type & nextSequence)
 {
-    sequence_type current, nextSequence;
+    sequence_type current;
+    if (kIsSingleProducer) {
+        // Nobody to race with, leave the cursor alone until publish().
+        current = this->nextValue;
+        nextSequence = current + 1;
+
+        sequence_type wrapPoint = current - kIndexMask;
+        sequence_type cachedGatingSequence = this->gatingSequenceCache.get();
+
+        if (wrapPoint > cachedGatingSequence || cachedGatingSequence > current) {
+            sequence_type gatingSequence = DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>
+                                            ::getMinimumSequence(this->gatingSequences, this->workSequence, current);
+            if (wrapPoint > gatingSequence) {
+                // Push() failed, maybe queue is full.
+                return -1;
+            }
+
+            this->gatingSequenceCache.setOrder(gatingSequence);
+        }
+
+        this->nextValue = nextSequence;
+        return 0;
+    }
+
     do {
         current = this->cursor.get();
         nextSequence = current + 1;
@@ -471,7 +563,7 @@ int DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThr
 
         if (wrapPoint > cachedGatingSequence || cachedGatingSequence > current) {
         //if ((current - cachedGatingSequence) >= kIndexMask) {
-            sequence_type gatingSequence = DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>
+            sequence_type gatingSequence = DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>
                                             ::getMinimumSequence(this->gatingSequences, this->workSequence, current);
             //current = this->cursor.get();
             if (wrapPoint > gatingSequence) {
@@ -499,13 +591,92 @@ int DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThr
         }
     } while (true);
 
+    return 0;
+}
+
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
+inline
+typename DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::reference
+DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::entryAt(sequence_type sequence)
+{
 #if defined(ENTRIES_ADVANCED_SAVE_MODE) && (ENTRIES_ADVANCED_SAVE_MODE != 0)
-    index_type nextIndex = nextSequence & kIndexMask;
-    index_type newIndex = (nextIndex & (kEntryBoxes - 1)) * kEntryLineSize + (nextIndex / kEntryBoxes);
-    this->entries[newIndex].entry = entry;
+    index_type index = sequence & kIndexMask;
+    index_type newIndex = (index & (kEntryBoxes - 1)) * kEntryLineSize + (index / kEntryBoxes);
+    return this->entries[newIndex].entry;
+#else
+    return this->entries[sequence & kIndexMask].entry;
+#endif // ENTRIES_ADVANCED_SAVE_MODE != 0
+}
+
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
+inline
+int DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::push(T const & entry)
+{
+    sequence_type nextSequence;
+    if (tryNext(nextSequence) != 0) {
+        // Push() failed, maybe queue is full.
+        return -1;
+    }
+
+    entryAt(nextSequence) = entry;
+
+    Jimi_WriteCompilerBarrier();
+
+    publish(nextSequence);
+
+    Jimi_WriteCompilerBarrier();
+    return 0;
+}
+
+#if defined(JIMI_HAS_CXX11_MOVE) && (JIMI_HAS_CXX11_MOVE != 0)
+
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
+inline
+int DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::push(T && entry)
+{
+    sequence_type nextSequence;
+    if (tryNext(nextSequence) != 0) {
+        // Push() failed, maybe queue is full.
+        return -1;
+    }
+
+    entryAt(nextSequence) = std::move(entry);
+
+    Jimi_WriteCompilerBarrier();
+
+    publish(nextSequence);
+
+    Jimi_WriteCompilerBarrier();
+    return 0;
+}
+
+///
+/// Build the event in its cell from args, a default T is published if the
+/// constructor throws, as in DisruptorRingQueue::emplace().
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
+template <typename ...Args>
+inline
+int DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::emplace(Args && ... args)
+{
+    sequence_type nextSequence;
+    if (tryNext(nextSequence) != 0) {
+        // Emplace() failed, maybe queue is full.
+        return -1;
+    }
+
+    T * slot = &entryAt(nextSequence);
+#if defined(JIMI_HAS_EXCEPTIONS) && (JIMI_HAS_EXCEPTIONS != 0)
+    try {
+        reconstruct_at(slot, std::forward<Args>(args)...);
+    }
+    catch (...) {
+        Jimi_WriteCompilerBarrier();
+        publish(nextSequence);
+        throw;
+    }
 #else
-    this->entries[nextSequence & kIndexMask].entry = entry;
-    //this->entries[nextSequence & kIndexMask].copy(entry);
+    reconstruct_at(slot, std::forward<Args>(args)...);
 #endif
 
     Jimi_WriteCompilerBarrier();
@@ -515,10 +686,11 @@ int DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThr
     Jimi_WriteCompilerBarrier();
     return 0;
 }
+#endif  /* JIMI_HAS_CXX11_MOVE */
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
 inline
-int DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::pop(T & entry, PopThreadStackData & data)
+int DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::pop(T & entry, PopThreadStackData & data)
 {
     assert(data.tailSequence != NULL);
 
@@ -526,43 +698,47 @@ int DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThr
     while (true) {
         if (data.processedSequence) {
             data.processedSequence = false;
-            do {
-                cursor  = this->cursor.get();
-                limit = cursor - 1;
-                current = this->workSequence.get();
-                data.nextSequence = current + 1;
-                data.tailSequence->set(current);
+            if (kIsSingleConsumer) {
+                // Nobody to race with, no CAS on workSequence.
+                data.nextSequence = this->consumedValue + 1;
+            }
+            else {
+                do {
+                    cursor  = this->cursor.get();
+                    limit = cursor - 1;
+                    current = this->workSequence.get();
+                    data.nextSequence = current + 1;
+                    data.tailSequence->set(current);
 #if 0
-                if ((current == limit) || (current > limit && (limit - current) > kIndexMask)) {
+                    if ((current == limit) || (current > limit && (limit - current) > kIndexMask)) {
 #if 0
-                    Jimi_ReadCompilerBarrier();
-                    //processedSequence = true;
-                    return -1;
+                        Jimi_ReadCompilerBarrier();
+                        //processedSequence = true;
+                        return -1;
 #else
-                    //jimi_wsleep(0);
+                        //jimi_wsleep(0);
 #endif
-                }
+                    }
 #endif
-            } while (this->workSequence.compareAndSwap(current, data.nextSequence) != current);
+                } while (this->workSequence.compareAndSwap(current, data.nextSequence) != current);
+            }
         }
 
         if (data.cachedAvailableSequence >= data.nextSequence) {
         //if ((cachedAvailableSequence - current) <= kIndexMask * 2) {
         //if ((cachedAvailableSequence - nextSequence) <= (kIndexMask + 1)) {
-#if defined(ENTRIES_ADVANCED_SAVE_MODE) && (ENTRIES_ADVANCED_SAVE_MODE != 0)
-            index_type nextIndex = data.nextSequence & kIndexMask;
-            index_type newIndex = (nextIndex & (kEntryBoxes - 1)) * kEntryLineSize + (nextIndex / kEntryBoxes);
-            // Read the message data
-            entry = this->entries[newIndex].entry;
-#else
-            // Read the message data
-            entry = this->entries[data.nextSequence & kIndexMask].entry;
-#endif // ENTRIES_ADVANCED_SAVE_MODE != 0
+            // The claimed event is only read here, take it by move.
+            entry = JIMI_MOVE(entryAt(data.nextSequence));
 
             Jimi_ReadCompilerBarrier();
             //data.tailSequence->set(data.nextSequence);
             data.processedSequence = true;
 
+            if (kIsSingleConsumer) {
+                this->consumedValue = data.nextSequence;
+                releaseProgress(data);
+            }
+
             Jimi_ReadCompilerBarrier();
             return 0;
         }
@@ -570,56 +746,39 @@ int DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThr
             // Maybe queue is empty now.
             data.cachedAvailableSequence = waitFor(data.nextSequence);
             //data.tailSequence->set(cachedAvailableSequence);
-            if (data.cachedAvailableSequence < data.nextSequence)
+            if (data.cachedAvailableSequence < data.nextSequence) {
+                // After shutdown(), nothing will be published any more.
+                if (this->alerted != 0 && this->cursor.get() < data.nextSequence)
+                    return kHalted;
                 return -1;
+            }
         }
     }
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads>
+///
+/// Publish the single consumer's progress on workSequence, once per
+/// kReleaseBatch events or when the available events run out.
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
 inline
-typename DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::sequence_type
-DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads>::waitFor(sequence_type sequence)
+void DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::releaseProgress(const PopThreadStackData & data)
 {
-    sequence_type availableSequence;
-
-#if defined(USE_SEQUENCE_SPIN_LOCK) && (USE_SEQUENCE_SPIN_LOCK != 0)
-    static const uint32_t YIELD_THRESHOLD = 20;
-#else
-    static const uint32_t YIELD_THRESHOLD = 8;
-#endif
-    int32_t  pause_cnt;
-    uint32_t loop_cnt, yeild_cnt, spin_cnt;
-
-    loop_cnt = 0;
-    spin_cnt = 1;
-    while ((availableSequence = this->cursor.get()) < sequence) {
-        // Need yiled() or sleep() a while.
-        if (loop_cnt >= YIELD_THRESHOLD) {
-            yeild_cnt = loop_cnt - YIELD_THRESHOLD;
-            if ((yeild_cnt & 63) == 63) {
-                jimi_sleep(1);
-            }
-            else if ((yeild_cnt & 3) == 3) {
-                jimi_sleep(0);
-            }
-            else {
-                if (!jimi_yield()) {
-                    jimi_sleep(0);
-                    //jimi_mm_pause();
-                }
-            }
-        }
-        else {
-            for (pause_cnt = spin_cnt; pause_cnt > 0; --pause_cnt) {
-                jimi_mm_pause();
-            }
-            spin_cnt = spin_cnt + 1;
-        }
-        loop_cnt++;
+    if ((data.nextSequence == data.cachedAvailableSequence)
+        || ((data.nextSequence & (sequence_type)(kReleaseBatch - 1)) == 0)) {
+        this->workSequence.setOrder(data.nextSequence);
     }
+}
+
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
+inline
+typename DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::sequence_type
+DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers, NumThreads, WaitStrategy, Allocator>::waitFor(sequence_type sequence)
+{
+    sequence_type availableSequence = this->waitStrategy.waitFor(sequence, this->cursor, this->alerted);
 
-    if (availableSequence < sequence)
+    // The single producer only advances the cursor after the events are written.
+    if (kIsSingleProducer || availableSequence < sequence)
         return availableSequence;
 
     return getHighestPublishedSequence(sequence, availableSequence);
@@ -25,6 +25,7 @@
 #include <emmintrin.h>
 
 #include "Sequence.h"
+#include "WaitStrategy.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -130,12 +131,13 @@ public:
 };
 
 ///////////////////////////////////////////////////////////////////
-// class DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>
+// class DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>
 ///////////////////////////////////////////////////////////////////
 
 template <typename T, typename SequenceType = int64_t, uint32_t Capacity = 1024U,
           uint32_t Producers = 0, uint32_t Consumers = 0,
-          typename CoreTy = DisruptorRingQueueCore<T, SequenceType, Capacity, Producers, Consumers> >
+          typename CoreTy = DisruptorRingQueueCore<T, SequenceType, Capacity, Producers, Consumers>,
+          typename WaitStrategy = DefaultWaitStrategy>
 class DisruptorRingQueueBase
 {
 public:
@@ -146,6 +148,7 @@ public:
     typedef uint32_t                    index_type;
     typedef SequenceType                sequence_type;
     typedef typename CoreTy::Sequence   Sequence;
+    typedef WaitStrategy                wait_strategy_type;
 
     typedef item_type                   value_type;
     typedef item_type *                 pointer;
@@ -164,6 +167,10 @@ public:
     static const size_type  kConsumersAlloc = CoreTy::kConsumersAlloc;
     static const bool       kIsAllocOnHeap  = CoreTy::kIsAllocOnHeap;
 
+    /// pop() returns it after shutdown(), when all the published
+    /// events have been consumed, the consumer thread can exit now.
+    static const int        kHalted         = -2;
+
     struct PopThreadStackData
     {
         Sequence       *tailSequence;
@@ -195,7 +202,9 @@ public:
     void init(bool bInitHead = false);
 
     void start();
-    void shutdown(int32_t timeOut = -1);
+    int  shutdown(int32_t timeOut = -1);
+    bool isAlerted() const      { return (this->alerted != 0); };
+    bool isDrained() const;
 
     Sequence *getGatingSequences(int index);
 
@@ -223,20 +232,24 @@ public:
     int mutex_pop (T & entry);
 
 protected:
-    core_type       core;
+    core_type           core;
+    wait_strategy_type  waitStrategy;
+
+    volatile uint32_t   alerted;
+    char                padding1[JIMI_CACHELINE_SIZE - sizeof(uint32_t) * 1];
 
     spin_mutex_t    spin_mutex;
     pthread_mutex_t queue_mutex;
 };
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
-DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::DisruptorRingQueueBase(bool bInitHead /* = false */)
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
+DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::DisruptorRingQueueBase(bool bInitHead /* = false */)
 {
     init(bInitHead);
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
-DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::~DisruptorRingQueueBase()
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
+DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::~DisruptorRingQueueBase()
 {
     // Do nothing!
     Jimi_CompilerBarrier();
@@ -246,9 +259,9 @@ DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>:
     pthread_mutex_destroy(&queue_mutex);
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
 inline
-void DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::init(bool bInitHead /* = false */)
+void DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::init(bool bInitHead /* = false */)
 {
     if (!bInitHead) {
         core.info.head = 0;
@@ -260,6 +273,7 @@ void DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, Cor
 
     core.cursor.set(Sequence::INITIAL_CURSOR_VALUE);
     core.workSequence.set(Sequence::INITIAL_CURSOR_VALUE);
+    this->alerted = 0;
     //core.cursor.set(0x1234);
     //core.workSequence.set(0x5678);
 
@@ -293,29 +307,29 @@ void DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, Cor
     pthread_mutex_init(&queue_mutex, NULL);
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
-void DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::dump()
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
+void DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::dump()
 {
     //ReleaseUtils::dump(&core, sizeof(core));
     dump_memory(this, sizeof(*this), false, 16, 0, 0);
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
-void DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::dump_core()
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
+void DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::dump_core()
 {
     //ReleaseUtils::dump(&core, sizeof(core));
     dump_memory(&core, sizeof(core), false, 16, 0, 0);
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
-void DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::dump_info()
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
+void DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::dump_info()
 {
     //ReleaseUtils::dump(&core.info, sizeof(core.info));
     dump_memory(&core.info, sizeof(core.info), false, 16, 0, 0);
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
-void DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::dump_detail()
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
+void DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::dump_detail()
 {
     printf("---------------------------------------------------------\n");
     printf("DisruptorRingQueue: (head = %u, tail = %u)\n",
@@ -327,10 +341,10 @@ void DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, Cor
     printf("\n");
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
 inline
-typename DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::size_type
-DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::sizes() const
+typename DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::size_type
+DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::sizes() const
 {
     sequence_type head, tail;
 
@@ -342,13 +356,14 @@ DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>:
     return (size_type)((head - tail) <= kIndexMask) ? (head - tail) : (size_type)(-1);
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
 inline
-void DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::start()
+void DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::start()
 {
     sequence_type cursor = core.cursor.get();
     core.workSequence.set(cursor);
     core.gatingSequenceCache.set(cursor);
+    this->alerted = 0;
 
     int i;
     for (i = 0; i < kConsumersAlloc; ++i) {
@@ -361,18 +376,44 @@ void DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, Cor
     //*/
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
+///
+/// Alert all the consumers, and wake up the ones blocked in waitFor().
+/// The consumers still consume all the published events, then pop()
+/// returns kHalted instead of waiting on an empty queue.
+///
+/// Call it after the producers have stopped, it waits until isDrained(),
+/// see wait_until_drained().
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
 inline
-void DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::shutdown(int32_t timeOut /* = -1 */)
+int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::shutdown(int32_t timeOut /* = -1 */)
 {
-    // TODO: do shutdown procedure
+    this->alerted = 1;
+    Jimi_MemoryBarrier();
+    this->waitStrategy.signalAllWhenBlocking();
+
+    return wait_until_drained(*this, timeOut);
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
+///
+/// All the published events are consumed: the slowest consumer's gating
+/// sequence has reached the cursor, workSequence alone is claimed before
+/// the event is read.
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
+inline
+bool DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::isDrained() const
+{
+    sequence_type cursor = core.cursor.get();
+    return (DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>
+            ::getMinimumSequence(core.gatingSequences, core.workSequence, cursor) >= cursor);
+}
+
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
 /* static */
 inline
-typename DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::sequence_type
-DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::
+typename DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::sequence_type
+DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::
     getMinimumSequence(const Sequence *sequences, const Sequence &workSequence, sequence_type mininum)
 {
     assert(sequences != NULL);
@@ -419,18 +460,19 @@ DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>:
     return minSequence;
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
 inline
-void DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::publish(sequence_type sequence)
+void DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::publish(sequence_type sequence)
 {
     Jimi_WriteCompilerBarrier();
 
     setAvailable(sequence);
+    this->waitStrategy.signalAllWhenBlocking();
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
 inline
-void DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::setAvailable(sequence_type sequence)
+void DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::setAvailable(sequence_type sequence)
 {
     index_type index = (index_type)((index_type)sequence &  kIndexMask);
     flag_type  flag  = (flag_type) (            sequence >> kIndexShift);
@@ -442,9 +484,9 @@ void DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, Cor
     core.availableBuffer[index] = flag;
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
 inline
-bool DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::isAvailable(sequence_type sequence)
+bool DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::isAvailable(sequence_type sequence)
 {
     index_type index = (index_type)((index_type)sequence &  kIndexMask);
     flag_type  flag  = (flag_type) (            sequence >> kIndexShift);
@@ -454,10 +496,10 @@ bool DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, Cor
     return (flagValue == flag);
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
 inline
-typename DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::sequence_type
-DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::
+typename DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::sequence_type
+DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::
         getHighestPublishedSequence(sequence_type lowerBound, sequence_type availableSequence)
 {
     for (sequence_type sequence = lowerBound; sequence <= availableSequence; ++sequence) {
@@ -469,9 +511,9 @@ DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>:
     return availableSequence;
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
-typename DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::Sequence *
-DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::getGatingSequences(int index)
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
+typename DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::Sequence *
+DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::getGatingSequences(int index)
 {
     if (index >= 0 && index < kCapacity) {
         return &core.gatingSequences[index];
@@ -479,9 +521,9 @@ DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>:
     return NULL;
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
 inline
-int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::push(const T & entry)
+int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::push(const T & entry)
 {
     sequence_type current, nextSequence;
     do {
@@ -494,7 +536,7 @@ int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, Core
 
         if (wrapPoint > cachedGatingSequence || cachedGatingSequence > current) {
         //if ((current - cachedGatingSequence) >= kIndexMask) {
-            sequence_type gatingSequence = DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>
+            sequence_type gatingSequence = DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>
                                             ::getMinimumSequence(core.gatingSequences, core.workSequence, current);
             //current = core.cursor.get();
             if (wrapPoint > gatingSequence) {
@@ -533,18 +575,18 @@ int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, Core
     return 0;
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
 inline
-int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::pop(T & entry, PopThreadStackData &stackData)
+int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::pop(T & entry, PopThreadStackData &stackData)
 {
     assert(stackData.tailSequence != NULL);
     return pop(entry, *stackData.tailSequence, stackData.current,
                stackData.cachedAvailableSequence, stackData.processedSequence);
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
 inline
-int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::pop(T & entry, Sequence &tailSequence,
+int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::pop(T & entry, Sequence &tailSequence,
                                                                            sequence_type &nextSequence,
                                                                            sequence_type &cachedAvailableSequence,
                                                                            bool &processedSequence)
@@ -591,54 +633,22 @@ int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, Core
             //cachedAvailableSequence = waitFor(current + 1);
             cachedAvailableSequence = waitFor(nextSequence);
             //tailSequence.set(cachedAvailableSequence);
-            if (cachedAvailableSequence < nextSequence)
+            if (cachedAvailableSequence < nextSequence) {
+                // After shutdown(), nothing will be published any more.
+                if (this->alerted != 0 && core.cursor.get() < nextSequence)
+                    return kHalted;
                 return -1;
+            }
         }
     }
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
 inline
-typename DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::sequence_type
-DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::waitFor(sequence_type sequence)
+typename DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::sequence_type
+DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::waitFor(sequence_type sequence)
 {
-    sequence_type availableSequence;
-
-#if defined(USE_SEQUENCE_SPIN_LOCK) && (USE_SEQUENCE_SPIN_LOCK != 0)
-    static const uint32_t YIELD_THRESHOLD = 20;
-#else
-    static const uint32_t YIELD_THRESHOLD = 8;
-#endif
-    int32_t  pause_cnt;
-    uint32_t loop_cnt, yeild_cnt, spin_cnt;
-
-    loop_cnt = 0;
-    spin_cnt = 1;
-    while ((availableSequence = core.cursor.get()) < sequence) {
-        // Need yiled() or sleep() a while.
-        if (loop_cnt >= YIELD_THRESHOLD) {
-            yeild_cnt = loop_cnt - YIELD_THRESHOLD;
-            if ((yeild_cnt & 63) == 63) {
-                jimi_sleep(1);
-            }
-            else if ((yeild_cnt & 3) == 3) {
-                jimi_sleep(0);
-            }
-            else {
-                if (!jimi_yield()) {
-                    jimi_sleep(0);
-                    //jimi_mm_pause();
-                }
-            }
-        }
-        else {
-            for (pause_cnt = spin_cnt; pause_cnt > 0; --pause_cnt) {
-                jimi_mm_pause();
-            }
-            spin_cnt = spin_cnt + 1;
-        }
-        loop_cnt++;
-    }
+    sequence_type availableSequence = this->waitStrategy.waitFor(sequence, core.cursor, this->alerted);
 
     if (availableSequence < sequence)
         return availableSequence;
@@ -667,7 +677,7 @@ void reserve_code()
         }
 
         if (maybeIsFull || tail < wrapPoint || tail > head) {
-            sequence_type gatingSequence = DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>
+            sequence_type gatingSequence = DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>
                                             ::getMinimumSequence(core.gatingSequences, core.workSequence, head);
             if (maybeIsFull || wrapPoint > gatingSequence) {
                 // Push() failed, maybe queue is full.
@@ -698,9 +708,9 @@ void reserve_code()
 }
 #endif
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
 inline
-int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::q3_push(const T & entry)
+int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::q3_push(const T & entry)
 {
     sequence_type head, tail, next;
     bool ok = false;
@@ -724,9 +734,9 @@ int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, Core
     return 0;
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
 inline
-int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::q3_pop(T & entry)
+int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::q3_pop(T & entry)
 {
     sequence_type head, tail, next;
     bool ok = false;
@@ -749,9 +759,9 @@ int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, Core
     return 0;
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
 inline
-int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::spin_push(const T & entry)
+int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::spin_push(const T & entry)
 {
     sequence_type head, tail, next;
     int32_t pause_cnt;
@@ -827,9 +837,9 @@ int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, Core
     return 0;
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
 inline
-int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::spin_pop(T & entry)
+int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::spin_pop(T & entry)
 {
     sequence_type head, tail, next;
     int32_t pause_cnt;
@@ -905,9 +915,9 @@ int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, Core
     return 0;
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
 inline
-int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::mutex_push(const T & entry)
+int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::mutex_push(const T & entry)
 {
     sequence_type head, tail, next;
 
@@ -933,9 +943,9 @@ int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, Core
     return 0;
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename CoreTy, typename WaitStrategy>
 inline
-int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy>::mutex_pop(T & entry)
+int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, CoreTy, WaitStrategy>::mutex_pop(T & entry)
 {
     sequence_type head, tail, next;
 
@@ -967,13 +977,15 @@ int DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, Core
 ///////////////////////////////////////////////////////////////////
 
 template <typename T, typename SequenceType = int64_t, uint32_t Capacity = 1024U,
-          uint32_t Producers = 0, uint32_t Consumers = 0>
+          uint32_t Producers = 0, uint32_t Consumers = 0,
+          typename WaitStrategy = DefaultWaitStrategy>
 class SmallDisruptorRingQueue : public DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers,
-                                         SmallDisruptorRingQueueCore<T, SequenceType, Capacity, Producers, Consumers> >
+                                         SmallDisruptorRingQueueCore<T, SequenceType, Capacity, Producers, Consumers>,
+                                         WaitStrategy>
 {
 public:
     typedef SmallDisruptorRingQueueCore<T, SequenceType,Capacity, Producers, Consumers> core_type;
-    typedef DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, core_type> parent_type;
+    typedef DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, core_type, WaitStrategy> parent_type;
     
 
     typedef typename parent_type::size_type     size_type;
@@ -1001,8 +1013,8 @@ protected:
     void init_queue(bool bFillQueue = true);
 };
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers>
-SmallDisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers>::
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename WaitStrategy>
+SmallDisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, WaitStrategy>::
     SmallDisruptorRingQueue(bool bFillQueue /* = true */,
                             bool bInitHead  /* = false */)
 : parent_type(bInitHead)
@@ -1010,29 +1022,29 @@ SmallDisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers>::
     init_queue(bFillQueue);
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers>
-SmallDisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers>::~SmallDisruptorRingQueue()
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename WaitStrategy>
+SmallDisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, WaitStrategy>::~SmallDisruptorRingQueue()
 {
     // Do nothing!
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename WaitStrategy>
 inline
-void SmallDisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers>::init_queue(bool bFillQueue /* = true */)
+void SmallDisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, WaitStrategy>::init_queue(bool bFillQueue /* = true */)
 {
     if (bFillQueue) {
         memset((void *)this->core.entries, 0, sizeof(item_type) * kCapacity);
     }
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers>
-void SmallDisruptorRingQueue<T,SequenceType,  Capacity, Producers, Consumers>::dump()
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename WaitStrategy>
+void SmallDisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, WaitStrategy>::dump()
 {
     dump_memory(&this->core, sizeof(this->core), false, 16, 0, 0);
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers>
-void SmallDisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers>::dump_detail()
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename WaitStrategy>
+void SmallDisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, WaitStrategy>::dump_detail()
 {
     printf("SmallRingQueue: (head = %u, tail = %u)\n",
            this->core.info.head, this->core.info.tail);
@@ -1045,13 +1057,15 @@ void SmallDisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers>::d
 ///////////////////////////////////////////////////////////////////
 
 template <typename T, typename SequenceType = int64_t, uint32_t Capacity = 1024U,
-          uint32_t Producers = 0, uint32_t Consumers = 0>
+          uint32_t Producers = 0, uint32_t Consumers = 0,
+          typename WaitStrategy = DefaultWaitStrategy>
 class DisruptorRingQueueOld : public DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers,
-                                    DisruptorRingQueueCore<T, SequenceType, Capacity, Producers, Consumers> >
+                                    DisruptorRingQueueCore<T, SequenceType, Capacity, Producers, Consumers>,
+                                    WaitStrategy>
 {
 public:
     typedef DisruptorRingQueueCore<T, SequenceType, Capacity, Producers, Consumers> core_type;
-    typedef DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, core_type> parent_type;    
+    typedef DisruptorRingQueueBase<T, SequenceType, Capacity, Producers, Consumers, core_type, WaitStrategy> parent_type;    
 
     typedef typename parent_type::size_type     size_type;
     typedef typename parent_type::index_type    index_type;
@@ -1077,16 +1091,16 @@ protected:
     void init_queue(bool bFillQueue = true);
 };
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers>
-DisruptorRingQueueOld<T, SequenceType, Capacity, Producers, Consumers>::DisruptorRingQueueOld(bool bFillQueue /* = true */,
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename WaitStrategy>
+DisruptorRingQueueOld<T, SequenceType, Capacity, Producers, Consumers, WaitStrategy>::DisruptorRingQueueOld(bool bFillQueue /* = true */,
                                                                                         bool bInitHead  /* = false */)
 : parent_type(bInitHead)
 {
     init_queue(bFillQueue);
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers>
-DisruptorRingQueueOld<T, SequenceType, Capacity, Producers, Consumers>::~DisruptorRingQueueOld()
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename WaitStrategy>
+DisruptorRingQueueOld<T, SequenceType, Capacity, Producers, Consumers, WaitStrategy>::~DisruptorRingQueueOld()
 {
     // If the queue is allocated on system heap, release them.
     if (core_type::kIsAllocOnHeap) {
@@ -1102,9 +1116,9 @@ DisruptorRingQueueOld<T, SequenceType, Capacity, Producers, Consumers>::~Disrupt
     }
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename WaitStrategy>
 inline
-void DisruptorRingQueueOld<T, SequenceType, Capacity, Producers, Consumers>::init_queue(bool bFillQueue /* = true */)
+void DisruptorRingQueueOld<T, SequenceType, Capacity, Producers, Consumers, WaitStrategy>::init_queue(bool bFillQueue /* = true */)
 {
     item_type *newData = new T[kCapacity];
     if (newData != NULL) {
@@ -1126,8 +1140,8 @@ void DisruptorRingQueueOld<T, SequenceType, Capacity, Producers, Consumers>::ini
     }
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers>
-void DisruptorRingQueueOld<T, SequenceType, Capacity, Producers, Consumers>::dump_detail()
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers, uint32_t Consumers, typename WaitStrategy>
+void DisruptorRingQueueOld<T, SequenceType, Capacity, Producers, Consumers, WaitStrategy>::dump_detail()
 {
     printf("---------------------------------------------------------\n");
     printf("DisruptorRingQueueOld: (head = %u, tail = %u)\n",
@@ -0,0 +1,219 @@
+
+#ifndef _JIMI_UTIL_FASTFORWARDQUEUE_H_
+#define _JIMI_UTIL_FASTFORWARDQUEUE_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "vs_stdint.h"
+#include "port.h"
+#include "sleep.h"
+#include "Allocator.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>     // For _ReadWriteBarrier(), InterlockedCompareExchange()
+#endif  // _MSC_VER
+#include <emmintrin.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dump_mem.h"
+
+namespace jimi {
+
+///////////////////////////////////////////////////////////////////
+// class FastForwardQueue<T, Capacity, Lookahead, Allocator>
+///////////////////////////////////////////////////////////////////
+
+///
+/// A single producer, single consumer queue of T * (FastForward style),
+/// the same interface as RingQueueBase::push() / pop().
+///
+/// The producer and the consumer share no index at all, the slot itself
+/// tells its state: NULL is free, non-NULL is a valid item. Each side only
+/// keeps its own private index.
+///
+/// Checking one slot per push() or pop() makes both sides fight over the
+/// same cache line when the queue is nearly empty, so each side probes the
+/// slot Lookahead cache lines ahead first. Because the slots are filled
+/// and freed in order, if that slot is free (or valid), all the slots
+/// before it are too, and the side can run up to it without reading any
+/// slot again. If not, the probe distance is halved down to one slot,
+/// so the tail of a burst is never stuck behind the lookahead.
+///
+/// NULL can't be pushed, it means an empty slot.
+///
+template <typename T, uint32_t Capacity = 1024U, uint32_t Lookahead = 4U,
+          typename Allocator = HeapAllocator>
+class FastForwardQueue
+{
+public:
+    typedef uint32_t                    size_type;
+    typedef uint32_t                    index_type;
+    typedef T *                         value_type;
+    typedef T *                         pointer;
+    typedef const T *                   const_pointer;
+    typedef T &                         reference;
+    typedef const T &                   const_reference;
+    typedef Allocator                   allocator_type;
+
+public:
+    static const bool       kIsAllocOnHeap  = true;
+    static const size_type  kCapacity       = (size_type)JIMI_MAX(JIMI_ROUND_TO_POW2(Capacity), 2);
+    static const index_type kMask           = (index_type)(kCapacity - 1);
+    static const size_type  kSlotsPerLine   = (size_type)JIMI_MAX(JIMI_CACHELINE_SIZE / sizeof(value_type), 1);
+    // The probe distance in slots, never more than half of the queue.
+    static const size_type  kLookahead      = (size_type)JIMI_MAX(JIMI_MIN(Lookahead * kSlotsPerLine,
+                                                                           kCapacity / 2), 1);
+
+public:
+    FastForwardQueue();
+    ~FastForwardQueue();
+
+public:
+    void dump_info();
+    void dump_detail();
+
+    index_type mask() const      { return kMask;     };
+    size_type capacity() const   { return kCapacity; };
+
+    void init();
+
+    int push(T * item);
+    T * pop();
+
+protected:
+    // Only touched by the producer.
+    index_type      head;
+    index_type      headLimit;
+    char            padding1[JIMI_CACHELINE_SIZE - 2 * sizeof(index_type)];
+
+    // Only touched by the consumer.
+    index_type      tail;
+    index_type      tailLimit;
+    char            padding2[JIMI_CACHELINE_SIZE - 2 * sizeof(index_type)];
+
+    volatile value_type * entries;
+};
+
+template <typename T, uint32_t Capacity, uint32_t Lookahead, typename Allocator>
+FastForwardQueue<T, Capacity, Lookahead, Allocator>::FastForwardQueue()
+: head(0)
+, headLimit(0)
+, tail(0)
+, tailLimit(0)
+, entries(NULL)
+{
+    init();
+}
+
+template <typename T, uint32_t Capacity, uint32_t Lookahead, typename Allocator>
+FastForwardQueue<T, Capacity, Lookahead, Allocator>::~FastForwardQueue()
+{
+    Jimi_WriteCompilerBarrier();
+
+    // If the queue is allocated on system heap, release them.
+    if (FastForwardQueue<T, Capacity, Lookahead, Allocator>::kIsAllocOnHeap) {
+        if (this->entries != NULL) {
+            delete_array<value_type, Allocator>((value_type *)this->entries, kCapacity);
+            this->entries = NULL;
+        }
+    }
+}
+
+template <typename T, uint32_t Capacity, uint32_t Lookahead, typename Allocator>
+inline
+void FastForwardQueue<T, Capacity, Lookahead, Allocator>::init()
+{
+    this->head = 0;
+    this->headLimit = 0;
+    this->tail = 0;
+    this->tailLimit = 0;
+
+    if (this->entries == NULL)
+        this->entries = new_array<value_type, Allocator>(kCapacity);
+
+    if (this->entries != NULL)
+        memset((void *)this->entries, 0, sizeof(value_type) * kCapacity);
+
+    Jimi_WriteCompilerBarrier();
+}
+
+template <typename T, uint32_t Capacity, uint32_t Lookahead, typename Allocator>
+void FastForwardQueue<T, Capacity, Lookahead, Allocator>::dump_info()
+{
+    dump_memory((void *)this->entries, sizeof(value_type) * JIMI_MIN(kCapacity, 16), false, 16, 0, 0);
+}
+
+template <typename T, uint32_t Capacity, uint32_t Lookahead, typename Allocator>
+void FastForwardQueue<T, Capacity, Lookahead, Allocator>::dump_detail()
+{
+    printf("FastForwardQueue: (head = %u, tail = %u, lookahead = %u)\n",
+           this->head, this->tail, kLookahead);
+}
+
+template <typename T, uint32_t Capacity, uint32_t Lookahead, typename Allocator>
+inline
+int FastForwardQueue<T, Capacity, Lookahead, Allocator>::push(T * item)
+{
+    index_type index, distance;
+
+    index = this->head;
+    if (index == this->headLimit) {
+        // Find out how many slots ahead are free.
+        distance = kLookahead;
+        while (this->entries[(index + distance - 1) & kMask] != NULL) {
+            distance >>= 1;
+            if (distance == 0) {
+                // The slot at head still holds an item, queue is full.
+                return -1;
+            }
+        }
+        Jimi_ReadCompilerBarrier();
+        this->headLimit = index + distance;
+    }
+
+    // The item must be written before the consumer can see the slot.
+    Jimi_WriteCompilerBarrier();
+    this->entries[index & kMask] = item;
+    this->head = index + 1;
+
+    return 0;
+}
+
+template <typename T, uint32_t Capacity, uint32_t Lookahead, typename Allocator>
+inline
+T * FastForwardQueue<T, Capacity, Lookahead, Allocator>::pop()
+{
+    index_type index, distance;
+    value_type item;
+
+    index = this->tail;
+    if (index == this->tailLimit) {
+        // Find out how many slots ahead are valid.
+        distance = kLookahead;
+        while (this->entries[(index + distance - 1) & kMask] == NULL) {
+            distance >>= 1;
+            if (distance == 0) {
+                // The slot at tail is still free, queue is empty.
+                return (value_type)NULL;
+            }
+        }
+        this->tailLimit = index + distance;
+    }
+
+    Jimi_ReadCompilerBarrier();
+    item = this->entries[index & kMask];
+    Jimi_CompilerBarrier();
+    // Free the slot for the producer.
+    this->entries[index & kMask] = NULL;
+    this->tail = index + 1;
+
+    return item;
+}
+
+}  /* namespace jimi */
+
+#endif  /* _JIMI_UTIL_FASTFORWARDQUEUE_H_ */
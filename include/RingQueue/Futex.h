@@ -0,0 +1,259 @@
+
+#ifndef _JIMI_FUTEX_H_
+#define _JIMI_FUTEX_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "vs_stdint.h"
+#include "port.h"
+#include "sleep.h"
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <time.h>
+#include <sys/syscall.h>    // For SYS_futex
+#include <linux/futex.h>    // For FUTEX_WAIT_PRIVATE, FUTEX_WAKE_PRIVATE
+#endif  // __linux__
+
+#include "Sequence.h"
+#include "sys_timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///
+/// Block on *addr while *addr == expected, timeout in millisecs (< 0 is infinite).
+/// It may return spuriously, the caller must recheck its condition.
+///
+/// On the other platforms we have no futex, just give up the time slice.
+///
+static JIMIC_INLINE
+void jimi_futex_wait(volatile uint32_t * addr, uint32_t expected, int32_t timeOut)
+{
+#if defined(__linux__)
+    struct timespec ts, *pts = NULL;
+    if (timeOut >= 0) {
+        ts.tv_sec  = timeOut / 1000;
+        ts.tv_nsec = (long)(timeOut % 1000) * 1000000L;
+        pts = &ts;
+    }
+    syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAIT_PRIVATE, expected, pts, NULL, 0);
+#else
+    if (*addr == expected) {
+        if (timeOut == 0 || !jimi_yield())
+            jimi_sleep(0);
+    }
+#endif
+}
+
+/* Wake up at most count threads blocked on addr. */
+static JIMIC_INLINE
+void jimi_futex_wake(volatile uint32_t * addr, int32_t count)
+{
+#if defined(__linux__)
+    syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+#else
+    // Do nothing!
+#endif
+}
+
+///
+/// Same as jimi_futex_wait(), but addr may be in a memory mapping shared
+/// by several processes (FUTEX_WAIT without FUTEX_PRIVATE_FLAG).
+///
+static JIMIC_INLINE
+void jimi_futex_wait_shared(volatile uint32_t * addr, uint32_t expected, int32_t timeOut)
+{
+#if defined(__linux__)
+    struct timespec ts, *pts = NULL;
+    if (timeOut >= 0) {
+        ts.tv_sec  = timeOut / 1000;
+        ts.tv_nsec = (long)(timeOut % 1000) * 1000000L;
+        pts = &ts;
+    }
+    syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAIT, expected, pts, NULL, 0);
+#else
+    jimi_futex_wait(addr, expected, timeOut);
+#endif
+}
+
+/* Wake up at most count threads (of any process) blocked on addr. */
+static JIMIC_INLINE
+void jimi_futex_wake_shared(volatile uint32_t * addr, int32_t count)
+{
+#if defined(__linux__)
+    syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAKE, count, NULL, NULL, 0);
+#else
+    jimi_futex_wake(addr, count);
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+// Class FutexEvent() use in C++ only
+#ifdef __cplusplus
+
+namespace jimi {
+
+///////////////////////////////////////////////////////////////////
+// class FutexEvent
+///////////////////////////////////////////////////////////////////
+
+///
+/// An event count built on futex, with the wakeup elision.
+///
+/// Consumer:
+///
+///     uint32_t key = event.prepareWait();
+///     if (condition is satisfied)
+///         event.cancelWait();
+///     else
+///         event.wait(key);
+///
+/// Producer:
+///
+///     make the condition satisfied (publish);
+///     event.notifyAll();
+///
+/// notifyAll() only issues FUTEX_WAKE if some consumer is inside
+/// prepareWait() ... wait(), so the busy path pays no syscall.
+///
+/// Construct it with bShared = true if it lives in memory shared by
+/// several processes, it has no pointer, so it can be placed there as is.
+///
+class FutexEvent
+{
+public:
+    FutexEvent(bool bShared = false) : epoch(0), waiters(0), shared(bShared ? 1 : 0) {}
+    ~FutexEvent() {}
+
+public:
+    uint32_t prepareWait() {
+        jimi_fetch_and_add32(&waiters, 1);
+        // The increment of waiters must be visible before we recheck the condition.
+        Jimi_MemoryBarrier();
+        return epoch;
+    }
+
+    void cancelWait() {
+        jimi_fetch_and_add32(&waiters, (uint32_t)(-1));
+    }
+
+    void wait(uint32_t key, int32_t timeOut = -1) {
+        if (shared)
+            jimi_futex_wait_shared(&epoch, key, timeOut);
+        else
+            jimi_futex_wait(&epoch, key, timeOut);
+        jimi_fetch_and_add32(&waiters, (uint32_t)(-1));
+    }
+
+    bool hasWaiters() const {
+        return (waiters != 0);
+    }
+
+    void notifyAll() {
+        // The publish must be visible before we read waiters.
+        Jimi_MemoryBarrier();
+        if (waiters != 0) {
+            jimi_fetch_and_add32(&epoch, 1);
+            wake(INT32_MAX);
+        }
+    }
+
+    void notifyOne() {
+        Jimi_MemoryBarrier();
+        if (waiters != 0) {
+            jimi_fetch_and_add32(&epoch, 1);
+            wake(1);
+        }
+    }
+
+private:
+    void wake(int32_t count) {
+        if (shared)
+            jimi_futex_wake_shared(&epoch, count);
+        else
+            jimi_futex_wake(&epoch, count);
+    }
+
+private:
+    volatile uint32_t   epoch;
+    char                padding1[JIMI_CACHELINE_SIZE - sizeof(uint32_t) * 1];
+    volatile uint32_t   waiters;
+    uint32_t            shared;
+    char                padding2[JIMI_CACHELINE_SIZE - sizeof(uint32_t) * 2];
+};
+
+///////////////////////////////////////////////////////////////////
+// futex_wait_pop<TryPop>()
+///////////////////////////////////////////////////////////////////
+
+///
+/// The blocking loop of the futex_pop() of the queues, the same spin-then-park
+/// as FutexWaitStrategy: call tryPop() until it returns true, pause spinCount
+/// times, then park on event until the producer's notifyOne() / notifyAll().
+/// timeOut is in millisecs of clock time (< 0 is infinite, 0 is only spin).
+/// Returns 0 if tryPop() got an entry, -1 if timeout.
+///
+template <typename TryPop>
+inline
+int futex_wait_pop(FutexEvent & event, TryPop & tryPop, uint32_t spinCount, int32_t timeOut = -1)
+{
+    jmc_timestamp_t startTime = 0, elapsed;
+    int32_t waitTime = -1;
+    uint32_t key;
+
+    if (timeOut >= 0)
+        startTime = jmc_get_millisec();
+
+    while (!tryPop()) {
+        if (spinCount > 0) {
+            jimi_mm_pause();
+            --spinCount;
+            continue;
+        }
+
+        if (timeOut >= 0) {
+            elapsed = jmc_get_millisec() - startTime;
+            if (elapsed >= (jmc_timestamp_t)timeOut)
+                return -1;
+            waitTime = timeOut - (int32_t)elapsed;
+        }
+
+        key = event.prepareWait();
+        if (tryPop()) {
+            event.cancelWait();
+            break;
+        }
+        event.wait(key, waitTime);
+    }
+
+    return 0;
+}
+
+///
+/// The TryPop of futex_wait_pop() for the queues with int pop(T & entry).
+///
+template <typename QueueTy, typename EntryTy>
+struct futex_try_pop
+{
+    QueueTy *   queue;
+    EntryTy *   entry;
+
+    futex_try_pop(QueueTy * _queue, EntryTy * _entry) : queue(_queue), entry(_entry) {}
+
+    bool operator ()() {
+        return (queue->pop(*entry) == 0);
+    }
+};
+
+}  /* namespace jimi */
+
+#endif  /* __cplusplus */
+
+#endif  /* _JIMI_FUTEX_H_ */
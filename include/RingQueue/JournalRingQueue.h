@@ -0,0 +1,647 @@
+
+#ifndef _JIMI_UTIL_JOURNALRINGQUEUE_H_
+#define _JIMI_UTIL_JOURNALRINGQUEUE_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "vs_stdint.h"
+#include "port.h"
+#include "sleep.h"
+
+#ifndef _MSC_VER
+#include <pthread.h>
+#include "msvc/pthread.h"
+#else
+#include "msvc/pthread.h"
+#endif  // !_MSC_VER
+
+#if !defined(_MSC_VER) && !defined(__MINGW32__)
+#define JIMI_HAS_MMAP_JOURNAL   1
+#include <unistd.h>
+#include <fcntl.h>          // For O_CREAT, O_TRUNC, O_RDWR, posix_fallocate()
+#include <sys/mman.h>       // For mmap(), msync()
+#include <sys/stat.h>       // For fstat()
+#include <errno.h>
+#else
+#define JIMI_HAS_MMAP_JOURNAL   0
+#endif  // !_MSC_VER
+
+#include "Sequence.h"
+#include "WaitStrategy.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace jimi {
+
+///////////////////////////////////////////////////////////////////
+// class JournalRingQueue<T, SegmentEvents, MappedSegments>
+///////////////////////////////////////////////////////////////////
+
+///
+/// A multi-producer, single consumer queue whose storage is a chain of
+/// memory mapped segment files in a directory, so every event pushed is
+/// also a journal record which can be replayed after a crash.
+///
+/// Segment k holds the records of sequence [k * SegmentEvents,
+/// (k + 1) * SegmentEvents), a record is the event followed by a stamp,
+/// the stamp is (sequence + 1) once the record is complete. push() claims
+/// a sequence and writes the event straight into the mapped page, then
+/// the stamp. The consumer and replay() only trust a record whose stamp
+/// matches, so a record torn by a crash ends the replay.
+///
+/// Only MappedSegments segments are mapped at a time. The roll stage
+/// (roll(), or the thread of start()) scans the completed records, msync()s
+/// them (MS_ASYNC), and when the consumer has passed the oldest segment,
+/// unmaps it and maps the next one, preallocated with posix_fallocate().
+/// A producer whose segment isn't mapped yet waits for it, so a slow
+/// consumer holds the producers back, like a full ring.
+///
+/// Records reach the page cache as soon as they are written (they survive
+/// a crash of the process), sync() forces them to the disk.
+/// T must be trivially copyable, with no pointer into the process.
+///
+template <typename T, uint32_t SegmentEvents = (1U << 20), uint32_t MappedSegments = 4U>
+class JournalRingQueue
+{
+public:
+    typedef T                           item_type;
+    typedef item_type                   value_type;
+    typedef uint32_t                    size_type;
+    typedef int64_t                     sequence_type;
+    typedef SequenceBase<int64_t>       Sequence;
+    typedef T *                         pointer;
+    typedef const T *                   const_pointer;
+    typedef T &                         reference;
+    typedef const T &                   const_reference;
+
+    struct record_type
+    {
+        T                   event;
+        volatile uint64_t   stamp;
+    };
+
+    ///
+    /// The head of each segment file.
+    ///
+    struct segment_header
+    {
+        uint32_t            magic;
+        uint32_t            version;
+        uint32_t            recordSize;
+        uint32_t            segmentEvents;
+        int64_t             segment;
+        char                padding[JIMI_CACHELINE_SIZE - 4 * sizeof(uint32_t) - sizeof(int64_t)];
+    };
+
+    struct segment_slot
+    {
+        volatile int64_t    segment;
+        char * volatile     base;
+        int                 fd;
+        char                padding[JIMI_CACHELINE_SIZE - sizeof(int64_t) - sizeof(char *) - sizeof(int)];
+    };
+
+public:
+    static const uint32_t   kMagic          = 0x314C524AU;  // "JRL1"
+    static const uint32_t   kVersion        = 1;
+    static const size_type  kSegmentEvents  = (size_type)JIMI_MAX(SegmentEvents, 64);
+    static const size_type  kMappedSegments = (size_type)JIMI_MAX(MappedSegments, 2);
+    static const size_t     kRecordsOffset  = sizeof(segment_header);
+    static const size_t     kSegmentSize    = kRecordsOffset + sizeof(record_type) * kSegmentEvents;
+    static const size_type  kMaxPathLength  = 256;
+    // The spin rounds of wait_record() before it yields.
+    static const uint32_t   kWaitSpinCount  = 64;
+
+public:
+    JournalRingQueue();
+    ~JournalRingQueue();
+
+public:
+    static int segment_path(char * path, size_t size, const char * dir, sequence_type segment);
+    template <typename EventHandler>
+    static sequence_type replay(const char * dir, sequence_type fromSequence, EventHandler & handler);
+
+    int open(const char * dir, sequence_type startSequence = 0);
+    void close();
+
+    int start();
+    void stop();
+    int roll();
+    int sync();
+
+    bool is_open() const    { return (this->slots[0].base != NULL); };
+    bool is_failed() const  { return (this->rollFailed != 0); };
+
+    size_type length() const    { return sizes(); };
+    size_type sizes() const;
+
+    sequence_type published() const { return this->cursor.getOrder();          };
+    sequence_type durable() const   { return this->durableSequence.getOrder(); };
+
+    int push(T const & entry);
+    int pop(T & entry);
+
+protected:
+    static void * PTW32_API roll_task(void * arg);
+
+    int map_segment(sequence_type segment, sequence_type fromSequence);
+    void unmap_segment(segment_slot * slot);
+    record_type * wait_record(sequence_type sequence);
+    record_type * get_record(sequence_type sequence) const;
+
+protected:
+    // Claimed by the producers.
+    Sequence            cursor;
+    // Only written by the consumer.
+    Sequence            tailSequence;
+    // Only written by the roll stage.
+    Sequence            durableSequence;
+
+    segment_slot        slots[kMappedSegments];
+
+    // Only touched by the roll stage.
+    sequence_type       nextSegment;
+    sequence_type       syncedSequence;
+    pthread_t           rollThread;
+    volatile uint32_t   rollQuit;
+    // Set by the roll stage when it can't map the next segment.
+    volatile uint32_t   rollFailed;
+    bool                bRollStarted;
+
+    char                dirPath[kMaxPathLength];
+};
+
+template <typename T, uint32_t SegmentEvents, uint32_t MappedSegments>
+JournalRingQueue<T, SegmentEvents, MappedSegments>::JournalRingQueue()
+: cursor(0)
+, tailSequence(0)
+, durableSequence(0)
+, nextSegment(0)
+, syncedSequence(0)
+, rollQuit(0)
+, rollFailed(0)
+, bRollStarted(false)
+{
+    size_type i;
+    for (i = 0; i < kMappedSegments; ++i) {
+        this->slots[i].segment = -1;
+        this->slots[i].base = NULL;
+        this->slots[i].fd = -1;
+    }
+    this->dirPath[0] = '\0';
+}
+
+template <typename T, uint32_t SegmentEvents, uint32_t MappedSegments>
+JournalRingQueue<T, SegmentEvents, MappedSegments>::~JournalRingQueue()
+{
+    close();
+}
+
+template <typename T, uint32_t SegmentEvents, uint32_t MappedSegments>
+int JournalRingQueue<T, SegmentEvents, MappedSegments>::segment_path(char * path, size_t size,
+                                                                     const char * dir,
+                                                                     sequence_type segment)
+{
+    int len = snprintf(path, size, "%s/%016llx.journal", dir, (unsigned long long)segment);
+    return (len > 0 && (size_t)len < size) ? 0 : -1;
+}
+
+///
+/// Open the journal in dir (it must exist), the first push() gets
+/// startSequence. To go on after a crash, pass the sequence replay()
+/// stopped at, the records after it in the old files are cleared.
+///
+template <typename T, uint32_t SegmentEvents, uint32_t MappedSegments>
+int JournalRingQueue<T, SegmentEvents, MappedSegments>::open(const char * dir,
+                                                             sequence_type startSequence)
+{
+#if defined(JIMI_HAS_MMAP_JOURNAL) && (JIMI_HAS_MMAP_JOURNAL != 0)
+    sequence_type segment;
+    size_type i;
+
+    if (is_open() || dir == NULL || startSequence < 0)
+        return -1;
+    if (strlen(dir) + 32 >= kMaxPathLength)
+        return -1;
+    strcpy(this->dirPath, dir);
+
+    this->cursor.setOrder(startSequence);
+    this->tailSequence.setOrder(startSequence);
+    this->durableSequence.setOrder(startSequence);
+    this->syncedSequence = startSequence;
+    this->rollFailed = 0;
+
+    segment = startSequence / kSegmentEvents;
+    for (i = 0; i < kMappedSegments; ++i) {
+        if (map_segment(segment + i, startSequence) != 0) {
+            close();
+            return -1;
+        }
+    }
+    this->nextSegment = segment + kMappedSegments;
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+template <typename T, uint32_t SegmentEvents, uint32_t MappedSegments>
+void JournalRingQueue<T, SegmentEvents, MappedSegments>::close()
+{
+    size_type i;
+
+    stop();
+    if (is_open())
+        sync();
+    for (i = 0; i < kMappedSegments; ++i)
+        unmap_segment(&this->slots[i]);
+}
+
+///
+/// Map segment into its slot. A segment after fromSequence is created
+/// empty, the one holding fromSequence keeps the records before it.
+///
+template <typename T, uint32_t SegmentEvents, uint32_t MappedSegments>
+int JournalRingQueue<T, SegmentEvents, MappedSegments>::map_segment(sequence_type segment,
+                                                                    sequence_type fromSequence)
+{
+#if defined(JIMI_HAS_MMAP_JOURNAL) && (JIMI_HAS_MMAP_JOURNAL != 0)
+    char path[kMaxPathLength];
+    segment_slot * slot;
+    segment_header * header;
+    sequence_type first, skip;
+    void * base;
+    int fd, flags;
+
+    if (segment_path(path, sizeof(path), this->dirPath, segment) != 0)
+        return -1;
+
+    first = segment * kSegmentEvents;
+    flags = O_CREAT | O_RDWR;
+    if (first >= fromSequence)
+        flags |= O_TRUNC;
+
+    fd = ::open(path, flags, 0644);
+    if (fd < 0)
+        return -1;
+
+    // Reserve the blocks now, so a full disk fails here, not with
+    // a SIGBUS in a producer.
+    if (ftruncate(fd, (off_t)kSegmentSize) != 0
+        || posix_fallocate(fd, 0, (off_t)kSegmentSize) != 0) {
+        ::close(fd);
+        return -1;
+    }
+
+    base = mmap(NULL, kSegmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        ::close(fd);
+        return -1;
+    }
+
+    header = (segment_header *)base;
+    header->magic         = kMagic;
+    header->version       = kVersion;
+    header->recordSize    = (uint32_t)sizeof(record_type);
+    header->segmentEvents = kSegmentEvents;
+    header->segment       = segment;
+
+    if (first < fromSequence) {
+        // Clear the records left after fromSequence by an old run.
+        skip = fromSequence - first;
+        memset((char *)base + kRecordsOffset + sizeof(record_type) * (size_t)skip, 0,
+               sizeof(record_type) * (size_t)(kSegmentEvents - skip));
+    }
+
+    slot = &this->slots[segment % kMappedSegments];
+    slot->fd = fd;
+    slot->base = (char *)base;
+    // The mapping must be seen before the producers can see the segment.
+    Jimi_WriteMemoryBarrier();
+    slot->segment = segment;
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+template <typename T, uint32_t SegmentEvents, uint32_t MappedSegments>
+void JournalRingQueue<T, SegmentEvents, MappedSegments>::unmap_segment(segment_slot * slot)
+{
+#if defined(JIMI_HAS_MMAP_JOURNAL) && (JIMI_HAS_MMAP_JOURNAL != 0)
+    char * base = slot->base;
+
+    slot->segment = -1;
+    Jimi_WriteMemoryBarrier();
+    if (base != NULL) {
+        msync((void *)base, kSegmentSize, MS_ASYNC);
+        munmap((void *)base, kSegmentSize);
+        slot->base = NULL;
+    }
+    if (slot->fd >= 0) {
+        ::close(slot->fd);
+        slot->fd = -1;
+    }
+#endif
+}
+
+///
+/// Force every mapped segment to the disk (MS_SYNC).
+///
+template <typename T, uint32_t SegmentEvents, uint32_t MappedSegments>
+int JournalRingQueue<T, SegmentEvents, MappedSegments>::sync()
+{
+#if defined(JIMI_HAS_MMAP_JOURNAL) && (JIMI_HAS_MMAP_JOURNAL != 0)
+    size_type i;
+    int ret = 0;
+
+    for (i = 0; i < kMappedSegments; ++i) {
+        if (this->slots[i].base != NULL) {
+            if (msync((void *)this->slots[i].base, kSegmentSize, MS_SYNC) != 0)
+                ret = -1;
+        }
+    }
+    return ret;
+#else
+    return -1;
+#endif
+}
+
+///
+/// One pass of the roll stage, only one thread may call it. Returns the
+/// number of records and segments it has handled, 0 if it had nothing
+/// to do, or -1 if it failed to map the next segment. After a failure
+/// is_failed() is true, and push() returns -1 instead of waiting for
+/// the segment.
+///
+template <typename T, uint32_t SegmentEvents, uint32_t MappedSegments>
+int JournalRingQueue<T, SegmentEvents, MappedSegments>::roll()
+{
+#if defined(JIMI_HAS_MMAP_JOURNAL) && (JIMI_HAS_MMAP_JOURNAL != 0)
+    segment_slot * slot;
+    sequence_type durable, segmentEnd, oldest, tail;
+    size_t pageSize, start, end;
+    char * base;
+    int done = 0;
+
+    if (!is_open())
+        return -1;
+
+    // Scan the completed records of the current segment.
+    durable = this->durableSequence.get();
+    segmentEnd = (durable / kSegmentEvents + 1) * kSegmentEvents;
+    slot = &this->slots[(durable / kSegmentEvents) % kMappedSegments];
+    if (slot->segment == durable / kSegmentEvents) {
+        while (durable < segmentEnd) {
+            if (get_record(durable)->stamp != (uint64_t)(durable + 1))
+                break;
+            ++durable;
+            ++done;
+        }
+    }
+
+    // Hand the new records to the kernel, a page at a time.
+    if (durable != this->syncedSequence) {
+        pageSize = (size_t)sysconf(_SC_PAGESIZE);
+        base = slot->base;
+        start = kRecordsOffset + sizeof(record_type) * (size_t)(this->syncedSequence % kSegmentEvents);
+        end   = kRecordsOffset + sizeof(record_type) * (size_t)((durable - 1) % kSegmentEvents + 1);
+        start &= ~(pageSize - 1);
+        msync((void *)(base + start), end - start, MS_ASYNC);
+        this->syncedSequence = durable;
+        this->durableSequence.setOrder(durable);
+    }
+
+    // Move the window once the consumer has left the oldest segment.
+    tail = this->tailSequence.getOrder();
+    oldest = this->nextSegment - kMappedSegments;
+    while ((oldest + 1) * kSegmentEvents <= tail && (oldest + 1) * kSegmentEvents <= durable) {
+        unmap_segment(&this->slots[oldest % kMappedSegments]);
+        if (map_segment(this->nextSegment, this->nextSegment * kSegmentEvents) != 0) {
+            this->rollFailed = 1;
+            Jimi_WriteMemoryBarrier();
+            return -1;
+        }
+        this->nextSegment++;
+        oldest++;
+        ++done;
+    }
+    return done;
+#else
+    return -1;
+#endif
+}
+
+template <typename T, uint32_t SegmentEvents, uint32_t MappedSegments>
+void * PTW32_API JournalRingQueue<T, SegmentEvents, MappedSegments>::roll_task(void * arg)
+{
+    JournalRingQueue * journal = (JournalRingQueue *)arg;
+    int done;
+
+    while (journal->rollQuit == 0) {
+        done = journal->roll();
+        if (done < 0) {
+            // roll() has set rollFailed, the waiting producers give up.
+            break;
+        }
+        else if (done == 0)
+            jimi_yield();
+    }
+    return NULL;
+}
+
+///
+/// Start a thread which calls roll() until stop().
+///
+template <typename T, uint32_t SegmentEvents, uint32_t MappedSegments>
+int JournalRingQueue<T, SegmentEvents, MappedSegments>::start()
+{
+    if (!is_open() || this->bRollStarted)
+        return -1;
+
+    this->rollQuit = 0;
+    if (pthread_create(&this->rollThread, NULL, roll_task, (void *)this) != 0)
+        return -1;
+    this->bRollStarted = true;
+    return 0;
+}
+
+template <typename T, uint32_t SegmentEvents, uint32_t MappedSegments>
+void JournalRingQueue<T, SegmentEvents, MappedSegments>::stop()
+{
+    if (this->bRollStarted) {
+        this->rollQuit = 1;
+        pthread_join(this->rollThread, NULL);
+        this->bRollStarted = false;
+        // Pick up the records written after the last pass.
+        roll();
+    }
+}
+
+template <typename T, uint32_t SegmentEvents, uint32_t MappedSegments>
+inline
+typename JournalRingQueue<T, SegmentEvents, MappedSegments>::size_type
+JournalRingQueue<T, SegmentEvents, MappedSegments>::sizes() const
+{
+    sequence_type head, tail;
+
+    tail = this->tailSequence.getOrder();
+    head = this->cursor.getOrder();
+
+    return (head > tail) ? (size_type)(head - tail) : 0;
+}
+
+template <typename T, uint32_t SegmentEvents, uint32_t MappedSegments>
+inline
+typename JournalRingQueue<T, SegmentEvents, MappedSegments>::record_type *
+JournalRingQueue<T, SegmentEvents, MappedSegments>::get_record(sequence_type sequence) const
+{
+    const segment_slot * slot = &this->slots[(sequence / kSegmentEvents) % kMappedSegments];
+    return (record_type *)(slot->base + kRecordsOffset) + (size_t)(sequence % kSegmentEvents);
+}
+
+///
+/// Wait until the segment of sequence is mapped, returns NULL if the roll
+/// stage has failed, the segment will never be mapped then.
+///
+template <typename T, uint32_t SegmentEvents, uint32_t MappedSegments>
+inline
+typename JournalRingQueue<T, SegmentEvents, MappedSegments>::record_type *
+JournalRingQueue<T, SegmentEvents, MappedSegments>::wait_record(sequence_type sequence)
+{
+    sequence_type segment = sequence / kSegmentEvents;
+    segment_slot * slot = &this->slots[segment % kMappedSegments];
+    uint32_t loop_cnt = 0;
+
+    while (slot->segment != segment) {
+        if (this->rollFailed != 0)
+            return NULL;
+        spin_yield_backoff(loop_cnt, kWaitSpinCount);
+    }
+    Jimi_ReadMemoryBarrier();
+    return get_record(sequence);
+}
+
+///
+/// Claim a sequence and write the record. It waits if the segment isn't
+/// mapped yet, so the roll stage must be running. Returns -1 if the roll
+/// stage has failed (see roll()), the claimed sequence is lost then.
+///
+template <typename T, uint32_t SegmentEvents, uint32_t MappedSegments>
+inline
+int JournalRingQueue<T, SegmentEvents, MappedSegments>::push(T const & entry)
+{
+    sequence_type sequence;
+    record_type * record;
+
+    sequence = this->cursor.fetchAndAdd(1);
+    record = wait_record(sequence);
+    if (record == NULL)
+        return -1;
+    record->event = entry;
+
+    // The event must be written before the stamp.
+    Jimi_WriteCompilerBarrier();
+    record->stamp = (uint64_t)(sequence + 1);
+    return 0;
+}
+
+template <typename T, uint32_t SegmentEvents, uint32_t MappedSegments>
+inline
+int JournalRingQueue<T, SegmentEvents, MappedSegments>::pop(T & entry)
+{
+    sequence_type sequence;
+    record_type * record;
+
+    sequence = this->tailSequence.get();
+    if (this->slots[(sequence / kSegmentEvents) % kMappedSegments].segment != sequence / kSegmentEvents)
+        return -1;
+
+    record = get_record(sequence);
+    if (record->stamp != (uint64_t)(sequence + 1))
+        return -1;
+
+    Jimi_ReadCompilerBarrier();
+    entry = record->event;
+
+    Jimi_CompilerBarrier();
+    this->tailSequence.setOrder(sequence + 1);
+    return 0;
+}
+
+///
+/// Read the journal in dir from fromSequence, calls handler(event, sequence)
+/// for each record until the first missing or torn one. Returns the sequence
+/// it stopped at (the next one to write), or -1 on error.
+///
+template <typename T, uint32_t SegmentEvents, uint32_t MappedSegments>
+template <typename EventHandler>
+typename JournalRingQueue<T, SegmentEvents, MappedSegments>::sequence_type
+JournalRingQueue<T, SegmentEvents, MappedSegments>::replay(const char * dir,
+                                                           sequence_type fromSequence,
+                                                           EventHandler & handler)
+{
+#if defined(JIMI_HAS_MMAP_JOURNAL) && (JIMI_HAS_MMAP_JOURNAL != 0)
+    char path[kMaxPathLength];
+    struct stat st;
+    segment_header * header;
+    record_type * records;
+    sequence_type sequence, segment, segmentEnd;
+    void * base;
+    int fd;
+
+    if (dir == NULL || fromSequence < 0)
+        return -1;
+
+    sequence = fromSequence;
+    for (;;) {
+        segment = sequence / kSegmentEvents;
+        if (segment_path(path, sizeof(path), dir, segment) != 0)
+            return -1;
+
+        fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            break;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < kSegmentSize) {
+            ::close(fd);
+            break;
+        }
+        base = mmap(NULL, kSegmentSize, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED)
+            break;
+
+        header = (segment_header *)base;
+        if (header->magic != kMagic || header->version != kVersion
+            || header->recordSize != (uint32_t)sizeof(record_type)
+            || header->segmentEvents != kSegmentEvents || header->segment != segment) {
+            munmap(base, kSegmentSize);
+            break;
+        }
+
+        records = (record_type *)((char *)base + kRecordsOffset);
+        segmentEnd = (segment + 1) * kSegmentEvents;
+        while (sequence < segmentEnd) {
+            record_type * record = &records[sequence % kSegmentEvents];
+            if (record->stamp != (uint64_t)(sequence + 1))
+                break;
+            handler(record->event, sequence);
+            ++sequence;
+        }
+        munmap(base, kSegmentSize);
+
+        if (sequence < segmentEnd)
+            break;
+    }
+    return sequence;
+#else
+    return -1;
+#endif
+}
+
+}  /* namespace jimi */
+
+#endif  /* _JIMI_UTIL_JOURNALRINGQUEUE_H_ */
@@ -0,0 +1,404 @@
+
+#ifndef _JIMI_UTIL_LINKEDRINGQUEUE_H_
+#define _JIMI_UTIL_LINKEDRINGQUEUE_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "vs_stdint.h"
+#include "port.h"
+#include "sleep.h"
+#include "Allocator.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>     // For _ReadWriteBarrier(), InterlockedCompareExchange()
+#endif  // _MSC_VER
+#include <emmintrin.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "SpinMutex.h"
+
+namespace jimi {
+
+///////////////////////////////////////////////////////////////////
+// class LinkedRingQueue<T, SegmentSize, MaxThreads, Allocator>
+///////////////////////////////////////////////////////////////////
+
+///
+/// An unbounded multi-producer multi-consumer queue of T *, made of linked
+/// fixed-size ring segments, in the spirit of LCRQ. push() never fails
+/// because the queue is full.
+///
+/// Fast path: a producer takes a slot of the tail segment with one
+/// fetch-and-add on enqIndex, then CAS the item into the empty slot; a
+/// consumer takes a slot of the head segment with one fetch-and-add on
+/// deqIndex, then swaps the item out and leaves a "taken" mark. If the
+/// consumer comes first, the producer's CAS fails and it takes another
+/// slot, so no item is lost or read twice.
+///
+/// When all the slots of the tail segment are taken, the segment is closed:
+/// the producer that gets there first links a new segment after it. Each
+/// slot is used once, so no double-width CAS is needed (unlike the CRQ cells).
+///
+/// Drained segments are unlinked by the consumers and recycled through a
+/// free list, so a queue in steady state does no allocation. A segment is
+/// only recycled when no thread holds a hazard pointer to it, that's why
+/// every thread calls registerThread() once and passes its id to push()
+/// and pop().
+///
+template <typename T, uint32_t SegmentSize = 1024U, uint32_t MaxThreads = 16U,
+          typename Allocator = HeapAllocator>
+class LinkedRingQueue
+{
+public:
+    typedef uint32_t                    size_type;
+    typedef uint32_t                    index_type;
+    typedef T *                         value_type;
+    typedef T *                         pointer;
+    typedef const T *                   const_pointer;
+    typedef T &                         reference;
+    typedef const T &                   const_reference;
+    typedef Allocator                   allocator_type;
+
+    struct segment_type
+    {
+        volatile index_type     deqIndex;
+        char                    padding1[JIMI_CACHELINE_SIZE - sizeof(index_type)];
+        volatile index_type     enqIndex;
+        char                    padding2[JIMI_CACHELINE_SIZE - sizeof(index_type)];
+        segment_type * volatile next;
+        char                    padding3[JIMI_CACHELINE_SIZE - sizeof(segment_type *)];
+
+        value_type volatile     items[(SegmentSize > 1) ? SegmentSize : 2];
+    };
+
+public:
+    static const size_type  kSegmentSize    = (SegmentSize > 1) ? SegmentSize : 2;
+    static const size_type  kMaxThreads     = (MaxThreads > 0) ? MaxThreads : 1;
+    /* A thread scans the hazard pointers after this many retired segments. */
+    static const size_type  kMaxRetired     = kMaxThreads * 2;
+
+public:
+    LinkedRingQueue();
+    ~LinkedRingQueue();
+
+public:
+    void dump_detail();
+
+    size_type segment_size() const  { return kSegmentSize; };
+    size_type allocated() const     { return allocatedSegments; };
+
+    int registerThread();
+
+    int push(T * item, int threadId);
+    T * pop(int threadId);
+
+protected:
+    segment_type * protect(int threadId, segment_type * volatile * source);
+    void retire(int threadId, segment_type * segment);
+
+    segment_type * allocSegment();
+    void releaseSegment(segment_type * segment);
+
+private:
+    struct HazardPointer
+    {
+        segment_type * volatile segment;
+        char                    padding[JIMI_CACHELINE_SIZE - sizeof(segment_type *)];
+    };
+
+    struct RetiredList
+    {
+        segment_type *          segments[kMaxRetired];
+        size_type               count;
+        char                    padding[JIMI_CACHELINE_SIZE - sizeof(size_type)];
+    };
+
+    static value_type takenItem() { return (value_type)(uintptr_t)1; }
+
+protected:
+    segment_type * volatile head;
+    char                    padding1[JIMI_CACHELINE_SIZE - sizeof(segment_type *)];
+    segment_type * volatile tail;
+    char                    padding2[JIMI_CACHELINE_SIZE - sizeof(segment_type *)];
+    volatile uint32_t       registeredThreads;
+    volatile uint32_t       allocatedSegments;
+    char                    padding3[JIMI_CACHELINE_SIZE - 2 * sizeof(uint32_t)];
+
+    HazardPointer           hazards[kMaxThreads];
+    RetiredList             retired[kMaxThreads];
+
+    segment_type *          freeList;
+    SpinMutex<>             poolLock;
+};
+
+template <typename T, uint32_t SegmentSize, uint32_t MaxThreads, typename Allocator>
+LinkedRingQueue<T, SegmentSize, MaxThreads, Allocator>::LinkedRingQueue()
+: head(NULL)
+, tail(NULL)
+, registeredThreads(0)
+, allocatedSegments(0)
+, freeList(NULL)
+{
+    segment_type * segment;
+    size_type i;
+
+    for (i = 0; i < kMaxThreads; ++i) {
+        this->hazards[i].segment = NULL;
+        this->retired[i].count = 0;
+    }
+
+    segment = allocSegment();
+    this->head = segment;
+    this->tail = segment;
+
+    Jimi_WriteCompilerBarrier();
+}
+
+template <typename T, uint32_t SegmentSize, uint32_t MaxThreads, typename Allocator>
+LinkedRingQueue<T, SegmentSize, MaxThreads, Allocator>::~LinkedRingQueue()
+{
+    segment_type * segment, * next;
+    size_type i, j;
+
+    Jimi_CompilerBarrier();
+
+    for (segment = this->head; segment != NULL; segment = next) {
+        next = segment->next;
+        delete_array<segment_type, Allocator>(segment, 1);
+    }
+    for (segment = this->freeList; segment != NULL; segment = next) {
+        next = segment->next;
+        delete_array<segment_type, Allocator>(segment, 1);
+    }
+    for (i = 0; i < kMaxThreads; ++i) {
+        for (j = 0; j < this->retired[i].count; ++j)
+            delete_array<segment_type, Allocator>(this->retired[i].segments[j], 1);
+        this->retired[i].count = 0;
+    }
+
+    this->head = NULL;
+    this->tail = NULL;
+    this->freeList = NULL;
+}
+
+template <typename T, uint32_t SegmentSize, uint32_t MaxThreads, typename Allocator>
+void LinkedRingQueue<T, SegmentSize, MaxThreads, Allocator>::dump_detail()
+{
+    printf("LinkedRingQueue: (segment size = %u, threads = %u, segments allocated = %u)\n",
+           kSegmentSize, this->registeredThreads, this->allocatedSegments);
+}
+
+///
+/// Give the calling thread its own hazard pointer and retired list.
+/// Returns -1 if all the kMaxThreads slots are taken.
+///
+template <typename T, uint32_t SegmentSize, uint32_t MaxThreads, typename Allocator>
+inline
+int LinkedRingQueue<T, SegmentSize, MaxThreads, Allocator>::registerThread()
+{
+    uint32_t threadId = jimi_fetch_and_add32(&this->registeredThreads, 1);
+    if (threadId >= kMaxThreads)
+        return -1;
+    return (int)threadId;
+}
+
+///
+/// Read *source and publish it as the hazard pointer of threadId, until
+/// *source still points to the same segment after the publication.
+///
+template <typename T, uint32_t SegmentSize, uint32_t MaxThreads, typename Allocator>
+inline
+typename LinkedRingQueue<T, SegmentSize, MaxThreads, Allocator>::segment_type *
+LinkedRingQueue<T, SegmentSize, MaxThreads, Allocator>::protect(int threadId, segment_type * volatile * source)
+{
+    segment_type * segment;
+    do {
+        segment = *source;
+        // The locked exchange is also the store-load barrier.
+        (void)jimi_lock_test_and_set_ptr(&this->hazards[threadId].segment, segment);
+    } while (segment != *source);
+    return segment;
+}
+
+template <typename T, uint32_t SegmentSize, uint32_t MaxThreads, typename Allocator>
+inline
+void LinkedRingQueue<T, SegmentSize, MaxThreads, Allocator>::retire(int threadId, segment_type * segment)
+{
+    RetiredList & list = this->retired[threadId];
+    segment_type * retiredSegment;
+    size_type i, j, threads, count;
+    bool isHazard;
+
+    list.segments[list.count++] = segment;
+    if (list.count < kMaxRetired)
+        return;
+
+    Jimi_FullMemoryBarrier();
+
+    threads = this->registeredThreads;
+    if (threads > kMaxThreads)
+        threads = kMaxThreads;
+
+    // At most kMaxThreads segments are protected, so at least half of the list is freed.
+    count = 0;
+    for (i = 0; i < list.count; ++i) {
+        retiredSegment = list.segments[i];
+        isHazard = false;
+        for (j = 0; j < threads; ++j) {
+            if (this->hazards[j].segment == retiredSegment) {
+                isHazard = true;
+                break;
+            }
+        }
+        if (isHazard)
+            list.segments[count++] = retiredSegment;
+        else
+            releaseSegment(retiredSegment);
+    }
+    list.count = count;
+}
+
+template <typename T, uint32_t SegmentSize, uint32_t MaxThreads, typename Allocator>
+inline
+typename LinkedRingQueue<T, SegmentSize, MaxThreads, Allocator>::segment_type *
+LinkedRingQueue<T, SegmentSize, MaxThreads, Allocator>::allocSegment()
+{
+    segment_type * segment;
+
+    this->poolLock.lock();
+    segment = this->freeList;
+    if (segment != NULL)
+        this->freeList = segment->next;
+    this->poolLock.unlock();
+
+    if (segment == NULL) {
+        segment = new_array<segment_type, Allocator>(1);
+        if (segment == NULL)
+            return NULL;
+        jimi_fetch_and_add32(&this->allocatedSegments, 1);
+    }
+
+    segment->deqIndex = 0;
+    segment->enqIndex = 0;
+    segment->next = NULL;
+    memset((void *)segment->items, 0, sizeof(segment->items));
+    return segment;
+}
+
+template <typename T, uint32_t SegmentSize, uint32_t MaxThreads, typename Allocator>
+inline
+void LinkedRingQueue<T, SegmentSize, MaxThreads, Allocator>::releaseSegment(segment_type * segment)
+{
+    this->poolLock.lock();
+    segment->next = this->freeList;
+    this->freeList = segment;
+    this->poolLock.unlock();
+}
+
+///
+/// Returns -1 only if a new segment can't be allocated.
+///
+template <typename T, uint32_t SegmentSize, uint32_t MaxThreads, typename Allocator>
+inline
+int LinkedRingQueue<T, SegmentSize, MaxThreads, Allocator>::push(T * item, int threadId)
+{
+    segment_type * segment, * next, * newSegment;
+    index_type index;
+    int result = 0;
+
+    assert(threadId >= 0 && threadId < (int)kMaxThreads);
+    assert(item != NULL && item != takenItem());
+
+    while (true) {
+        segment = protect(threadId, &this->tail);
+
+        index = jimi_fetch_and_add32(&segment->enqIndex, 1);
+        if (index < kSegmentSize) {
+            if (jimi_bool_compare_and_swap_ptr(&segment->items[index], NULL, item))
+                break;
+            // A consumer has given up this slot, take the next one.
+            continue;
+        }
+
+        // The segment is closed, link a new one after it.
+        if (segment != this->tail)
+            continue;
+        next = segment->next;
+        if (next == NULL) {
+            newSegment = allocSegment();
+            if (newSegment == NULL) {
+                result = -1;
+                break;
+            }
+            newSegment->items[0] = item;
+            newSegment->enqIndex = 1;
+            Jimi_WriteCompilerBarrier();
+            if (jimi_bool_compare_and_swap_ptr(&segment->next, NULL, newSegment)) {
+                jimi_bool_compare_and_swap_ptr(&this->tail, segment, newSegment);
+                break;
+            }
+            // Another producer won, nobody has seen our segment.
+            releaseSegment(newSegment);
+        }
+        else {
+            jimi_bool_compare_and_swap_ptr(&this->tail, segment, next);
+        }
+    }
+
+    this->hazards[threadId].segment = NULL;
+    return result;
+}
+
+template <typename T, uint32_t SegmentSize, uint32_t MaxThreads, typename Allocator>
+inline
+T * LinkedRingQueue<T, SegmentSize, MaxThreads, Allocator>::pop(int threadId)
+{
+    segment_type * segment, * next;
+    value_type item;
+    index_type index;
+
+    assert(threadId >= 0 && threadId < (int)kMaxThreads);
+
+    while (true) {
+        segment = protect(threadId, &this->head);
+
+        if (segment->deqIndex >= segment->enqIndex && segment->next == NULL) {
+            // Queue is empty.
+            item = NULL;
+            break;
+        }
+
+        index = jimi_fetch_and_add32(&segment->deqIndex, 1);
+        if (index < kSegmentSize) {
+            item = (value_type)jimi_lock_test_and_set_ptr(&segment->items[index], takenItem());
+            if (item != NULL)
+                break;
+            // The producer hasn't written this slot yet, it will take another one.
+            continue;
+        }
+
+        // All the slots of the segment are taken.
+        next = segment->next;
+        if (next == NULL) {
+            item = NULL;
+            break;
+        }
+        // Never let tail point to an unlinked segment.
+        if (segment == this->tail)
+            jimi_bool_compare_and_swap_ptr(&this->tail, segment, next);
+        if (jimi_bool_compare_and_swap_ptr(&this->head, segment, next))
+            retire(threadId, segment);
+    }
+
+    this->hazards[threadId].segment = NULL;
+    return item;
+}
+
+}  /* namespace jimi */
+
+#endif  /* _JIMI_UTIL_LINKEDRINGQUEUE_H_ */
@@ -0,0 +1,307 @@
+
+#ifndef _JIMI_UTIL_MESHRINGQUEUE_H_
+#define _JIMI_UTIL_MESHRINGQUEUE_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "vs_stdint.h"
+#include "port.h"
+#include "sleep.h"
+
+#include "SingleRingQueue.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+namespace jimi {
+
+///////////////////////////////////////////////////////////////////
+// class MeshRingQueue<T, Producers, Consumers, LaneCapacity, Burst, Allocator>
+///////////////////////////////////////////////////////////////////
+
+///
+/// A multi-producer multi-consumer queue of T * made of one SingleRingQueue
+/// (a lane) per producer-consumer pair, so no two threads ever write the
+/// same index. Every thread passes its own id to push() / pop(), producer
+/// ids in [0, Producers), consumer ids in [0, Consumers).
+///
+/// A producer picks the lane of the next consumer in round-robin order, or
+/// the lane of (key % Consumers) with the keyed push(). push() returns -1
+/// if that lane is full, it doesn't move on to another lane, so with the
+/// round-robin push() every consumer gets the same share of the items.
+///
+/// Each consumer has a "lanes with data" bitmap, bit p is set by producer p
+/// after it pushes into the lane, and cleared by the consumer when it finds
+/// the lane empty. The consumer takes up to Burst items from a lane, then
+/// moves on to the next lane with its bit set (round-robin), so a busy
+/// producer can't starve the others. A bit may be cleared just after a push,
+/// so when the bitmap is empty the consumer scans all its lanes once.
+///
+/// Producers must be in [1, 32] (the width of the bitmap), it's checked
+/// at compile time.
+///
+template <typename T, uint32_t Producers, uint32_t Consumers,
+          uint32_t LaneCapacity = 1024U, uint32_t Burst = 32U,
+          typename Allocator = HeapAllocator>
+class MeshRingQueue
+{
+public:
+    typedef uint32_t                    size_type;
+    typedef uint32_t                    index_type;
+    typedef T *                         value_type;
+    typedef T *                         pointer;
+    typedef const T *                   const_pointer;
+    typedef T &                         reference;
+    typedef const T &                   const_reference;
+    typedef Allocator                   allocator_type;
+
+    typedef SingleRingQueue<value_type, uint32_t, LaneCapacity, 1U, Allocator>    lane_type;
+
+    struct producer_state
+    {
+        index_type      nextLane;
+        char            padding[JIMI_CACHELINE_SIZE - 1 * sizeof(index_type)];
+    };
+
+    struct consumer_state
+    {
+        // Shared with the producers.
+        volatile uint32_t laneBits;
+        char            padding1[JIMI_CACHELINE_SIZE - 1 * sizeof(uint32_t)];
+        // Only touched by the consumer.
+        index_type      cursor;
+        uint32_t        burst;
+        char            padding2[JIMI_CACHELINE_SIZE - 2 * sizeof(uint32_t)];
+    };
+
+public:
+    JIMI_STATIC_ASSERT(Producers >= 1 && Producers <= 32,
+                       "MeshRingQueue: Producers must be in [1, 32], the width of the lane bitmap.");
+    JIMI_STATIC_ASSERT(Consumers >= 1, "MeshRingQueue: Consumers must be at least 1.");
+
+    static const size_type  kProducers      = (size_type)Producers;
+    static const size_type  kConsumers      = (size_type)Consumers;
+    static const size_type  kLanes          = kProducers * kConsumers;
+    static const uint32_t   kBurst          = (uint32_t)JIMI_MAX(Burst, 1);
+
+public:
+    MeshRingQueue();
+    ~MeshRingQueue();
+
+public:
+    void dump_detail();
+
+    size_type lanes() const      { return kLanes; };
+    size_type length() const     { return sizes(); };
+    size_type sizes() const;
+
+    void init();
+
+    int push(T * item, int producerId);
+    int push(T * item, int producerId, uint32_t key);
+    T * pop(int consumerId);
+
+protected:
+    lane_type & lane(index_type producer, index_type consumer) {
+        return this->laneList[consumer * kProducers + producer];
+    }
+
+    int push_lane(T * item, index_type producer, index_type consumer);
+    uint32_t rescan(index_type consumer);
+
+protected:
+    producer_state  producers[kProducers];
+    consumer_state  consumers[kConsumers];
+    lane_type *     laneList;
+};
+
+template <typename T, uint32_t Producers, uint32_t Consumers, uint32_t LaneCapacity, uint32_t Burst, typename Allocator>
+MeshRingQueue<T, Producers, Consumers, LaneCapacity, Burst, Allocator>::MeshRingQueue()
+: laneList(NULL)
+{
+    init();
+}
+
+template <typename T, uint32_t Producers, uint32_t Consumers, uint32_t LaneCapacity, uint32_t Burst, typename Allocator>
+MeshRingQueue<T, Producers, Consumers, LaneCapacity, Burst, Allocator>::~MeshRingQueue()
+{
+    Jimi_WriteCompilerBarrier();
+
+    if (this->laneList != NULL) {
+        delete_array<lane_type, Allocator>(this->laneList, kLanes);
+        this->laneList = NULL;
+    }
+}
+
+template <typename T, uint32_t Producers, uint32_t Consumers, uint32_t LaneCapacity, uint32_t Burst, typename Allocator>
+inline
+void MeshRingQueue<T, Producers, Consumers, LaneCapacity, Burst, Allocator>::init()
+{
+    index_type i;
+
+    for (i = 0; i < kProducers; ++i)
+        this->producers[i].nextLane = i % kConsumers;
+
+    for (i = 0; i < kConsumers; ++i) {
+        this->consumers[i].laneBits = 0;
+        this->consumers[i].cursor = kProducers - 1;
+        this->consumers[i].burst = 0;
+    }
+
+    if (this->laneList == NULL)
+        this->laneList = new_array<lane_type, Allocator>(kLanes);
+
+    Jimi_WriteCompilerBarrier();
+}
+
+template <typename T, uint32_t Producers, uint32_t Consumers, uint32_t LaneCapacity, uint32_t Burst, typename Allocator>
+void MeshRingQueue<T, Producers, Consumers, LaneCapacity, Burst, Allocator>::dump_detail()
+{
+    index_type i;
+
+    printf("MeshRingQueue: (producers = %u, consumers = %u, lanes = %u, length = %u)\n",
+           kProducers, kConsumers, kLanes, sizes());
+    for (i = 0; i < kConsumers; ++i) {
+        printf("  consumer %2u: laneBits = 0x%08X\n", i, this->consumers[i].laneBits);
+    }
+}
+
+template <typename T, uint32_t Producers, uint32_t Consumers, uint32_t LaneCapacity, uint32_t Burst, typename Allocator>
+inline
+typename MeshRingQueue<T, Producers, Consumers, LaneCapacity, Burst, Allocator>::size_type
+MeshRingQueue<T, Producers, Consumers, LaneCapacity, Burst, Allocator>::sizes() const
+{
+    size_type total = 0;
+    index_type i;
+
+    for (i = 0; i < kLanes; ++i)
+        total += this->laneList[i].sizes();
+
+    return total;
+}
+
+template <typename T, uint32_t Producers, uint32_t Consumers, uint32_t LaneCapacity, uint32_t Burst, typename Allocator>
+inline
+int MeshRingQueue<T, Producers, Consumers, LaneCapacity, Burst, Allocator>::push_lane(T * item,
+                                                                          index_type producer,
+                                                                          index_type consumer)
+{
+    uint32_t bit;
+
+    if (lane(producer, consumer).push(item) != 0)
+        return -1;
+
+    // Only write the shared bitmap when the bit isn't set yet.
+    bit = 1U << producer;
+    if ((this->consumers[consumer].laneBits & bit) == 0)
+        jimi_fetch_and_or32(&this->consumers[consumer].laneBits, bit);
+
+    return 0;
+}
+
+template <typename T, uint32_t Producers, uint32_t Consumers, uint32_t LaneCapacity, uint32_t Burst, typename Allocator>
+inline
+int MeshRingQueue<T, Producers, Consumers, LaneCapacity, Burst, Allocator>::push(T * item, int producerId)
+{
+    assert(producerId >= 0 && producerId < (int)kProducers);
+
+    producer_state * state = &this->producers[producerId];
+    index_type consumer = state->nextLane;
+
+    if (push_lane(item, (index_type)producerId, consumer) != 0)
+        return -1;
+
+    state->nextLane = (consumer + 1 < kConsumers) ? (consumer + 1) : 0;
+    return 0;
+}
+
+template <typename T, uint32_t Producers, uint32_t Consumers, uint32_t LaneCapacity, uint32_t Burst, typename Allocator>
+inline
+int MeshRingQueue<T, Producers, Consumers, LaneCapacity, Burst, Allocator>::push(T * item, int producerId,
+                                                                     uint32_t key)
+{
+    assert(producerId >= 0 && producerId < (int)kProducers);
+    return push_lane(item, (index_type)producerId, (index_type)(key % kConsumers));
+}
+
+///
+/// Scan all the lanes of the consumer, set the bits of the lanes which
+/// have data and return them.
+///
+template <typename T, uint32_t Producers, uint32_t Consumers, uint32_t LaneCapacity, uint32_t Burst, typename Allocator>
+inline
+uint32_t MeshRingQueue<T, Producers, Consumers, LaneCapacity, Burst, Allocator>::rescan(index_type consumer)
+{
+    uint32_t bits = 0;
+    index_type p;
+
+    for (p = 0; p < kProducers; ++p) {
+        if (lane(p, consumer).sizes() != 0)
+            bits |= 1U << p;
+    }
+    if (bits != 0)
+        jimi_fetch_and_or32(&this->consumers[consumer].laneBits, bits);
+
+    return bits;
+}
+
+template <typename T, uint32_t Producers, uint32_t Consumers, uint32_t LaneCapacity, uint32_t Burst, typename Allocator>
+inline
+T * MeshRingQueue<T, Producers, Consumers, LaneCapacity, Burst, Allocator>::pop(int consumerId)
+{
+    assert(consumerId >= 0 && consumerId < (int)kConsumers);
+
+    consumer_state * state = &this->consumers[consumerId];
+    value_type item;
+    uint32_t bits, upper, bit;
+    index_type p, start;
+
+    // Keep on the current lane until its burst runs out.
+    if (state->burst > 0) {
+        if (lane(state->cursor, consumerId).pop(item) == 0) {
+            state->burst--;
+            return item;
+        }
+    }
+
+    bits = state->laneBits;
+    if (bits == 0) {
+        bits = rescan(consumerId);
+        if (bits == 0)
+            return (value_type)NULL;
+    }
+
+    start = (state->cursor + 1 < kProducers) ? (state->cursor + 1) : 0;
+    while (bits != 0) {
+        // The first lane with data at or after start, wrap around if none.
+        upper = (start < 32) ? (bits & (~0U << start)) : 0;
+        p = jimi_bsf32((upper != 0) ? upper : bits);
+        bit = 1U << p;
+
+        if (lane(p, consumerId).pop(item) == 0) {
+            state->cursor = p;
+            state->burst = kBurst - 1;
+            return item;
+        }
+
+        // The lane is empty, clear its bit, then check again in case a
+        // producer pushed in between and saw the bit still set.
+        jimi_fetch_and_and32(&state->laneBits, ~bit);
+        if (lane(p, consumerId).pop(item) == 0) {
+            jimi_fetch_and_or32(&state->laneBits, bit);
+            state->cursor = p;
+            state->burst = kBurst - 1;
+            return item;
+        }
+        bits &= ~bit;
+    }
+
+    return (value_type)NULL;
+}
+
+}  /* namespace jimi */
+
+#endif  /* _JIMI_UTIL_MESHRINGQUEUE_H_ */
@@ -7,6 +7,7 @@
 #endif
 
 #include "vs_stdint.h"
+#include "port.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -76,6 +77,18 @@ public:
     }
 #endif
 
+#if defined(JIMI_HAS_CXX11_MOVE) && (JIMI_HAS_CXX11_MOVE != 0)
+    // Move constructor
+    CValueEvent(CValueEvent && src) : value(std::move(src.value)) {
+        //
+    }
+
+    // Move assignment operator
+    void operator = (CValueEvent && rhs) {
+        this->value = std::move(rhs.value);
+    }
+#endif
+
     T getValue() const {
         return value;
     }
@@ -0,0 +1,241 @@
+
+#ifndef _JIMI_UTIL_MPMCRINGQUEUE_H_
+#define _JIMI_UTIL_MPMCRINGQUEUE_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "vs_stdint.h"
+#include "port.h"
+#include "sleep.h"
+#include "Allocator.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>     // For _ReadWriteBarrier(), InterlockedCompareExchange()
+#endif  // _MSC_VER
+#include <emmintrin.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "RingQueue.h"  // For RingQueueHead
+
+#include "dump_mem.h"
+
+namespace jimi {
+
+///////////////////////////////////////////////////////////////////
+// class MpmcRingQueue<T, Capacity, Allocator>
+///////////////////////////////////////////////////////////////////
+
+///
+/// A bounded multi-producer multi-consumer queue of T * (D. Vyukov's
+/// design), the same interface as RingQueueBase::push() / pop().
+///
+/// RingQueueBase::push() moves head before it writes the slot, so pop()
+/// can take the slot and read it before the producer has written it.
+/// Here each cell carries its own sequence stamp:
+///
+///   sequence == index:              the cell is empty, a producer can claim it;
+///   sequence == index + 1:          the item is written, a consumer can claim it;
+///   sequence == index + kCapacity:  the item is read, free for the next round.
+///
+/// A push() or pop() is one CAS on head (or tail) plus one read and one
+/// write of the cell's sequence, the producers and consumers never touch
+/// the same index.
+///
+template <typename T, uint32_t Capacity = 1024U,
+          typename Allocator = HeapAllocator>
+class MpmcRingQueue
+{
+public:
+    typedef uint32_t                    size_type;
+    typedef uint32_t                    index_type;
+    typedef T *                         value_type;
+    typedef T *                         pointer;
+    typedef const T *                   const_pointer;
+    typedef T &                         reference;
+    typedef const T &                   const_reference;
+    typedef Allocator                   allocator_type;
+
+    struct cell_type
+    {
+        volatile index_type sequence;
+        value_type          item;
+    };
+
+public:
+    static const bool       kIsAllocOnHeap  = true;
+    static const size_type  kCapacity       = (size_type)JIMI_MAX(JIMI_ROUND_TO_POW2(Capacity), 2);
+    static const index_type kMask           = (index_type)(kCapacity - 1);
+
+public:
+    MpmcRingQueue();
+    ~MpmcRingQueue();
+
+public:
+    void dump_info();
+    void dump_detail();
+
+    index_type mask() const      { return kMask;     };
+    size_type capacity() const   { return kCapacity; };
+    size_type length() const     { return sizes();   };
+    size_type sizes() const;
+
+    void init();
+
+    int push(T * item);
+    T * pop();
+
+protected:
+    RingQueueHead   info;
+    cell_type *     cells;
+};
+
+template <typename T, uint32_t Capacity, typename Allocator>
+MpmcRingQueue<T, Capacity, Allocator>::MpmcRingQueue()
+: cells(NULL)
+{
+    init();
+}
+
+template <typename T, uint32_t Capacity, typename Allocator>
+MpmcRingQueue<T, Capacity, Allocator>::~MpmcRingQueue()
+{
+    Jimi_WriteCompilerBarrier();
+
+    // If the queue is allocated on system heap, release them.
+    if (MpmcRingQueue<T, Capacity, Allocator>::kIsAllocOnHeap) {
+        if (this->cells != NULL) {
+            delete_array<cell_type, Allocator>(this->cells, kCapacity);
+            this->cells = NULL;
+        }
+    }
+}
+
+template <typename T, uint32_t Capacity, typename Allocator>
+inline
+void MpmcRingQueue<T, Capacity, Allocator>::init()
+{
+    index_type i;
+
+    memset((void *)&this->info, 0, sizeof(this->info));
+
+    if (this->cells == NULL)
+        this->cells = new_array<cell_type, Allocator>(kCapacity);
+
+    if (this->cells != NULL) {
+        for (i = 0; i < kCapacity; ++i) {
+            this->cells[i].sequence = i;
+            this->cells[i].item = NULL;
+        }
+    }
+
+    Jimi_WriteCompilerBarrier();
+}
+
+template <typename T, uint32_t Capacity, typename Allocator>
+void MpmcRingQueue<T, Capacity, Allocator>::dump_info()
+{
+    dump_memory(&this->info, sizeof(this->info), false, 16, 0, 0);
+}
+
+template <typename T, uint32_t Capacity, typename Allocator>
+void MpmcRingQueue<T, Capacity, Allocator>::dump_detail()
+{
+    printf("MpmcRingQueue: (head = %u, tail = %u)\n",
+           this->info.head, this->info.tail);
+}
+
+template <typename T, uint32_t Capacity, typename Allocator>
+inline
+typename MpmcRingQueue<T, Capacity, Allocator>::size_type
+MpmcRingQueue<T, Capacity, Allocator>::sizes() const
+{
+    index_type head, tail;
+
+    Jimi_ReadCompilerBarrier();
+
+    head = this->info.head;
+    tail = this->info.tail;
+
+    return (size_type)((head - tail) <= kMask) ? (head - tail) : (size_type)-1;
+}
+
+template <typename T, uint32_t Capacity, typename Allocator>
+inline
+int MpmcRingQueue<T, Capacity, Allocator>::push(T * item)
+{
+    cell_type * cell;
+    index_type head, sequence;
+    int32_t diff;
+
+    head = this->info.head;
+    while (true) {
+        cell = &this->cells[head & kMask];
+        sequence = cell->sequence;
+        Jimi_ReadCompilerBarrier();
+
+        diff = (int32_t)(sequence - head);
+        if (diff == 0) {
+            // The cell is empty, try to claim it.
+            if (jimi_bool_compare_and_swap32(&this->info.head, head, head + 1))
+                break;
+        }
+        else if (diff < 0) {
+            // The cell still holds the item of the last round, queue is full.
+            return -1;
+        }
+        // Another producer has claimed it, reload head.
+        head = this->info.head;
+    }
+
+    cell->item = item;
+    Jimi_WriteCompilerBarrier();
+    // Release the item to the consumers.
+    cell->sequence = head + 1;
+
+    return 0;
+}
+
+template <typename T, uint32_t Capacity, typename Allocator>
+inline
+T * MpmcRingQueue<T, Capacity, Allocator>::pop()
+{
+    cell_type * cell;
+    index_type tail, sequence;
+    value_type item;
+    int32_t diff;
+
+    tail = this->info.tail;
+    while (true) {
+        cell = &this->cells[tail & kMask];
+        sequence = cell->sequence;
+        Jimi_ReadCompilerBarrier();
+
+        diff = (int32_t)(sequence - (tail + 1));
+        if (diff == 0) {
+            // The item is written, try to claim it.
+            if (jimi_bool_compare_and_swap32(&this->info.tail, tail, tail + 1))
+                break;
+        }
+        else if (diff < 0) {
+            // The producer hasn't written the cell yet, queue is empty.
+            return (value_type)NULL;
+        }
+        // Another consumer has claimed it, reload tail.
+        tail = this->info.tail;
+    }
+
+    item = cell->item;
+    Jimi_CompilerBarrier();
+    // Free the cell for the producers of the next round.
+    cell->sequence = tail + kCapacity;
+
+    return item;
+}
+
+}  /* namespace jimi */
+
+#endif  /* _JIMI_UTIL_MPMCRINGQUEUE_H_ */
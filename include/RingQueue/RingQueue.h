@@ -25,6 +25,9 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "Futex.h"
+#include "Allocator.h"
+
 #include "dump_mem.h"
 
 namespace jimi {
@@ -164,10 +167,28 @@ public:
     int mutex_push(T * item);
     T * mutex_pop();
 
+    int futex_push(T * item);
+    T * futex_pop(int32_t timeOut = -1);
+
+protected:
+    // The TryPop of futex_pop(), see futex_wait_pop().
+    struct spin2_try_pop
+    {
+        RingQueueBase * queue;
+        value_type      item;
+
+        spin2_try_pop(RingQueueBase * _queue) : queue(_queue), item(NULL) {}
+
+        bool operator ()() {
+            return ((item = queue->spin2_pop()) != NULL);
+        }
+    };
+
 protected:
     core_type       core;
     spin_mutex_t    spin_mutex;
     pthread_mutex_t queue_mutex;
+    FutexEvent      notEmptyEvent;
 };
 
 template <typename T, uint32_t Capacity, typename CoreTy>
@@ -1206,6 +1227,37 @@ T * RingQueueBase<T, Capacity, CoreTy>::mutex_pop()
     return item;
 }
 
+///
+/// spin2_push() + wake up one consumer parked in futex_pop(),
+/// no syscall when no consumer is parked.
+///
+template <typename T, uint32_t Capacity, typename CoreTy>
+inline
+int RingQueueBase<T, Capacity, CoreTy>::futex_push(T * item)
+{
+    if (spin2_push(item) != 0)
+        return -1;
+
+    notEmptyEvent.notifyOne();
+    return 0;
+}
+
+///
+/// Blocking spin2_pop(), park on a futex when the queue is empty, at most
+/// timeOut millisecs (< 0 is infinite). Returns NULL if timeout.
+///
+template <typename T, uint32_t Capacity, typename CoreTy>
+inline
+T * RingQueueBase<T, Capacity, CoreTy>::futex_pop(int32_t timeOut /* = -1 */)
+{
+    static const uint32_t FUTEX_SPIN_COUNT = 256;
+    spin2_try_pop tryPop(this);
+
+    if (futex_wait_pop(notEmptyEvent, tryPop, FUTEX_SPIN_COUNT, timeOut) != 0)
+        return NULL;
+    return tryPop.item;
+}
+
 ///////////////////////////////////////////////////////////////////
 // class SmallRingQueue<T, Capacity>
 ///////////////////////////////////////////////////////////////////
@@ -1270,10 +1322,10 @@ void SmallRingQueue<T, Capacity>::dump_detail()
 }
 
 ///////////////////////////////////////////////////////////////////
-// class RingQueue<T, Capacity>
+// class RingQueue<T, Capacity, Allocator>
 ///////////////////////////////////////////////////////////////////
 
-template <typename T, uint32_t Capacity = 1024U>
+template <typename T, uint32_t Capacity = 1024U, typename Allocator = HeapAllocator>
 class RingQueue : public RingQueueBase<T, Capacity, RingQueueCore<T, Capacity> >
 {
 public:
@@ -1286,6 +1338,7 @@ public:
     typedef const T &                   const_reference;
 
     typedef RingQueueCore<T, Capacity>   core_type;
+    typedef Allocator                   allocator_type;
 
     static const size_type kCapacity = RingQueueBase<T, Capacity, RingQueueCore<T, Capacity> >::kCapacity;
 
@@ -1300,9 +1353,9 @@ protected:
     void init_queue(bool bFillQueue = true);
 };
 
-template <typename T, uint32_t Capacity>
-RingQueue<T, Capacity>::RingQueue(bool bFillQueue /* = true */,
-                                   bool bInitHead  /* = false */)
+template <typename T, uint32_t Capacity, typename Allocator>
+RingQueue<T, Capacity, Allocator>::RingQueue(bool bFillQueue /* = true */,
+                                              bool bInitHead  /* = false */)
 : RingQueueBase<T, Capacity, RingQueueCore<T, Capacity> >(bInitHead)
 {
     //printf("RingQueue::RingQueue();\n\n");
@@ -1310,25 +1363,25 @@ RingQueue<T, Capacity>::RingQueue(bool bFillQueue /* = true */,
     init_queue(bFillQueue);
 }
 
-template <typename T, uint32_t Capacity>
-RingQueue<T, Capacity>::~RingQueue()
+template <typename T, uint32_t Capacity, typename Allocator>
+RingQueue<T, Capacity, Allocator>::~RingQueue()
 {
     // If the queue is allocated on system heap, release them.
     if (RingQueueCore<T, Capacity>::kIsAllocOnHeap) {
         if (this->core.queue != NULL) {
-            delete [] this->core.queue;
+            delete_array<value_type, Allocator>(this->core.queue, kCapacity);
             this->core.queue = NULL;
         }
     }
 }
 
-template <typename T, uint32_t Capacity>
+template <typename T, uint32_t Capacity, typename Allocator>
 inline
-void RingQueue<T, Capacity>::init_queue(bool bFillQueue /* = true */)
+void RingQueue<T, Capacity, Allocator>::init_queue(bool bFillQueue /* = true */)
 {
     //printf("RingQueue::init_queue();\n\n");
 
-    value_type *newData = new T *[kCapacity];
+    value_type *newData = new_array<value_type, Allocator>(kCapacity);
     if (newData != NULL) {
         if (bFillQueue) {
             memset((void *)newData, 0, sizeof(value_type) * kCapacity);
@@ -1337,8 +1390,8 @@ void RingQueue<T, Capacity>::init_queue(bool bFillQueue /* = true */)
     }
 }
 
-template <typename T, uint32_t Capacity>
-void RingQueue<T, Capacity>::dump_detail()
+template <typename T, uint32_t Capacity, typename Allocator>
+void RingQueue<T, Capacity, Allocator>::dump_detail()
 {
     printf("RingQueue: (head = %u, tail = %u)\n",
            this->core.info.head, this->core.info.tail);
@@ -373,6 +373,17 @@ public:
 #endif
     }
 
+    /* Add addValue atomically, return the old value. */
+    inline T fetchAndAdd(T addValue) {
+        Jimi_WriteCompilerBarrier();
+#if defined(USE_SEQUENCE_SPIN_LOCK) && (USE_SEQUENCE_SPIN_LOCK != 0)
+        seq_spinlock_t spinlock;
+        return (T)__internal_fetch_and_add32((volatile uint32_t *)&(this->value), (uint32_t)addValue);
+#else
+        return (T)jimi_fetch_and_add32(&(this->value), addValue);
+#endif
+    }
+
 } CACHE_ALIGN_SUFFIX;
 
 #if defined(_MSC_VER) || defined(__GNUC__)
@@ -590,6 +601,34 @@ bool SequenceBase<uint64_t>::compareAndSwapBool(uint64_t oldValue, uint64_t newV
     return (jimi_val_compare_and_swap64u(&(this->value), oldValue, newValue) == oldValue);
 }
 
+/* For fetchAndAdd(), int64_t and uint64_t */
+
+template <>
+inline
+int64_t SequenceBase<int64_t>::fetchAndAdd(int64_t addValue)
+{
+    Jimi_WriteCompilerBarrier();
+#if defined(USE_SEQUENCE_SPIN_LOCK) && (USE_SEQUENCE_SPIN_LOCK != 0)
+    seq_spinlock_t spinlock;
+    return (int64_t)__internal_fetch_and_add64((volatile uint64_t *)&(this->value), (uint64_t)addValue);
+#else
+    return (int64_t)jimi_fetch_and_add64(&(this->value), addValue);
+#endif
+}
+
+template <>
+inline
+uint64_t SequenceBase<uint64_t>::fetchAndAdd(uint64_t addValue)
+{
+    Jimi_WriteCompilerBarrier();
+#if defined(USE_SEQUENCE_SPIN_LOCK) && (USE_SEQUENCE_SPIN_LOCK != 0)
+    seq_spinlock_t spinlock;
+    return __internal_fetch_and_add64(&(this->value), addValue);
+#else
+    return jimi_fetch_and_add64(&(this->value), addValue);
+#endif
+}
+
 typedef SequenceBase<uint64_t>  SequenceU64;
 typedef SequenceBase<uint32_t>  SequenceU32;
 typedef SequenceBase<uint16_t>  SequenceU16;
@@ -0,0 +1,97 @@
+
+#ifndef _JIMI_SEQUENCE_BARRIER_H_
+#define _JIMI_SEQUENCE_BARRIER_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "vs_stdint.h"
+#include "port.h"
+#include "sleep.h"
+
+#include <assert.h>
+
+#include "Sequence.h"
+#include "WaitStrategy.h"
+
+namespace jimi {
+
+///////////////////////////////////////////////////////////////////
+// class SequenceBarrier<SequenceType, MaxDependents>
+///////////////////////////////////////////////////////////////////
+
+///
+/// The upstream stages of a consumer stage in a multi-stage pipeline.
+///
+/// A consumer stage only sees the sequences that all its dependent
+/// (upstream) sequences have passed, so several stages can process
+/// the same slots of one DisruptorRingQueue in place, without copying.
+///
+/// The dependents are the gating sequences of the upstream consumers,
+/// see DisruptorRingQueue::getGatingSequences() and DisruptorRingQueue::process().
+/// A barrier without dependents only waits for the producers, it's used by
+/// the consumer groups (DisruptorRingQueue::consume()); the first stage of a
+/// pipeline uses drain() instead.
+///
+template <typename SequenceType = int64_t, uint32_t MaxDependents = 8>
+class SequenceBarrier
+{
+public:
+    typedef SequenceType                sequence_type;
+    typedef SequenceBase<SequenceType>  Sequence;
+    typedef uint32_t                    size_type;
+
+    static const size_type  kMaxDependents  = MaxDependents;
+    static const uint32_t   kSpinCount      = 64;
+
+public:
+    SequenceBarrier() : numDependents(0) {}
+    ~SequenceBarrier() {}
+
+public:
+    int addDependent(const Sequence * sequence) {
+        assert(sequence != NULL);
+        if (numDependents >= kMaxDependents)
+            return -1;
+        dependentSequences[numDependents++] = sequence;
+        return 0;
+    }
+
+    size_type dependents() const { return numDependents; }
+
+    sequence_type getMinimumSequence(sequence_type mininum) const {
+        sequence_type minSequence = mininum;
+        for (size_type i = 0; i < numDependents; ++i) {
+            sequence_type seq = dependentSequences[i]->get();
+            minSequence = (seq < minSequence) ? seq : minSequence;
+        }
+        return minSequence;
+    }
+
+    ///
+    /// Wait until all the dependents have passed sequence, the producers have
+    /// already published up to availableSequence. Returns the highest sequence
+    /// this stage can process, no more than availableSequence.
+    ///
+    /// Like the Disruptor, always spin on the dependents: the upstream
+    /// consumers are busy processing, they will pass the sequence soon.
+    /// An upstream consumer must setMaxValue() its sequence when it exits.
+    ///
+    sequence_type waitFor(sequence_type sequence, sequence_type availableSequence) const {
+        sequence_type minSequence;
+        uint32_t loop_cnt = 0;
+        while ((minSequence = getMinimumSequence(availableSequence)) < sequence) {
+            spin_yield_backoff(loop_cnt, kSpinCount);
+        }
+        return minSequence;
+    }
+
+private:
+    const Sequence *    dependentSequences[MaxDependents];
+    size_type           numDependents;
+};
+
+}  /* namespace jimi */
+
+#endif  /* _JIMI_SEQUENCE_BARRIER_H_ */
@@ -9,6 +9,7 @@
 #include "vs_stdint.h"
 #include "port.h"
 #include "sleep.h"
+#include "Allocator.h"
 
 #ifndef _MSC_VER
 #include <pthread.h>
@@ -29,7 +30,8 @@
 
 namespace jimi {
 
-template <typename T, uint32_t Capacity = 1024U>
+template <typename T, uint32_t Capacity = 1024U,
+          typename Allocator = HeapAllocator>
 class SerialRingQueue
 {
 public:
@@ -42,6 +44,7 @@ public:
     typedef const T *           const_pointer;
     typedef T &                 reference;
     typedef const T &           const_reference;
+    typedef Allocator           allocator_type;
 
 public:
     static const bool       kIsAllocOnHeap  = true;
@@ -63,14 +66,21 @@ public:
     int push(T const & entry);
     int pop(T & entry);
 
+#if defined(JIMI_HAS_CXX11_MOVE) && (JIMI_HAS_CXX11_MOVE != 0)
+    int push(T && entry);
+
+    template <typename ...Args>
+    int emplace(Args && ... args);
+#endif  /* JIMI_HAS_CXX11_MOVE */
+
 protected:
     sequence_type   headSequence;
     sequence_type   tailSequence;
     item_type *     entries;
 };
 
-template <typename T, uint32_t Capacity>
-SerialRingQueue<T, Capacity>::SerialRingQueue()
+template <typename T, uint32_t Capacity, typename Allocator>
+SerialRingQueue<T, Capacity, Allocator>::SerialRingQueue()
 : headSequence(0)
 , tailSequence(0)
 , entries(NULL)
@@ -78,35 +88,35 @@ SerialRingQueue<T, Capacity>::SerialRingQueue()
     init();
 }
 
-template <typename T, uint32_t Capacity>
-SerialRingQueue<T, Capacity>::~SerialRingQueue()
+template <typename T, uint32_t Capacity, typename Allocator>
+SerialRingQueue<T, Capacity, Allocator>::~SerialRingQueue()
 {
     Jimi_WriteCompilerBarrier();
 
     // If the queue is allocated on system heap, release them.
-    if (SerialRingQueue<T, Capacity>::kIsAllocOnHeap) {
+    if (SerialRingQueue<T, Capacity, Allocator>::kIsAllocOnHeap) {
         if (this->entries != NULL) {
-            delete [] this->entries;
+            delete_array<value_type, Allocator>(this->entries, kCapacity);
             this->entries = NULL;
         }
     }
 }
 
-template <typename T, uint32_t Capacity>
+template <typename T, uint32_t Capacity, typename Allocator>
 inline
-void SerialRingQueue<T, Capacity>::init()
+void SerialRingQueue<T, Capacity, Allocator>::init()
 {
-    value_type * newData = new T[kCapacity];
+    value_type * newData = new_array<value_type, Allocator>(kCapacity);
     if (newData != NULL) {
-        memset((void *)newData, 0, sizeof(value_type) * kCapacity);
+        clear_array(newData, kCapacity);
         this->entries = newData;
     }
 }
 
-template <typename T, uint32_t Capacity>
+template <typename T, uint32_t Capacity, typename Allocator>
 inline
-typename SerialRingQueue<T, Capacity>::size_type
-SerialRingQueue<T, Capacity>::sizes() const
+typename SerialRingQueue<T, Capacity, Allocator>::size_type
+SerialRingQueue<T, Capacity, Allocator>::sizes() const
 {
     sequence_type head, tail;
 
@@ -118,8 +128,8 @@ SerialRingQueue<T, Capacity>::sizes() const
     return (size_type)((head - tail) <= kMask) ? (head - tail) : (size_type)(-1);
 }
 
-template <typename T, uint32_t Capacity>
-int SerialRingQueue<T, Capacity>::push(T const & entry)
+template <typename T, uint32_t Capacity, typename Allocator>
+int SerialRingQueue<T, Capacity, Allocator>::push(T const & entry)
 {
     sequence_type head, tail, next;
 
@@ -145,8 +155,8 @@ int SerialRingQueue<T, Capacity>::push(T const & entry)
     return 0;
 }
 
-template <typename T, uint32_t Capacity>
-int SerialRingQueue<T, Capacity>::pop(T & entry)
+template <typename T, uint32_t Capacity, typename Allocator>
+int SerialRingQueue<T, Capacity, Allocator>::pop(T & entry)
 {
     sequence_type head, tail, next;
 
@@ -161,7 +171,8 @@ int SerialRingQueue<T, Capacity>::pop(T & entry)
 #if 0
     entry = this->entries[((index_type)tail) & kMask)];
 #else
-    entry = this->entries[tail & (sequence_type)kMask];
+    // The slot isn't read again before the next push() fills it.
+    entry = JIMI_MOVE(this->entries[tail & (sequence_type)kMask]);
 #endif
 
     next = tail + 1;
@@ -172,6 +183,62 @@ int SerialRingQueue<T, Capacity>::pop(T & entry)
     return 0;
 }
 
+#if defined(JIMI_HAS_CXX11_MOVE) && (JIMI_HAS_CXX11_MOVE != 0)
+
+template <typename T, uint32_t Capacity, typename Allocator>
+int SerialRingQueue<T, Capacity, Allocator>::push(T && entry)
+{
+    sequence_type head, tail, next;
+
+    Jimi_ReadCompilerBarrier();
+    head = this->headSequence;
+    tail = this->tailSequence;
+    if ((head - tail) > kMask) {
+        return -1;
+    }
+
+    Jimi_WriteCompilerBarrier();
+    this->entries[head & (sequence_type)kMask] = std::move(entry);
+
+    next = head + 1;
+
+    Jimi_WriteCompilerBarrier();
+    this->headSequence = next;
+
+    return 0;
+}
+
+///
+/// Build the event in the head slot from args, the head only moves after
+/// T's constructor has returned.
+///
+template <typename T, uint32_t Capacity, typename Allocator>
+template <typename ...Args>
+int SerialRingQueue<T, Capacity, Allocator>::emplace(Args && ... args)
+{
+    sequence_type head, tail, next;
+
+    Jimi_ReadCompilerBarrier();
+    head = this->headSequence;
+    tail = this->tailSequence;
+    if ((head - tail) > kMask) {
+        return -1;
+    }
+
+    Jimi_WriteCompilerBarrier();
+    T * slot = &this->entries[head & (sequence_type)kMask];
+    reconstruct_at(slot, std::forward<Args>(args)...);
+
+    next = head + 1;
+
+    Jimi_WriteCompilerBarrier();
+    this->headSequence = next;
+
+    return 0;
+}
+
+#endif  /* JIMI_HAS_CXX11_MOVE */
+
 }  /* namespace jimi */
 
 #endif  /* _JIMI_UTIL_SERIALRINGQUEUE_H_ */
@@ -0,0 +1,437 @@
+
+#ifndef _JIMI_UTIL_SHMRINGQUEUE_H_
+#define _JIMI_UTIL_SHMRINGQUEUE_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "vs_stdint.h"
+#include "port.h"
+#include "sleep.h"
+
+#if !defined(_MSC_VER) && !defined(__MINGW32__)
+#define JIMI_HAS_POSIX_SHM      1
+#include <unistd.h>
+#include <fcntl.h>          // For O_CREAT, O_EXCL, O_RDWR
+#include <sys/mman.h>       // For shm_open(), mmap()
+#include <sys/stat.h>       // For fstat()
+#if defined(__linux__)
+#include <sys/syscall.h>    // For SYS_memfd_create
+#endif
+#else
+#define JIMI_HAS_POSIX_SHM      0
+#endif  // !_MSC_VER
+
+#include <new>              // For placement new
+
+#include "Sequence.h"
+#include "Futex.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef JIMI_ALIGNED_TO
+#define JIMI_ALIGNED_TO(n, alignment)   \
+    (((n) + ((alignment) - 1)) & ~(size_t)((alignment) - 1))
+#endif
+
+namespace jimi {
+
+///////////////////////////////////////////////////////////////////
+// class ShmRingQueue<T, Capacity>
+///////////////////////////////////////////////////////////////////
+
+///
+/// A single producer, single consumer ring queue in a memory mapping
+/// shared by two processes (shm_open(), or memfd_create() + fork()).
+///
+/// The mapping holds the header, the sequences, the futex event and the
+/// entry array, there is no pointer in it, the entries are found by their
+/// offset from the header. One process create()s the mapping, the other
+/// attach()es to it, attach() fails (-1) until the creator has finished
+/// init, or if the version, the capacity or sizeof(T) don't match, so
+/// both sides must be built with the same ShmRingQueue<T, Capacity>.
+///
+/// Each process keeps its own ShmRingQueue object, the producer's cached
+/// tail and the consumer's cached head live there, like SingleRingQueue.
+/// T must be trivially copyable, with no pointer into a process.
+///
+/// futex_pop() blocks on a cross-process futex until futex_push().
+///
+template <typename T, uint32_t Capacity = 1024U>
+class ShmRingQueue
+{
+public:
+    typedef T                           item_type;
+    typedef item_type                   value_type;
+    typedef uint32_t                    size_type;
+    typedef uint32_t                    sequence_type;
+    typedef uint32_t                    index_type;
+    typedef SequenceBase<uint32_t>      Sequence;
+    typedef T *                         pointer;
+    typedef const T *                   const_pointer;
+    typedef T &                         reference;
+    typedef const T &                   const_reference;
+
+    ///
+    /// The head of the shared mapping, magic is written last by the creator.
+    ///
+    struct shared_layout
+    {
+        volatile uint32_t   magic;
+        uint32_t            version;
+        uint32_t            layoutSize;
+        uint32_t            capacity;
+        uint32_t            itemSize;
+        uint32_t            reserve;
+        uint64_t            entriesOffset;
+        uint64_t            mapSize;
+        char                padding[JIMI_CACHELINE_SIZE - 6 * sizeof(uint32_t) - 2 * sizeof(uint64_t)];
+
+        Sequence            headSequence;
+        Sequence            tailSequence;
+        FutexEvent          notEmptyEvent;
+
+        shared_layout() : magic(0), headSequence(0), tailSequence(0), notEmptyEvent(true) {}
+    };
+
+public:
+    static const uint32_t   kMagic          = 0x3151524AU;  // "JRQ1"
+    static const uint32_t   kVersion        = 1;
+    static const size_type  kCapacity       = (size_type)JIMI_MAX(JIMI_ROUND_TO_POW2(Capacity), 2);
+    static const index_type kMask           = (index_type)(kCapacity - 1);
+    static const uint32_t   kFutexSpinCount = 256;
+
+    static const size_t     kEntriesOffset  = JIMI_ALIGNED_TO(sizeof(shared_layout), JIMI_CACHELINE_SIZE);
+    static const size_t     kMapSize        = kEntriesOffset + sizeof(T) * kCapacity;
+
+public:
+    ShmRingQueue();
+    ~ShmRingQueue();
+
+public:
+    static int unlink(const char * name);
+
+    int create(const char * name);
+    int attach(const char * name);
+    int attach_fd(int fd);
+    void detach();
+
+    bool is_attached() const    { return (this->layout != NULL); };
+    int fd() const              { return this->shmFd; };
+
+    index_type mask() const      { return kMask;     };
+    size_type capacity() const   { return kCapacity; };
+    size_type length() const     { return sizes();   };
+    size_type sizes() const;
+
+    int push(T const & entry);
+    int pop(T & entry);
+
+    int futex_push(T const & entry);
+    int futex_pop(T & entry, int32_t timeOut = -1);
+
+protected:
+    int map(int fd, bool bCreate);
+
+protected:
+    shared_layout * layout;
+    item_type *     entries;
+    int             shmFd;
+
+    // Only touched by the producer.
+    sequence_type   cachedTail;
+    char            padding1[JIMI_CACHELINE_SIZE - 1 * sizeof(sequence_type)];
+
+    // Only touched by the consumer.
+    sequence_type   cachedHead;
+    char            padding2[JIMI_CACHELINE_SIZE - 1 * sizeof(sequence_type)];
+};
+
+template <typename T, uint32_t Capacity>
+ShmRingQueue<T, Capacity>::ShmRingQueue()
+: layout(NULL)
+, entries(NULL)
+, shmFd(-1)
+, cachedTail(0)
+, cachedHead(0)
+{
+}
+
+template <typename T, uint32_t Capacity>
+ShmRingQueue<T, Capacity>::~ShmRingQueue()
+{
+    detach();
+}
+
+///
+/// Remove the name of a shared mapping, the processes which have attached
+/// it keep using it until they detach().
+///
+template <typename T, uint32_t Capacity>
+int ShmRingQueue<T, Capacity>::unlink(const char * name)
+{
+#if defined(JIMI_HAS_POSIX_SHM) && (JIMI_HAS_POSIX_SHM != 0)
+    return shm_unlink(name);
+#else
+    return -1;
+#endif
+}
+
+///
+/// Create and init a new mapping, named name (a shm_open() name, e.g.
+/// "/feed_queue"). With name == NULL, create an anonymous memfd mapping
+/// (Linux only), it's inherited by fork(), or pass fd() to attach_fd().
+/// Returns -1 if the name already exists or on error.
+///
+template <typename T, uint32_t Capacity>
+int ShmRingQueue<T, Capacity>::create(const char * name)
+{
+#if defined(JIMI_HAS_POSIX_SHM) && (JIMI_HAS_POSIX_SHM != 0)
+    int fd;
+
+    if (this->layout != NULL)
+        return -1;
+
+    if (name != NULL) {
+        fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    }
+    else {
+#if defined(__linux__) && defined(SYS_memfd_create)
+        fd = (int)syscall(SYS_memfd_create, "ShmRingQueue", 0);
+#else
+        fd = -1;
+#endif
+    }
+    if (fd < 0)
+        return -1;
+
+    if (ftruncate(fd, (off_t)kMapSize) != 0 || map(fd, true) != 0) {
+        close(fd);
+        if (name != NULL)
+            shm_unlink(name);
+        return -1;
+    }
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+template <typename T, uint32_t Capacity>
+int ShmRingQueue<T, Capacity>::attach(const char * name)
+{
+#if defined(JIMI_HAS_POSIX_SHM) && (JIMI_HAS_POSIX_SHM != 0)
+    int fd;
+
+    if (this->layout != NULL || name == NULL)
+        return -1;
+
+    fd = shm_open(name, O_RDWR, 0600);
+    if (fd < 0)
+        return -1;
+
+    if (map(fd, false) != 0) {
+        close(fd);
+        return -1;
+    }
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+///
+/// Attach to the mapping of fd (e.g. the fd() of a memfd create(NULL),
+/// passed over a unix socket), the queue owns a dup() of fd.
+///
+template <typename T, uint32_t Capacity>
+int ShmRingQueue<T, Capacity>::attach_fd(int fd)
+{
+#if defined(JIMI_HAS_POSIX_SHM) && (JIMI_HAS_POSIX_SHM != 0)
+    int newFd;
+
+    if (this->layout != NULL)
+        return -1;
+
+    newFd = dup(fd);
+    if (newFd < 0)
+        return -1;
+
+    if (map(newFd, false) != 0) {
+        close(newFd);
+        return -1;
+    }
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+template <typename T, uint32_t Capacity>
+void ShmRingQueue<T, Capacity>::detach()
+{
+#if defined(JIMI_HAS_POSIX_SHM) && (JIMI_HAS_POSIX_SHM != 0)
+    if (this->layout != NULL) {
+        munmap((void *)this->layout, kMapSize);
+        this->layout = NULL;
+        this->entries = NULL;
+    }
+    if (this->shmFd >= 0) {
+        close(this->shmFd);
+        this->shmFd = -1;
+    }
+#endif
+}
+
+///
+/// Map fd, the creator inits the layout, the others check it.
+///
+template <typename T, uint32_t Capacity>
+int ShmRingQueue<T, Capacity>::map(int fd, bool bCreate)
+{
+#if defined(JIMI_HAS_POSIX_SHM) && (JIMI_HAS_POSIX_SHM != 0)
+    struct stat st;
+    void * base;
+    shared_layout * shared;
+
+    if (!bCreate) {
+        // The creator may not have called ftruncate() yet.
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < kMapSize)
+            return -1;
+    }
+
+    base = mmap(NULL, kMapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+        return -1;
+
+    shared = (shared_layout *)base;
+    if (bCreate) {
+        new ((void *)shared) shared_layout;
+        shared->version       = kVersion;
+        shared->layoutSize    = (uint32_t)sizeof(shared_layout);
+        shared->capacity      = kCapacity;
+        shared->itemSize      = (uint32_t)sizeof(T);
+        shared->reserve       = 0;
+        shared->entriesOffset = kEntriesOffset;
+        shared->mapSize       = kMapSize;
+
+        // The layout must be written before the others can see the magic.
+        Jimi_WriteMemoryBarrier();
+        shared->magic = kMagic;
+    }
+    else {
+        Jimi_ReadMemoryBarrier();
+        if (shared->magic != kMagic || shared->version != kVersion
+            || shared->layoutSize != (uint32_t)sizeof(shared_layout)
+            || shared->capacity != kCapacity || shared->itemSize != (uint32_t)sizeof(T)
+            || shared->entriesOffset != kEntriesOffset || shared->mapSize != kMapSize) {
+            munmap(base, kMapSize);
+            return -1;
+        }
+    }
+
+    this->layout = shared;
+    this->entries = (item_type *)((char *)base + shared->entriesOffset);
+    this->shmFd = fd;
+    this->cachedTail = shared->tailSequence.getOrder();
+    this->cachedHead = shared->headSequence.getOrder();
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+template <typename T, uint32_t Capacity>
+inline
+typename ShmRingQueue<T, Capacity>::size_type
+ShmRingQueue<T, Capacity>::sizes() const
+{
+    sequence_type head, tail;
+
+    Jimi_ReadCompilerBarrier();
+
+    head = this->layout->headSequence.get();
+    tail = this->layout->tailSequence.get();
+
+    return (size_type)((head - tail) <= kMask) ? (head - tail) : (size_type)-1;
+}
+
+template <typename T, uint32_t Capacity>
+inline
+int ShmRingQueue<T, Capacity>::push(T const & entry)
+{
+    sequence_type head;
+
+    head = this->layout->headSequence.get();
+    if ((head - this->cachedTail) > kMask) {
+        // Looks full, read the consumer's real position.
+        this->cachedTail = this->layout->tailSequence.getOrder();
+        if ((head - this->cachedTail) > kMask) {
+            return -1;
+        }
+    }
+
+    this->entries[head & (sequence_type)kMask] = entry;
+
+    Jimi_WriteCompilerBarrier();
+    this->layout->headSequence.setOrder(head + 1);
+    return 0;
+}
+
+template <typename T, uint32_t Capacity>
+inline
+int ShmRingQueue<T, Capacity>::pop(T & entry)
+{
+    sequence_type tail;
+
+    tail = this->layout->tailSequence.get();
+    if (tail == this->cachedHead) {
+        // Looks empty, read the producer's real position.
+        this->cachedHead = this->layout->headSequence.getOrder();
+        if (tail == this->cachedHead) {
+            return -1;
+        }
+    }
+
+    Jimi_ReadCompilerBarrier();
+    entry = this->entries[tail & (sequence_type)kMask];
+
+    Jimi_CompilerBarrier();
+    this->layout->tailSequence.setOrder(tail + 1);
+    return 0;
+}
+
+///
+/// Same as push(), but wake up the consumer process if it's parked in
+/// futex_pop().
+///
+template <typename T, uint32_t Capacity>
+inline
+int ShmRingQueue<T, Capacity>::futex_push(T const & entry)
+{
+    if (push(entry) != 0)
+        return -1;
+
+    this->layout->notEmptyEvent.notifyOne();
+    return 0;
+}
+
+///
+/// Pop an entry, spin a little, then park on the shared futex until the
+/// producer process calls futex_push(), at most timeOut millisecs (< 0 is
+/// infinite). Returns 0 if an entry is popped, -1 if timeout, so a consumer
+/// can notice that the producer process has gone.
+///
+template <typename T, uint32_t Capacity>
+inline
+int ShmRingQueue<T, Capacity>::futex_pop(T & entry, int32_t timeOut /* = -1 */)
+{
+    futex_try_pop<ShmRingQueue, T> tryPop(this, &entry);
+    return futex_wait_pop(this->layout->notEmptyEvent, tryPop, kFutexSpinCount, timeOut);
+}
+
+}  /* namespace jimi */
+
+#endif  /* _JIMI_UTIL_SHMRINGQUEUE_H_ */
@@ -23,6 +23,8 @@
 #include <emmintrin.h>
 
 #include "Sequence.h"
+#include "Futex.h"
+#include "Allocator.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -31,7 +33,21 @@
 
 namespace jimi {
 
-template <typename T, typename SequenceType = uint32_t, uint32_t Capacity = 1024U>
+///
+/// A single producer, single consumer ring queue.
+///
+/// The producer keeps the last tail it has read in cachedTail, and the
+/// consumer the last head in cachedHead, they only read the other side's
+/// sequence when the cached value says the queue is full (or empty), so in
+/// the common case a push() or pop() doesn't touch the other side's cache line.
+///
+/// With PublishBatch > 1, the producer publishes headSequence once every
+/// PublishBatch pushes, the pushes in between are invisible to the consumer
+/// until the next publication or flush(). push() still publishes everything
+/// before it reports the queue is full, and futex_push() always publishes.
+///
+template <typename T, typename SequenceType = uint32_t, uint32_t Capacity = 1024U,
+          uint32_t PublishBatch = 1U, typename Allocator = HeapAllocator>
 class SingleRingQueue
 {
 public:
@@ -41,6 +57,7 @@ public:
     typedef SequenceType                sequence_type;
     typedef uint32_t                    index_type;
     typedef SequenceBase<SequenceType>  Sequence;
+    typedef Allocator                   allocator_type;
     typedef T *                         pointer;
     typedef const T *                   const_pointer;
     typedef T &                         reference;
@@ -50,6 +67,8 @@ public:
     static const bool       kIsAllocOnHeap  = true;
     static const size_type  kCapacity       = (size_type)JIMI_MAX(JIMI_ROUND_TO_POW2(Capacity), 2);
     static const index_type kMask           = (index_type)(kCapacity - 1);
+    static const uint32_t   kFutexSpinCount = 256;
+    static const size_type  kPublishBatch   = (PublishBatch > 1) ? PublishBatch : 1;
 
 public:
     SingleRingQueue();
@@ -66,50 +85,86 @@ public:
     int push(T const & entry);
     int pop(T & entry);
 
+#if defined(JIMI_HAS_CXX11_MOVE) && (JIMI_HAS_CXX11_MOVE != 0)
+    int push(T && entry);
+
+    template <typename ...Args>
+    int emplace(Args && ... args);
+#endif  /* JIMI_HAS_CXX11_MOVE */
+
+    T * claim(sequence_type & sequence);
+    void commit(sequence_type sequence);
+    const T * peek();
+    void release();
+
+    void flush();
+
+    int futex_push(T const & entry);
+    int futex_pop(T & entry, int32_t timeOut = -1);
+
+protected:
+    void publish(sequence_type next);
+
 protected:
     Sequence        headSequence;
     Sequence        tailSequence;
+
+    // Only touched by the producer.
+    sequence_type   nextHead;
+    sequence_type   publishedHead;
+    sequence_type   cachedTail;
+    char            padding1[JIMI_CACHELINE_SIZE - 3 * sizeof(sequence_type)];
+
+    // Only touched by the consumer.
+    sequence_type   cachedHead;
+    char            padding2[JIMI_CACHELINE_SIZE - 1 * sizeof(sequence_type)];
+
     item_type *     entries;
+    FutexEvent      notEmptyEvent;
 };
 
-template <typename T, typename SequenceType, uint32_t Capacity>
-SingleRingQueue<T, SequenceType, Capacity>::SingleRingQueue()
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t PublishBatch, typename Allocator>
+SingleRingQueue<T, SequenceType, Capacity, PublishBatch, Allocator>::SingleRingQueue()
 : headSequence(0)
 , tailSequence(0)
+, nextHead(0)
+, publishedHead(0)
+, cachedTail(0)
+, cachedHead(0)
 , entries(NULL)
 {
     init();
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity>
-SingleRingQueue<T, SequenceType, Capacity>::~SingleRingQueue()
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t PublishBatch, typename Allocator>
+SingleRingQueue<T, SequenceType, Capacity, PublishBatch, Allocator>::~SingleRingQueue()
 {
     Jimi_WriteCompilerBarrier();
 
     // If the queue is allocated on system heap, release them.
-    if (SingleRingQueue<T, SequenceType, Capacity>::kIsAllocOnHeap) {
+    if (SingleRingQueue<T, SequenceType, Capacity, PublishBatch, Allocator>::kIsAllocOnHeap) {
         if (this->entries != NULL) {
-            delete [] this->entries;
+            delete_array<value_type, Allocator>(this->entries, kCapacity);
             this->entries = NULL;
         }
     }
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t PublishBatch, typename Allocator>
 inline
-void SingleRingQueue<T, SequenceType, Capacity>::init()
+void SingleRingQueue<T, SequenceType, Capacity, PublishBatch, Allocator>::init()
 {
-    value_type * newData = new T[kCapacity];
+    value_type * newData = new_array<value_type, Allocator>(kCapacity);
     if (newData != NULL) {
-        memset((void *)newData, 0, sizeof(value_type) * kCapacity);
+        clear_array(newData, kCapacity);
         this->entries = newData;
     }
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t PublishBatch, typename Allocator>
 inline
-typename SingleRingQueue<T, SequenceType, Capacity>::size_type
-SingleRingQueue<T, SequenceType, Capacity>::sizes() const
+typename SingleRingQueue<T, SequenceType, Capacity, PublishBatch, Allocator>::size_type
+SingleRingQueue<T, SequenceType, Capacity, PublishBatch, Allocator>::sizes() const
 {
     sequence_type head, tail;
 
@@ -121,16 +176,21 @@ SingleRingQueue<T, SequenceType, Capacity>::sizes() const
     return (size_type)((head - tail) <= kMask) ? (head - tail) : (size_type)(-1);
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t PublishBatch, typename Allocator>
 inline
-int SingleRingQueue<T, SequenceType, Capacity>::push(T const & entry)
+int SingleRingQueue<T, SequenceType, Capacity, PublishBatch, Allocator>::push(T const & entry)
 {
-    sequence_type head, tail, next;
-
-    head = this->headSequence.getOrder();
-    tail = this->tailSequence.getOrder();
-    if ((head - tail) > kMask) {
-        return -1;
+    sequence_type head, next;
+
+    head = this->nextHead;
+    if ((head - this->cachedTail) > kMask) {
+        // Looks full, read the consumer's real position.
+        this->cachedTail = this->tailSequence.getOrder();
+        if ((head - this->cachedTail) > kMask) {
+            // Let the consumer see the whole batch, or it never drains.
+            flush();
+            return -1;
+        }
     }
 
     Jimi_CompilerBarrier();
@@ -141,31 +201,36 @@ int SingleRingQueue<T, SequenceType, Capacity>::push(T const & entry)
 #endif
 
     next = head + 1;
+    this->nextHead = next;
 
-    //Jimi_WriteMemoryBarrier();
-    Jimi_WriteCompilerBarrier();
-    this->headSequence.setOrder(next);
+    if (kPublishBatch <= 1 || (next - this->publishedHead) >= kPublishBatch)
+        publish(next);
 
     return 0;
 }
 
-template <typename T, typename SequenceType, uint32_t Capacity>
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t PublishBatch, typename Allocator>
 inline
-int SingleRingQueue<T, SequenceType, Capacity>::pop(T & entry)
+int SingleRingQueue<T, SequenceType, Capacity, PublishBatch, Allocator>::pop(T & entry)
 {
     sequence_type head, tail, next;
 
-    head = this->headSequence.getOrder();
-    tail = this->tailSequence.getOrder();
-    if ((tail == head) || (tail > head && (head - tail) > kMask)) {
-        return -1;
+    tail = this->tailSequence.get();
+    head = this->cachedHead;
+    if (tail == head) {
+        // Looks empty, read the producer's real position.
+        head = this->cachedHead = this->headSequence.getOrder();
+        if ((tail == head) || (tail > head && (head - tail) > kMask)) {
+            return -1;
+        }
     }
 
     Jimi_ReadCompilerBarrier();
 #if 0
     entry = this->entries[((index_type)tail) & kMask];
 #else
-    entry = this->entries[tail & (sequence_type)kMask];
+    // The slot is dead after pop(), move the event out of it.
+    entry = JIMI_MOVE(this->entries[tail & (sequence_type)kMask]);
 #endif
 
     next = tail + 1;
@@ -177,6 +242,160 @@ int SingleRingQueue<T, SequenceType, Capacity>::pop(T & entry)
     return 0;
 }
 
+#if defined(JIMI_HAS_CXX11_MOVE) && (JIMI_HAS_CXX11_MOVE != 0)
+
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t PublishBatch, typename Allocator>
+inline
+int SingleRingQueue<T, SequenceType, Capacity, PublishBatch, Allocator>::push(T && entry)
+{
+    sequence_type sequence;
+    T * slot = claim(sequence);
+    if (slot == NULL)
+        return -1;
+
+    *slot = std::move(entry);
+    commit(sequence);
+    return 0;
+}
+
+///
+/// Build the event in the claimed slot from args. If T's constructor throws,
+/// nothing is committed, the next claim() gets the same slot again.
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t PublishBatch, typename Allocator>
+template <typename ...Args>
+inline
+int SingleRingQueue<T, SequenceType, Capacity, PublishBatch, Allocator>::emplace(Args && ... args)
+{
+    sequence_type sequence;
+    T * slot = claim(sequence);
+    if (slot == NULL)
+        return -1;
+
+    reconstruct_at(slot, std::forward<Args>(args)...);
+    commit(sequence);
+    return 0;
+}
+
+#endif  /* JIMI_HAS_CXX11_MOVE */
+
+///
+/// Zero-copy push: build the event in place in the returned slot,
+/// then commit() the sequence. Returns NULL if the queue is full.
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t PublishBatch, typename Allocator>
+inline
+T * SingleRingQueue<T, SequenceType, Capacity, PublishBatch, Allocator>::claim(sequence_type & sequence)
+{
+    sequence_type head;
+
+    head = this->nextHead;
+    if ((head - this->cachedTail) > kMask) {
+        this->cachedTail = this->tailSequence.getOrder();
+        if ((head - this->cachedTail) > kMask) {
+            flush();
+            return NULL;
+        }
+    }
+
+    sequence = head;
+    return &this->entries[head & (sequence_type)kMask];
+}
+
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t PublishBatch, typename Allocator>
+inline
+void SingleRingQueue<T, SequenceType, Capacity, PublishBatch, Allocator>::commit(sequence_type sequence)
+{
+    sequence_type next = sequence + 1;
+    this->nextHead = next;
+
+    if (kPublishBatch <= 1 || (next - this->publishedHead) >= kPublishBatch)
+        publish(next);
+}
+
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t PublishBatch, typename Allocator>
+inline
+void SingleRingQueue<T, SequenceType, Capacity, PublishBatch, Allocator>::publish(sequence_type next)
+{
+    Jimi_WriteCompilerBarrier();
+    this->headSequence.setOrder(next);
+    this->publishedHead = next;
+}
+
+///
+/// Publish the pushes the consumer can't see yet, call it after the last
+/// push() of a burst when PublishBatch > 1. Producer side only.
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t PublishBatch, typename Allocator>
+inline
+void SingleRingQueue<T, SequenceType, Capacity, PublishBatch, Allocator>::flush()
+{
+    if (this->nextHead != this->publishedHead)
+        publish(this->nextHead);
+}
+
+///
+/// Zero-copy pop: read the event in place, then release() it.
+/// Returns NULL if the queue is empty.
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t PublishBatch, typename Allocator>
+inline
+const T * SingleRingQueue<T, SequenceType, Capacity, PublishBatch, Allocator>::peek()
+{
+    sequence_type head, tail;
+
+    tail = this->tailSequence.get();
+    head = this->cachedHead;
+    if (tail == head) {
+        head = this->cachedHead = this->headSequence.getOrder();
+        if ((tail == head) || (tail > head && (head - tail) > kMask)) {
+            return NULL;
+        }
+    }
+
+    Jimi_ReadCompilerBarrier();
+    return &this->entries[tail & (sequence_type)kMask];
+}
+
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t PublishBatch, typename Allocator>
+inline
+void SingleRingQueue<T, SequenceType, Capacity, PublishBatch, Allocator>::release()
+{
+    sequence_type tail = this->tailSequence.getOrder();
+
+    Jimi_CompilerBarrier();
+    this->tailSequence.setOrder(tail + 1);
+}
+
+///
+/// Same as push(), but wake up the consumer if it's parked in futex_pop().
+/// Only costs a full memory barrier when no consumer is parked.
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t PublishBatch, typename Allocator>
+inline
+int SingleRingQueue<T, SequenceType, Capacity, PublishBatch, Allocator>::futex_push(T const & entry)
+{
+    if (push(entry) != 0)
+        return -1;
+
+    flush();
+    this->notEmptyEvent.notifyOne();
+    return 0;
+}
+
+///
+/// Blocking pop(), spin kFutexSpinCount times, then park on a futex until
+/// a producer calls futex_push(), at most timeOut millisecs (< 0 is infinite).
+/// Returns 0 if an entry is popped, -1 if timeout.
+///
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t PublishBatch, typename Allocator>
+inline
+int SingleRingQueue<T, SequenceType, Capacity, PublishBatch, Allocator>::futex_pop(T & entry, int32_t timeOut /* = -1 */)
+{
+    futex_try_pop<SingleRingQueue, T> tryPop(this, &entry);
+    return futex_wait_pop(this->notEmptyEvent, tryPop, kFutexSpinCount, timeOut);
+}
+
 }  /* namespace jimi */
 
 #endif  /* _JIMI_UTIL_SINGLERINGQUEUE_H_ */
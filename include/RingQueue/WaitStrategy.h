@@ -0,0 +1,467 @@
+
+#ifndef _JIMI_WAIT_STRATEGY_H_
+#define _JIMI_WAIT_STRATEGY_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "vs_stdint.h"
+#include "port.h"
+#include "sleep.h"
+
+#if defined(_MSC_VER) || defined(__MINGW32__)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include "msvc/targetver.h"
+#include <windows.h>    // For CRITICAL_SECTION, CONDITION_VARIABLE
+#else
+#include <pthread.h>
+#include <time.h>       // For clock_gettime()
+#include <errno.h>
+#endif  // _MSC_VER || __MINGW32__
+
+#include "Sequence.h"
+#include "Futex.h"
+#include "sys_timer.h"
+
+///
+/// The wait strategies used by the consumers of DisruptorRingQueue,
+/// DisruptorRingQueueEx and DisruptorRingQueueOld, pass one of them
+/// as the WaitStrategy template parameter of the queue.
+///
+/// A wait strategy must provide:
+///
+///   SequenceType waitFor(SequenceType sequence, const SequenceBase<SequenceType> & cursor,
+///                        const volatile uint32_t & alerted);
+///
+///       Wait until cursor >= sequence, return the last cursor value read.
+///       It may return a value less than sequence (timeout, or alerted != 0
+///       after shutdown()), the caller treats it as "queue is empty".
+///
+///   void signalAllWhenBlocking();
+///
+///       Called by the producers after publish() and by shutdown(),
+///       wake up the blocked consumers.
+///
+
+namespace jimi {
+
+///////////////////////////////////////////////////////////////////
+// spin_yield_backoff()
+///////////////////////////////////////////////////////////////////
+
+///
+/// One round of the spin -> yield backoff: jimi_mm_pause() for the first
+/// spinCount rounds, then give up the time slice (jimi_sleep(0) if no other
+/// thread is ready to run). Start with loop_cnt = 0. Also used outside the
+/// wait strategies, by FetchAddClaimStrategy, SequenceBarrier::waitFor()
+/// and JournalRingQueue::wait_record().
+///
+inline
+void spin_yield_backoff(uint32_t & loop_cnt, uint32_t spinCount)
+{
+    if (loop_cnt >= spinCount) {
+        if (!jimi_yield())
+            jimi_sleep(0);
+    }
+    else {
+        jimi_mm_pause();
+        loop_cnt++;
+    }
+}
+
+///////////////////////////////////////////////////////////////////
+// class BusySpinWaitStrategy
+///////////////////////////////////////////////////////////////////
+
+///
+/// Busy spin on the cursor, the lowest latency, but burns a whole core.
+///
+class BusySpinWaitStrategy
+{
+public:
+    template <typename SequenceType>
+    SequenceType waitFor(SequenceType sequence, const SequenceBase<SequenceType> & cursor,
+                         const volatile uint32_t & alerted) {
+        SequenceType availableSequence;
+        while ((availableSequence = cursor.get()) < sequence) {
+            if (alerted != 0)
+                break;
+            jimi_mm_pause();
+        }
+        return availableSequence;
+    }
+
+    void signalAllWhenBlocking() {
+        // Do nothing!
+    }
+};
+
+///////////////////////////////////////////////////////////////////
+// class YieldingWaitStrategy<SpinTries>
+///////////////////////////////////////////////////////////////////
+
+///
+/// Spin SpinTries times, then jimi_yield() to the other threads.
+///
+template <uint32_t SpinTries = 100>
+class YieldingWaitStrategy
+{
+public:
+    template <typename SequenceType>
+    SequenceType waitFor(SequenceType sequence, const SequenceBase<SequenceType> & cursor,
+                         const volatile uint32_t & alerted) {
+        SequenceType availableSequence;
+        uint32_t loop_cnt = 0;
+        while ((availableSequence = cursor.get()) < sequence) {
+            if (alerted != 0)
+                break;
+            spin_yield_backoff(loop_cnt, SpinTries);
+        }
+        return availableSequence;
+    }
+
+    void signalAllWhenBlocking() {
+        // Do nothing!
+    }
+};
+
+///////////////////////////////////////////////////////////////////
+// class SleepingWaitStrategy<Retries, SleepNanos>
+///////////////////////////////////////////////////////////////////
+
+///
+/// Spin, then yield, then sleep SleepNanos nanoseconds per round.
+/// Trade a little latency for an almost idle CPU on a quiet queue.
+///
+template <uint32_t Retries = 200, uint32_t SleepNanos = 100>
+class SleepingWaitStrategy
+{
+public:
+    template <typename SequenceType>
+    SequenceType waitFor(SequenceType sequence, const SequenceBase<SequenceType> & cursor,
+                         const volatile uint32_t & alerted) {
+        SequenceType availableSequence;
+        uint32_t counter = Retries;
+        while ((availableSequence = cursor.get()) < sequence) {
+            if (alerted != 0)
+                break;
+            if (counter > (Retries / 2)) {
+                jimi_mm_pause();
+                --counter;
+            }
+            else if (counter > 0) {
+                jimi_yield();
+                --counter;
+            }
+            else {
+                jimi_nsleep(SleepNanos);
+            }
+        }
+        return availableSequence;
+    }
+
+    void signalAllWhenBlocking() {
+        // Do nothing!
+    }
+};
+
+///////////////////////////////////////////////////////////////////
+// class PhasedBackoffWaitStrategy<YieldThreshold>
+///////////////////////////////////////////////////////////////////
+
+///
+/// The original spin -> jimi_yield() -> jimi_sleep(0) -> jimi_sleep(1) ladder
+/// of DisruptorRingQueue::waitFor(), it's the default wait strategy.
+///
+template <uint32_t YieldThreshold = 8>
+class PhasedBackoffWaitStrategy
+{
+public:
+    template <typename SequenceType>
+    SequenceType waitFor(SequenceType sequence, const SequenceBase<SequenceType> & cursor,
+                         const volatile uint32_t & alerted) {
+        SequenceType availableSequence;
+        int32_t  pause_cnt;
+        uint32_t loop_cnt, yeild_cnt, spin_cnt;
+
+        loop_cnt = 0;
+        spin_cnt = 1;
+        while ((availableSequence = cursor.get()) < sequence) {
+            if (alerted != 0)
+                break;
+            // Need yiled() or sleep() a while.
+            if (loop_cnt >= YieldThreshold) {
+                yeild_cnt = loop_cnt - YieldThreshold;
+                if ((yeild_cnt & 63) == 63) {
+                    jimi_sleep(1);
+                }
+                else if ((yeild_cnt & 3) == 3) {
+                    jimi_sleep(0);
+                }
+                else {
+                    if (!jimi_yield()) {
+                        jimi_sleep(0);
+                    }
+                }
+            }
+            else {
+                for (pause_cnt = spin_cnt; pause_cnt > 0; --pause_cnt) {
+                    jimi_mm_pause();
+                }
+                spin_cnt = spin_cnt + 1;
+            }
+            loop_cnt++;
+        }
+        return availableSequence;
+    }
+
+    void signalAllWhenBlocking() {
+        // Do nothing!
+    }
+};
+
+#if defined(USE_SEQUENCE_SPIN_LOCK) && (USE_SEQUENCE_SPIN_LOCK != 0)
+typedef PhasedBackoffWaitStrategy<20>   DefaultWaitStrategy;
+#else
+typedef PhasedBackoffWaitStrategy<8>    DefaultWaitStrategy;
+#endif
+
+///////////////////////////////////////////////////////////////////
+// class WaitConditionVariable
+///////////////////////////////////////////////////////////////////
+
+///
+/// A mutex + condition variable pair for the blocking wait strategies.
+///
+class WaitConditionVariable
+{
+public:
+    WaitConditionVariable() {
+#if defined(_MSC_VER) || defined(__MINGW32__)
+        ::InitializeCriticalSection(&lock_);
+        ::InitializeConditionVariable(&cond_);
+#else
+        pthread_mutex_init(&lock_, NULL);
+        pthread_cond_init(&cond_, NULL);
+#endif
+    }
+
+    ~WaitConditionVariable() {
+#if defined(_MSC_VER) || defined(__MINGW32__)
+        ::DeleteCriticalSection(&lock_);
+#else
+        pthread_cond_destroy(&cond_);
+        pthread_mutex_destroy(&lock_);
+#endif
+    }
+
+    void lock() {
+#if defined(_MSC_VER) || defined(__MINGW32__)
+        ::EnterCriticalSection(&lock_);
+#else
+        pthread_mutex_lock(&lock_);
+#endif
+    }
+
+    void unlock() {
+#if defined(_MSC_VER) || defined(__MINGW32__)
+        ::LeaveCriticalSection(&lock_);
+#else
+        pthread_mutex_unlock(&lock_);
+#endif
+    }
+
+    void wait() {
+#if defined(_MSC_VER) || defined(__MINGW32__)
+        ::SleepConditionVariableCS(&cond_, &lock_, INFINITE);
+#else
+        pthread_cond_wait(&cond_, &lock_);
+#endif
+    }
+
+    /* Return false if timeout. */
+    bool timed_wait(uint32_t millisec) {
+#if defined(_MSC_VER) || defined(__MINGW32__)
+        return (::SleepConditionVariableCS(&cond_, &lock_, millisec) != 0);
+#else
+        struct timespec abstime;
+        clock_gettime(CLOCK_REALTIME, &abstime);
+        abstime.tv_sec  += millisec / 1000;
+        abstime.tv_nsec += (long)(millisec % 1000) * 1000000L;
+        if (abstime.tv_nsec >= 1000000000L) {
+            abstime.tv_sec  += 1;
+            abstime.tv_nsec -= 1000000000L;
+        }
+        return (pthread_cond_timedwait(&cond_, &lock_, &abstime) != ETIMEDOUT);
+#endif
+    }
+
+    void notify_all() {
+#if defined(_MSC_VER) || defined(__MINGW32__)
+        ::WakeAllConditionVariable(&cond_);
+#else
+        pthread_cond_broadcast(&cond_);
+#endif
+    }
+
+private:
+#if defined(_MSC_VER) || defined(__MINGW32__)
+    CRITICAL_SECTION    lock_;
+    CONDITION_VARIABLE  cond_;
+#else
+    pthread_mutex_t     lock_;
+    pthread_cond_t      cond_;
+#endif
+};
+
+///////////////////////////////////////////////////////////////////
+// class BlockingWaitStrategy
+///////////////////////////////////////////////////////////////////
+
+///
+/// Block the consumers on a condition variable, the producers wake them
+/// up after each publish(). Lowest CPU usage, highest wake-up latency.
+///
+class BlockingWaitStrategy
+{
+public:
+    template <typename SequenceType>
+    SequenceType waitFor(SequenceType sequence, const SequenceBase<SequenceType> & cursor,
+                         const volatile uint32_t & alerted) {
+        SequenceType availableSequence;
+        if ((availableSequence = cursor.get()) < sequence) {
+            cond.lock();
+            while ((availableSequence = cursor.get()) < sequence) {
+                if (alerted != 0)
+                    break;
+                cond.wait();
+            }
+            cond.unlock();
+        }
+        return availableSequence;
+    }
+
+    void signalAllWhenBlocking() {
+        cond.lock();
+        cond.notify_all();
+        cond.unlock();
+    }
+
+private:
+    WaitConditionVariable cond;
+};
+
+///////////////////////////////////////////////////////////////////
+// class TimeoutBlockingWaitStrategy<TimeoutMillisec>
+///////////////////////////////////////////////////////////////////
+
+///
+/// Same as BlockingWaitStrategy, but gives up after TimeoutMillisec,
+/// then waitFor() returns a sequence less than the requested one.
+///
+template <uint32_t TimeoutMillisec = 1>
+class TimeoutBlockingWaitStrategy
+{
+public:
+    template <typename SequenceType>
+    SequenceType waitFor(SequenceType sequence, const SequenceBase<SequenceType> & cursor,
+                         const volatile uint32_t & alerted) {
+        SequenceType availableSequence;
+        if ((availableSequence = cursor.get()) < sequence) {
+            cond.lock();
+            while ((availableSequence = cursor.get()) < sequence) {
+                if (alerted != 0)
+                    break;
+                if (!cond.timed_wait(TimeoutMillisec)) {
+                    // Timeout
+                    availableSequence = cursor.get();
+                    break;
+                }
+            }
+            cond.unlock();
+        }
+        return availableSequence;
+    }
+
+    void signalAllWhenBlocking() {
+        cond.lock();
+        cond.notify_all();
+        cond.unlock();
+    }
+
+private:
+    WaitConditionVariable cond;
+};
+
+///////////////////////////////////////////////////////////////////
+// class FutexWaitStrategy<SpinTries>
+///////////////////////////////////////////////////////////////////
+
+///
+/// Spin SpinTries times on the cursor, then park on a futex. The producers
+/// only issue FUTEX_WAKE when a consumer is parked (see FutexEvent).
+///
+template <uint32_t SpinTries = 256>
+class FutexWaitStrategy
+{
+public:
+    template <typename SequenceType>
+    SequenceType waitFor(SequenceType sequence, const SequenceBase<SequenceType> & cursor,
+                         const volatile uint32_t & alerted) {
+        SequenceType availableSequence;
+        uint32_t counter = SpinTries;
+        while ((availableSequence = cursor.get()) < sequence) {
+            if (alerted != 0)
+                break;
+            if (counter > 0) {
+                jimi_mm_pause();
+                --counter;
+            }
+            else {
+                uint32_t key = event.prepareWait();
+                if ((availableSequence = cursor.get()) >= sequence || alerted != 0) {
+                    event.cancelWait();
+                    break;
+                }
+                event.wait(key);
+            }
+        }
+        return availableSequence;
+    }
+
+    void signalAllWhenBlocking() {
+        event.notifyAll();
+    }
+
+private:
+    FutexEvent event;
+};
+
+///////////////////////////////////////////////////////////////////
+// wait_until_drained<QueueTy>()
+///////////////////////////////////////////////////////////////////
+
+///
+/// The drain wait of the shutdown() of the Disruptor queues: sleep 1 ms at a
+/// time until queue.isDrained(), at most timeOut millisecs of clock time
+/// (< 0 is infinite, 0 is don't wait). Returns 0 if drained, -1 if timeout.
+///
+template <typename QueueTy>
+inline
+int wait_until_drained(const QueueTy & queue, int32_t timeOut)
+{
+    jmc_timestamp_t startTime = jmc_get_millisec();
+    while (!queue.isDrained()) {
+        if (timeOut >= 0 && (jmc_get_millisec() - startTime) >= (jmc_timestamp_t)timeOut)
+            return -1;
+        jimi_sleep(1);
+    }
+    return 0;
+}
+
+}  /* namespace jimi */
+
+#endif  /* _JIMI_WAIT_STRATEGY_H_ */
@@ -0,0 +1,273 @@
+
+#ifndef _JIMI_UTIL_WORKSTEALINGDEQUE_H_
+#define _JIMI_UTIL_WORKSTEALINGDEQUE_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "vs_stdint.h"
+#include "port.h"
+#include "sleep.h"
+#include "Allocator.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>     // For _ReadWriteBarrier(), InterlockedCompareExchange()
+#endif  // _MSC_VER
+#include <emmintrin.h>
+
+#include "Sequence.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace jimi {
+
+///////////////////////////////////////////////////////////////////
+// class WorkStealingDeque<T, Capacity, Allocator>
+///////////////////////////////////////////////////////////////////
+
+///
+/// A Chase-Lev work-stealing deque of T *.
+///
+/// Only the owner thread calls push() and pop(), they work on the bottom
+/// end (LIFO) and need no atomic instruction, except when pop() takes the
+/// last item and races with the thieves. Any other thread calls steal(),
+/// it takes the oldest item from the top end (FIFO) with a single CAS.
+///
+/// The ring starts with Capacity slots and doubles when push() finds it
+/// full. A thief may still be reading the old ring, so the old rings are
+/// only freed in the destructor (they add up to less than the last one).
+///
+template <typename T, uint32_t Capacity = 1024U,
+          typename Allocator = HeapAllocator>
+class WorkStealingDeque
+{
+public:
+    typedef uint32_t                    size_type;
+    typedef int64_t                     sequence_type;
+    typedef SequenceBase<int64_t>       Sequence;
+    typedef T *                         value_type;
+    typedef T *                         pointer;
+    typedef const T *                   const_pointer;
+    typedef T &                         reference;
+    typedef const T &                   const_reference;
+    typedef Allocator                   allocator_type;
+
+    struct ring_type
+    {
+        sequence_type           mask;
+        volatile value_type *   items;
+        ring_type *             prev;
+    };
+
+public:
+    static const bool       kIsAllocOnHeap  = true;
+    static const size_type  kCapacity       = (size_type)JIMI_MAX(JIMI_ROUND_TO_POW2(Capacity), 2);
+    static const size_type  kMask           = (size_type)(kCapacity - 1);
+
+public:
+    WorkStealingDeque();
+    ~WorkStealingDeque();
+
+public:
+    void dump_detail();
+
+    size_type capacity() const   { return (size_type)(this->ring->mask + 1); };
+    size_type length() const     { return sizes(); };
+    size_type sizes() const;
+
+    int push(T * item);
+    T * pop();
+    T * steal();
+
+protected:
+    ring_type * create_ring(sequence_type capacity);
+    ring_type * grow(ring_type * old, sequence_type bottom, sequence_type top);
+
+protected:
+    Sequence                top;
+    Sequence                bottom;
+    ring_type * volatile    ring;
+};
+
+template <typename T, uint32_t Capacity, typename Allocator>
+WorkStealingDeque<T, Capacity, Allocator>::WorkStealingDeque()
+: top(0)
+, bottom(0)
+, ring(NULL)
+{
+    this->ring = create_ring((sequence_type)kCapacity);
+}
+
+template <typename T, uint32_t Capacity, typename Allocator>
+WorkStealingDeque<T, Capacity, Allocator>::~WorkStealingDeque()
+{
+    ring_type * ring, * prev;
+
+    Jimi_WriteCompilerBarrier();
+
+    ring = this->ring;
+    while (ring != NULL) {
+        prev = ring->prev;
+        delete_array<value_type, Allocator>((value_type *)ring->items, (size_t)(ring->mask + 1));
+        delete ring;
+        ring = prev;
+    }
+    this->ring = NULL;
+}
+
+template <typename T, uint32_t Capacity, typename Allocator>
+inline
+typename WorkStealingDeque<T, Capacity, Allocator>::ring_type *
+WorkStealingDeque<T, Capacity, Allocator>::create_ring(sequence_type capacity)
+{
+    ring_type * ring = new ring_type;
+    if (ring == NULL)
+        return NULL;
+
+    ring->items = new_array<value_type, Allocator>((size_t)capacity);
+    if (ring->items == NULL) {
+        delete ring;
+        return NULL;
+    }
+    memset((void *)ring->items, 0, sizeof(value_type) * (size_t)capacity);
+    ring->mask = capacity - 1;
+    ring->prev = NULL;
+    return ring;
+}
+
+template <typename T, uint32_t Capacity, typename Allocator>
+void WorkStealingDeque<T, Capacity, Allocator>::dump_detail()
+{
+    printf("WorkStealingDeque: (top = %d, bottom = %d, capacity = %u)\n",
+           (int)this->top.get(), (int)this->bottom.get(), capacity());
+}
+
+template <typename T, uint32_t Capacity, typename Allocator>
+inline
+typename WorkStealingDeque<T, Capacity, Allocator>::size_type
+WorkStealingDeque<T, Capacity, Allocator>::sizes() const
+{
+    sequence_type top, bottom;
+
+    top = this->top.getOrder();
+    bottom = this->bottom.getOrder();
+
+    return (bottom > top) ? (size_type)(bottom - top) : 0;
+}
+
+///
+/// Copy the live items [top, bottom) to a ring twice as large, only the
+/// owner calls it. The thieves only read items below bottom, which are
+/// the same in both rings.
+///
+template <typename T, uint32_t Capacity, typename Allocator>
+inline
+typename WorkStealingDeque<T, Capacity, Allocator>::ring_type *
+WorkStealingDeque<T, Capacity, Allocator>::grow(ring_type * old, sequence_type bottom, sequence_type top)
+{
+    ring_type * ring;
+    sequence_type i;
+
+    ring = create_ring((old->mask + 1) * 2);
+    if (ring == NULL)
+        return NULL;
+
+    for (i = top; i < bottom; ++i)
+        ring->items[i & ring->mask] = old->items[i & old->mask];
+    ring->prev = old;
+
+    Jimi_WriteCompilerBarrier();
+    this->ring = ring;
+    return ring;
+}
+
+template <typename T, uint32_t Capacity, typename Allocator>
+inline
+int WorkStealingDeque<T, Capacity, Allocator>::push(T * item)
+{
+    sequence_type bottom, top;
+    ring_type * ring;
+
+    bottom = this->bottom.get();
+    top = this->top.getOrder();
+    ring = this->ring;
+
+    if ((bottom - top) > ring->mask) {
+        ring = grow(ring, bottom, top);
+        if (ring == NULL)
+            return -1;
+    }
+
+    ring->items[bottom & ring->mask] = item;
+    // The item must be written before the thieves can see the new bottom.
+    this->bottom.setOrder(bottom + 1);
+    return 0;
+}
+
+template <typename T, uint32_t Capacity, typename Allocator>
+inline
+T * WorkStealingDeque<T, Capacity, Allocator>::pop()
+{
+    sequence_type bottom, top;
+    ring_type * ring;
+    value_type item;
+
+    bottom = this->bottom.get() - 1;
+    ring = this->ring;
+    this->bottom.setOrder(bottom);
+
+    // The store to bottom must be seen before top is read, or a thief and
+    // the owner may both take the last item.
+    Jimi_FullMemoryBarrier();
+
+    top = this->top.getOrder();
+    if (top <= bottom) {
+        item = ring->items[bottom & ring->mask];
+        if (top == bottom) {
+            // The last item, race with the thieves for it.
+            if (!this->top.compareAndSwapBool(top, top + 1))
+                item = NULL;
+            this->bottom.setOrder(bottom + 1);
+        }
+        return item;
+    }
+    else {
+        // Empty, restore bottom.
+        this->bottom.setOrder(bottom + 1);
+        return (value_type)NULL;
+    }
+}
+
+///
+/// Take the oldest item, returns NULL if the deque is empty
+/// or another thread took the item first.
+///
+template <typename T, uint32_t Capacity, typename Allocator>
+inline
+T * WorkStealingDeque<T, Capacity, Allocator>::steal()
+{
+    sequence_type bottom, top;
+    ring_type * ring;
+    value_type item;
+
+    top = this->top.getOrder();
+    Jimi_FullMemoryBarrier();
+    bottom = this->bottom.getOrder();
+
+    if (top < bottom) {
+        ring = this->ring;
+        Jimi_ReadCompilerBarrier();
+        item = ring->items[top & ring->mask];
+        if (!this->top.compareAndSwapBool(top, top + 1))
+            return (value_type)NULL;
+        return item;
+    }
+
+    return (value_type)NULL;
+}
+
+}  /* namespace jimi */
+
+#endif  /* _JIMI_UTIL_WORKSTEALINGDEQUE_H_ */
@@ -44,6 +44,74 @@
 #endif
 #endif
 
+/**
+ * C++11 rvalue references and variadic templates, for push(T &&) and emplace()
+ */
+#if defined(__cplusplus) && ((__cplusplus >= 201103L) || defined(__GXX_EXPERIMENTAL_CXX0X__) \
+    || (defined(_MSC_VER) && (_MSC_VER >= 1800)))
+#define JIMI_HAS_CXX11_MOVE     1
+#include <utility>              // For std::move(), std::forward()
+#include <type_traits>          // For std::is_pod<T>
+#include <new>                  // For placement new
+#define JIMI_MOVE(x)            std::move(x)
+#define JIMI_IS_POD(T)          (std::is_pod<T>::value)
+#else
+#define JIMI_HAS_CXX11_MOVE     0
+#define JIMI_MOVE(x)            (x)
+#define JIMI_IS_POD(T)          (true)
+#endif
+
+/**
+ * Trivial default constructor and destructor, the queues skip constructing
+ * (destroying) their entries in place for such T.
+ */
+#if (defined(JIMI_HAS_CXX11_MOVE) && (JIMI_HAS_CXX11_MOVE != 0)) \
+    && !(defined(__GNUC__) && !defined(__clang__) && (__GNUC__ < 5))
+#define JIMI_IS_TRIVIALLY_CONSTRUCTIBLE(T)  (std::is_trivially_default_constructible<T>::value)
+#define JIMI_IS_TRIVIALLY_DESTRUCTIBLE(T)   (std::is_trivially_destructible<T>::value)
+#elif defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER)
+#define JIMI_IS_TRIVIALLY_CONSTRUCTIBLE(T)  (__has_trivial_constructor(T))
+#define JIMI_IS_TRIVIALLY_DESTRUCTIBLE(T)   (__has_trivial_destructor(T))
+#else
+#define JIMI_IS_TRIVIALLY_CONSTRUCTIBLE(T)  (false)
+#define JIMI_IS_TRIVIALLY_DESTRUCTIBLE(T)   (false)
+#endif
+
+/**
+ * C++ exceptions are enabled (not -fno-exceptions, /EHsc on MSVC)
+ */
+#if defined(__cplusplus) && (defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND))
+#define JIMI_HAS_EXCEPTIONS     1
+#else
+#define JIMI_HAS_EXCEPTIONS     0
+#endif
+
+/**
+ * Thread local storage, only for POD variables (no constructors)
+ */
+#if defined(_MSC_VER) || (defined(__INTEL_COMPILER) && defined(_WIN32))
+#define JIMI_THREAD_LOCAL       __declspec(thread)
+#define JIMI_HAS_THREAD_LOCAL   1
+#elif defined(__GNUC__) || defined(__clang__) || defined(__INTEL_COMPILER)
+#define JIMI_THREAD_LOCAL       __thread
+#define JIMI_HAS_THREAD_LOCAL   1
+#else
+#define JIMI_THREAD_LOCAL
+#define JIMI_HAS_THREAD_LOCAL   0
+#endif
+
+/**
+ * Compile-time assertion, also usable in a class scope
+ */
+#if defined(__cplusplus) && ((__cplusplus >= 201103L) || defined(__GXX_EXPERIMENTAL_CXX0X__)     || (defined(_MSC_VER) && (_MSC_VER >= 1600)))
+#define JIMI_STATIC_ASSERT(expr, msg)   static_assert((expr), msg)
+#else
+#define JIMI_STATIC_ASSERT_JOIN2(a, b)  a##b
+#define JIMI_STATIC_ASSERT_JOIN(a, b)   JIMI_STATIC_ASSERT_JOIN2(a, b)
+#define JIMI_STATIC_ASSERT(expr, msg)   \
+    typedef char JIMI_STATIC_ASSERT_JOIN(jimi_static_assert_, __LINE__)[(expr) ? 1 : -1]
+#endif
+
 /**
  * macro for round to power of 2
  */
@@ -250,6 +318,20 @@
     (uint64_t)(InterlockedExchangeAdd64((volatile LONGLONG *)(destPtr), \
                                         (LONGLONG)(addValue)))
 
+#define jimi_fetch_and_or32(destPtr, orValue)                           \
+    (uint32_t)(InterlockedOr((volatile LONG *)(destPtr), (LONG)(orValue)))
+
+#define jimi_fetch_and_and32(destPtr, andValue)                         \
+    (uint32_t)(InterlockedAnd((volatile LONG *)(destPtr), (LONG)(andValue)))
+
+#define jimi_bool_compare_and_swap_ptr(destPtr, oldValue, newValue)     \
+    (InterlockedCompareExchangePointer((PVOID volatile *)(destPtr),     \
+                            (PVOID)(newValue), (PVOID)(oldValue))       \
+                                == (PVOID)(oldValue))
+
+#define jimi_lock_test_and_set_ptr(destPtr, newValue)                   \
+    InterlockedExchangePointer((PVOID volatile *)(destPtr), (PVOID)(newValue))
+
 #elif defined(__GUNC__) || defined(__linux__) \
    || defined(__clang__) || defined(__APPLE__) || defined(__FreeBSD__) \
    || defined(__CYGWIN__) || defined(__MINGW32__)
@@ -308,6 +390,21 @@
     __sync_fetch_and_add((volatile uint64_t *)(destPtr),                \
                          (uint64_t)(addValue))
 
+#define jimi_fetch_and_or32(destPtr, orValue)                           \
+    __sync_fetch_and_or((volatile uint32_t *)(destPtr),                 \
+                        (uint32_t)(orValue))
+
+#define jimi_fetch_and_and32(destPtr, andValue)                         \
+    __sync_fetch_and_and((volatile uint32_t *)(destPtr),                \
+                         (uint32_t)(andValue))
+
+#define jimi_bool_compare_and_swap_ptr(destPtr, oldValue, newValue)     \
+    __sync_bool_compare_and_swap((void * volatile *)(destPtr),          \
+                            (void *)(oldValue), (void *)(newValue))
+
+#define jimi_lock_test_and_set_ptr(destPtr, newValue)                   \
+    __sync_lock_test_and_set((void * volatile *)(destPtr), (void *)(newValue))
+
 #else
 
 #define jimi_val_compare_and_swap32(destPtr, oldValue, newValue)        \
@@ -400,6 +497,26 @@ int get_num_of_processors(void)
 #endif
 }
 
+/* The index of the lowest set bit of x, x must not be 0. */
+static JIMIC_INLINE
+uint32_t jimi_bsf32(uint32_t x)
+{
+#if defined(_MSC_VER) || defined(__INTEL_COMPILER) || defined(__ICC)
+    unsigned long index;
+    _BitScanForward(&index, (unsigned long)x);
+    return (uint32_t)index;
+#elif defined(__GNUC__) || defined(__clang__)
+    return (uint32_t)__builtin_ctz(x);
+#else
+    uint32_t index = 0;
+    while ((x & 1U) == 0) {
+        x >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
 static JIMIC_INLINE
 int32_t __internal_val_compare_and_swap32(volatile int32_t *destPtr,
                                           int32_t oldValue,
@@ -24,6 +24,9 @@ void jimi_usleep(unsigned int usec);
 /* Sleep for Windows or MinGW */
 void jimi_wsleep(unsigned int millisec);
 
+/* Sleep with nanosecond resolution (Windows rounds up to milliseconds) */
+void jimi_nsleep(unsigned int nanosec);
+
 /* Yield(): On Windows: Switch to the other threads in the same CPU core. */
 /*          On Linux: Switch to the other threads in all cores. */
 /* On success, jimi_yield() returns 1.  On error, 0 is returned. */
@@ -93,6 +93,21 @@
 #define USE_DOUBAN_QUEUE        0
 #endif
 
+/// Ƿ JournalRingQueue  ( /dev/shm  /var/tmp д־ļ, Ĭϲ)
+#ifndef USE_JOURNAL_TEST
+#define USE_JOURNAL_TEST        0
+#endif
+
+/// Ƿ (fork) ֮ ShmRingQueue ping-pong  (Ĭϲ, ̵ֻ߳)
+#ifndef USE_FORK_PINGPONG_TEST
+#define USE_FORK_PINGPONG_TEST  0
+#endif
+
+/// Ƿ perf_event_open() ͳƴвԵ dTLB ȱʧ (ֻ Linux Ч, Ĭϲ)
+#ifndef USE_PERF_EVENT_COUNTER
+#define USE_PERF_EVENT_COUNTER  0
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////
 
 ///
@@ -150,6 +165,21 @@
 
 #define FUNC_DISRUPTOR_RINGQUEUE_EX     11
 
+/// disruptor 3.3 (C++), /, DisruptorRingQueue::push_n()
+#define FUNC_DISRUPTOR_RINGQUEUE_BATCH  12
+
+/// disruptor 3.3 (C++), , DisruptorRingQueue::drain()
+#define FUNC_DISRUPTOR_RINGQUEUE_DRAIN  13
+
+/// Vyukov н MPMC , ÿλԼ, MpmcRingQueue::push(), MpmcRingQueue::pop()
+#define FUNC_MPMC_RINGQUEUE             14
+
+/// ޽ MPMC , ɶζӶ (LCRQ ), LinkedRingQueue::push(), LinkedRingQueue::pop()
+#define FUNC_LINKED_RINGQUEUE           15
+
+/// PUSH_CNT x POP_CNT  SingleRingQueue ɵ, MeshRingQueue::push(), MeshRingQueue::pop()
+#define FUNC_MESH_RINGQUEUE             16
+
 ///
 /// RingQueueԺͶ: (úTEST_FUNC_TYPEδ, ͬڶΪ0)
 ///
@@ -16,6 +16,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <time.h>       // For gcc's mktime() and vc++'s _mktime32()
+#include <string>
 #include "vs_stdint.h"
 
 #ifndef _MSC_VER
@@ -44,6 +45,13 @@
 #include "RingQueue.h"
 #include "SerialRingQueue.h"
 #include "SingleRingQueue.h"
+#include "FastForwardQueue.h"
+#include "MpmcRingQueue.h"
+#include "LinkedRingQueue.h"
+#include "MeshRingQueue.h"
+#include "WorkStealingDeque.h"
+#include "ShmRingQueue.h"
+#include "JournalRingQueue.h"
 
 #include "MessageEvent.h"
 #include "DisruptorRingQueue.h"
@@ -55,6 +63,31 @@
 //#include <vld.h>
 #include <errno.h>
 
+#if defined(JIMI_HAS_POSIX_SHM) && (JIMI_HAS_POSIX_SHM != 0)
+#include <sys/wait.h>       // For waitpid()
+#endif
+
+#if defined(JIMI_HAS_MMAP_JOURNAL) && (JIMI_HAS_MMAP_JOURNAL != 0)
+#include <dirent.h>                 // For opendir(), cleanup of the journal test
+#include <limits.h>                 // For PATH_MAX
+#ifndef PATH_MAX
+#define PATH_MAX    4096
+#endif
+#endif
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && (defined(USE_PERF_EVENT_COUNTER) && (USE_PERF_EVENT_COUNTER != 0))
+#include <sys/ioctl.h>
+#include <sys/syscall.h>            // For SYS_perf_event_open
+#include <linux/perf_event.h>       // For dTLB miss counter
+#define JIMI_HAS_PERF_EVENT         1
+#else
+#define JIMI_HAS_PERF_EVENT         0
+#endif
+
 #if (defined(_WIN32) || defined(__MINGW32__) || defined(__CYGWIN__))
 
 #include <mmsystem.h>
@@ -107,6 +140,10 @@ __declspec(dllimport) MMRESULT __stdcall timeEndPeriod(UINT uPeriod);
 using namespace jimi;
 
 typedef RingQueue<message_t, QSIZE> RingQueue_t;
+typedef MpmcRingQueue<message_t, QSIZE> MpmcRingQueue_t;
+/* ÿ - һ SingleRingQueue,  QSIZE ͬ */
+typedef MeshRingQueue<message_t, PUSH_CNT, POP_CNT, (QSIZE / (PUSH_CNT * POP_CNT))> MeshRingQueue_t;
+typedef LinkedRingQueue<message_t, 1024> LinkedRingQueue_t;
 
 typedef CValueEvent<uint64_t>   ValueEvent_t;
 
@@ -119,6 +156,25 @@ typedef DisruptorRingQueueEx<ValueEvent_t, int32_t, QSIZE, PUSH_CNT, POP_CNT> Di
 #endif
 
 typedef SingleRingQueue<ValueEvent_t, uint32_t, QSIZE> SingleRingQueue_t;
+/* ÿ push 64 βŷһ headSequence  SingleRingQueue */
+typedef SingleRingQueue<ValueEvent_t, uint32_t, QSIZE, 64> SingleRingQueueBatch_t;
+/* ±, òλǷΪж״̬ SPSC  (FastForward), ŵָ */
+typedef FastForwardQueue<ValueEvent_t, QSIZE> FastForwardQueue_t;
+/* ڹڴ, ֮ SPSC  */
+typedef ShmRingQueue<ValueEvent_t, 1024> ShmRingQueue_t;
+/* 洢һ mmap Ķļ MPSC , ÿ 256K ¼, ͬʱӳ 4  */
+typedef JournalRingQueue<ValueEvent_t, (1 << 18), 4> JournalRingQueue_t;
+
+/* DisruptorRingQueue::drain() ¼, ȡ¼¼ pop б */
+struct DisruptorDrainHandler
+{
+    ValueEvent_t *  record_list;
+
+    void operator ()(const ValueEvent_t & event,
+                     DisruptorRingQueue_t::sequence_type /* sequence */, bool /* endOfBatch */) {
+        *record_list++ = event;
+    }
+};
 
 typedef struct thread_arg_t
 {
@@ -179,6 +235,9 @@ static volatile unsigned int pop_fail_total = 0;
 static volatile uint64_t push_cycles = 0;
 static volatile uint64_t pop_cycles = 0;
 
+/* FUNC_DISRUPTOR_RINGQUEUE_BATCH ʱÿ push_n() С */
+static int disruptor_batch_size = 1;
+
 /* topology for Xeon E5-2670 Sandybridge */
 static const int socket_top[] = {
   1,  2,  3,  4,  5,  6,  7,
@@ -210,12 +269,15 @@ RingQueue_push_task(void * arg)
     thread_arg_t *thread_arg;
     struct queue *q;
     RingQueue_t *queue;
+    MpmcRingQueue_t *mpmcQueue;
+    MeshRingQueue_t *meshQueue;
+    LinkedRingQueue_t *linkedQueue;
     DisruptorRingQueue_t *disRingQueue;
     DisruptorRingQueueEx_t *disRingQueueEx;
     message_t *msg;
     ValueEvent_t *valueEvent = NULL;
     uint64_t start;
-    int i, idx, funcType;
+    int i, idx, funcType, threadId;
 
 #if (!defined(TEST_FUNC_TYPE) || (TEST_FUNC_TYPE == 0)) \
     || (defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_RINGQUEUE_SPIN2_PUSH \
@@ -227,9 +289,13 @@ RingQueue_push_task(void * arg)
     static const uint32_t YIELD_THRESHOLD = SPIN_YIELD_THRESHOLD;
 
     idx = 0;
+    threadId = -1;
     funcType = 0;
     q = NULL;
     queue = NULL;
+    mpmcQueue = NULL;
+    meshQueue = NULL;
+    linkedQueue = NULL;
     disRingQueue = NULL;
     disRingQueueEx = NULL;
 
@@ -242,7 +308,9 @@ RingQueue_push_task(void * arg)
             if (q == NULL)
                 return NULL;
         }
-        else if (funcType == FUNC_DISRUPTOR_RINGQUEUE) {
+        else if (funcType == FUNC_DISRUPTOR_RINGQUEUE
+                 || funcType == FUNC_DISRUPTOR_RINGQUEUE_BATCH
+                 || funcType == FUNC_DISRUPTOR_RINGQUEUE_DRAIN) {
             disRingQueue = (DisruptorRingQueue_t *)thread_arg->queue;
             if (disRingQueue == NULL)
                 return NULL;
@@ -252,6 +320,22 @@ RingQueue_push_task(void * arg)
             if (disRingQueueEx == NULL)
                 return NULL;
         }
+        else if (funcType == FUNC_MPMC_RINGQUEUE) {
+            mpmcQueue = (MpmcRingQueue_t *)thread_arg->queue;
+            if (mpmcQueue == NULL)
+                return NULL;
+        }
+        else if (funcType == FUNC_MESH_RINGQUEUE) {
+            meshQueue = (MeshRingQueue_t *)thread_arg->queue;
+            if (meshQueue == NULL)
+                return NULL;
+        }
+        else if (funcType == FUNC_LINKED_RINGQUEUE) {
+            linkedQueue = (LinkedRingQueue_t *)thread_arg->queue;
+            if (linkedQueue == NULL)
+                return NULL;
+            threadId = linkedQueue->registerThread();
+        }
         else {
             queue = (RingQueue_t *)thread_arg->queue;
             if (queue == NULL)
@@ -418,7 +502,77 @@ RingQueue_push_task(void * arg)
             msg++;
         }
     }
-    else if (funcType == FUNC_DISRUPTOR_RINGQUEUE) {
+    else if (funcType == FUNC_MPMC_RINGQUEUE) {
+        // Vyukov н MPMC , ÿλԼ
+        for (i = 0; i < MAX_PUSH_MSG_COUNT; ++i) {
+            loop_cnt = 0;
+            while (mpmcQueue->push(msg) == -1) {
+                if (loop_cnt >= YIELD_THRESHOLD) {
+                    yeild_cnt = loop_cnt - YIELD_THRESHOLD;
+                    if ((yeild_cnt & 63) == 63) {
+                        jimi_wsleep(1);
+                    }
+                    else if ((yeild_cnt & 3) == 3) {
+                        jimi_wsleep(0);
+                    }
+                    else {
+                        if (!jimi_yield()) {
+                            jimi_wsleep(0);
+                        }
+                    }
+                }
+                else {
+                    for (pause_cnt = 1; pause_cnt > 0; --pause_cnt) {
+                        jimi_mm_pause();
+                    }
+                }
+                loop_cnt++;
+                fail_cnt++;
+            };
+            msg++;
+        }
+    }
+    else if (funcType == FUNC_MESH_RINGQUEUE) {
+        // N x M  SingleRingQueue ɵ,  round-robin ѡߵͨ
+        for (i = 0; i < MAX_PUSH_MSG_COUNT; ++i) {
+            loop_cnt = 0;
+            while (meshQueue->push(msg, idx) == -1) {
+                if (loop_cnt >= YIELD_THRESHOLD) {
+                    yeild_cnt = loop_cnt - YIELD_THRESHOLD;
+                    if ((yeild_cnt & 63) == 63) {
+                        jimi_wsleep(1);
+                    }
+                    else if ((yeild_cnt & 3) == 3) {
+                        jimi_wsleep(0);
+                    }
+                    else {
+                        if (!jimi_yield()) {
+                            jimi_wsleep(0);
+                        }
+                    }
+                }
+                else {
+                    for (pause_cnt = 1; pause_cnt > 0; --pause_cnt) {
+                        jimi_mm_pause();
+                    }
+                }
+                loop_cnt++;
+                fail_cnt++;
+            };
+            msg++;
+        }
+    }
+    else if (funcType == FUNC_LINKED_RINGQUEUE) {
+        // ޽ MPMC , ɶζӶ, push() Ϊʧ
+        for (i = 0; i < MAX_PUSH_MSG_COUNT; ++i) {
+            while (linkedQueue->push(msg, threadId) == -1) {
+                fail_cnt++;
+            };
+            msg++;
+        }
+    }
+    else if (funcType == FUNC_DISRUPTOR_RINGQUEUE
+             || funcType == FUNC_DISRUPTOR_RINGQUEUE_DRAIN) {
         // disruptor 3.3 (C++)
         static const uint32_t DISRUPTOR_YIELD_THRESHOLD = 20;
         for (i = 0; i < MAX_PUSH_MSG_COUNT; ++i) {
@@ -453,6 +607,46 @@ RingQueue_push_task(void * arg)
             valueEvent++;
         }
     }
+    else if (funcType == FUNC_DISRUPTOR_RINGQUEUE_BATCH) {
+        // disruptor 3.3 (C++), /
+        static const uint32_t DISRUPTOR_YIELD_THRESHOLD = 20;
+        int batch_size = (disruptor_batch_size > 0) ? disruptor_batch_size : 1;
+        int n;
+        for (i = 0; i < MAX_PUSH_MSG_COUNT; i += n) {
+            n = MAX_PUSH_MSG_COUNT - i;
+            if (n > batch_size)
+                n = batch_size;
+            loop_cnt = 0;
+            spin_cnt = 1;
+            while (disRingQueue->push_n(valueEvent, n) == -1) {
+#if 1
+                if (loop_cnt >= DISRUPTOR_YIELD_THRESHOLD) {
+                    yeild_cnt = loop_cnt - DISRUPTOR_YIELD_THRESHOLD;
+                    if ((yeild_cnt & 63) == 63) {
+                        jimi_wsleep(1);
+                    }
+                    else if ((yeild_cnt & 3) == 3) {
+                        jimi_wsleep(0);
+                    }
+                    else {
+                        if (!jimi_yield()) {
+                            jimi_wsleep(0);
+                        }
+                    }
+                }
+                else {
+                    for (pause_cnt = spin_cnt; pause_cnt > 0; --pause_cnt) {
+                        jimi_mm_pause();
+                    }
+                    spin_cnt = spin_cnt + 1;
+                }
+                loop_cnt++;
+#endif
+                fail_cnt++;
+            };
+            valueEvent += n;
+        }
+    }
     else if (funcType == FUNC_DISRUPTOR_RINGQUEUE_EX) {
         // disruptor 3.3 (C++), Ľ
         static const uint32_t DISRUPTOR_YIELD_THRESHOLD = 20;
@@ -546,6 +740,15 @@ RingQueue_push_task(void * arg)
 #elif defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_RINGQUEUE_PUSH)
         while (queue->push(msg) == -1) { fail_cnt++; };
         msg++;
+#elif defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_MPMC_RINGQUEUE)
+        while (mpmcQueue->push(msg) == -1) { fail_cnt++; };
+        msg++;
+#elif defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_MESH_RINGQUEUE)
+        while (meshQueue->push(msg, idx) == -1) { fail_cnt++; };
+        msg++;
+#elif defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_LINKED_RINGQUEUE)
+        while (linkedQueue->push(msg, threadId) == -1) { fail_cnt++; };
+        msg++;
 #elif defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_DISRUPTOR_RINGQUEUE)
         static const uint32_t DISRUPTOR_YIELD_THRESHOLD = 20;
         loop_cnt = 0;
@@ -656,6 +859,9 @@ RingQueue_pop_task(void * arg)
     thread_arg_t *thread_arg;
     struct queue *q;
     RingQueue_t *queue;
+    MpmcRingQueue_t *mpmcQueue;
+    MeshRingQueue_t *meshQueue;
+    LinkedRingQueue_t *linkedQueue;
     DisruptorRingQueue_t *disRingQueue;
     DisruptorRingQueueEx_t *disRingQueueEx;
     
@@ -664,7 +870,7 @@ RingQueue_pop_task(void * arg)
     ValueEvent_t *valueEvent = NULL;
     ValueEvent_t *dis_record_list;
     uint64_t start;
-    int idx, funcType;
+    int idx, funcType, threadId;
 
 #if (!defined(TEST_FUNC_TYPE) || (TEST_FUNC_TYPE == 0)) \
     || (defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_RINGQUEUE_SPIN2_PUSH \
@@ -676,9 +882,13 @@ RingQueue_pop_task(void * arg)
     static const uint32_t YIELD_THRESHOLD = SPIN_YIELD_THRESHOLD;
 
     idx = 0;
+    threadId = -1;
     funcType = 0;
     q = NULL;
     queue = NULL;
+    mpmcQueue = NULL;
+    meshQueue = NULL;
+    linkedQueue = NULL;
     disRingQueue = NULL;
     disRingQueueEx = NULL;
 
@@ -691,7 +901,9 @@ RingQueue_pop_task(void * arg)
             if (q == NULL)
                 return NULL;
         }
-        else if (funcType == FUNC_DISRUPTOR_RINGQUEUE) {
+        else if (funcType == FUNC_DISRUPTOR_RINGQUEUE
+                 || funcType == FUNC_DISRUPTOR_RINGQUEUE_BATCH
+                 || funcType == FUNC_DISRUPTOR_RINGQUEUE_DRAIN) {
             disRingQueue = (DisruptorRingQueue_t *)thread_arg->queue;
             if (disRingQueue == NULL)
                 return NULL;
@@ -701,6 +913,22 @@ RingQueue_pop_task(void * arg)
             if (disRingQueueEx == NULL)
                 return NULL;
         }
+        else if (funcType == FUNC_MPMC_RINGQUEUE) {
+            mpmcQueue = (MpmcRingQueue_t *)thread_arg->queue;
+            if (mpmcQueue == NULL)
+                return NULL;
+        }
+        else if (funcType == FUNC_MESH_RINGQUEUE) {
+            meshQueue = (MeshRingQueue_t *)thread_arg->queue;
+            if (meshQueue == NULL)
+                return NULL;
+        }
+        else if (funcType == FUNC_LINKED_RINGQUEUE) {
+            linkedQueue = (LinkedRingQueue_t *)thread_arg->queue;
+            if (linkedQueue == NULL)
+                return NULL;
+            threadId = linkedQueue->registerThread();
+        }
         else {
             queue = (RingQueue_t *)thread_arg->queue;
             if (queue == NULL)
@@ -902,6 +1130,117 @@ RingQueue_pop_task(void * arg)
             }
         }
     }
+    else if (funcType == FUNC_MPMC_RINGQUEUE) {
+        // Vyukov н MPMC , ÿλԼ
+        loop_cnt = 0;
+        while (true) {
+            msg = (message_t *)mpmcQueue->pop();
+            if (msg != NULL) {
+                *record_list++ = (struct message_t *)msg;
+                loop_cnt = 0;
+                pop_cnt++;
+                if (pop_cnt >= MAX_POP_MSG_COUNT)
+                    break;
+            }
+            else {
+                fail_cnt++;
+                if (loop_cnt >= YIELD_THRESHOLD) {
+                    yeild_cnt = loop_cnt - YIELD_THRESHOLD;
+                    if ((yeild_cnt & 63) == 63) {
+                        jimi_wsleep(1);
+                    }
+                    else if ((yeild_cnt & 3) == 3) {
+                        jimi_wsleep(0);
+                    }
+                    else {
+                        if (!jimi_yield()) {
+                            jimi_wsleep(0);
+                        }
+                    }
+                }
+                else {
+                    for (pause_cnt = 1; pause_cnt > 0; --pause_cnt) {
+                        jimi_mm_pause();
+                    }
+                }
+                loop_cnt++;
+            }
+        }
+    }
+    else if (funcType == FUNC_MESH_RINGQUEUE) {
+        // N x M  SingleRingQueue ɵ, ֻѯݵͨ
+        loop_cnt = 0;
+        while (true) {
+            msg = (message_t *)meshQueue->pop(idx);
+            if (msg != NULL) {
+                *record_list++ = (struct message_t *)msg;
+                loop_cnt = 0;
+                pop_cnt++;
+                if (pop_cnt >= MAX_POP_MSG_COUNT)
+                    break;
+            }
+            else {
+                fail_cnt++;
+                if (loop_cnt >= YIELD_THRESHOLD) {
+                    yeild_cnt = loop_cnt - YIELD_THRESHOLD;
+                    if ((yeild_cnt & 63) == 63) {
+                        jimi_wsleep(1);
+                    }
+                    else if ((yeild_cnt & 3) == 3) {
+                        jimi_wsleep(0);
+                    }
+                    else {
+                        if (!jimi_yield()) {
+                            jimi_wsleep(0);
+                        }
+                    }
+                }
+                else {
+                    for (pause_cnt = 1; pause_cnt > 0; --pause_cnt) {
+                        jimi_mm_pause();
+                    }
+                }
+                loop_cnt++;
+            }
+        }
+    }
+    else if (funcType == FUNC_LINKED_RINGQUEUE) {
+        // ޽ MPMC , ɶζӶ
+        loop_cnt = 0;
+        while (true) {
+            msg = (message_t *)linkedQueue->pop(threadId);
+            if (msg != NULL) {
+                *record_list++ = (struct message_t *)msg;
+                loop_cnt = 0;
+                pop_cnt++;
+                if (pop_cnt >= MAX_POP_MSG_COUNT)
+                    break;
+            }
+            else {
+                fail_cnt++;
+                if (loop_cnt >= YIELD_THRESHOLD) {
+                    yeild_cnt = loop_cnt - YIELD_THRESHOLD;
+                    if ((yeild_cnt & 63) == 63) {
+                        jimi_wsleep(1);
+                    }
+                    else if ((yeild_cnt & 3) == 3) {
+                        jimi_wsleep(0);
+                    }
+                    else {
+                        if (!jimi_yield()) {
+                            jimi_wsleep(0);
+                        }
+                    }
+                }
+                else {
+                    for (pause_cnt = 1; pause_cnt > 0; --pause_cnt) {
+                        jimi_mm_pause();
+                    }
+                }
+                loop_cnt++;
+            }
+        }
+    }
     else if (funcType == FUNC_RINGQUEUE_SPIN9_PUSH) {
         // ϸȵķspin_mutex()
         while (true) {
@@ -917,7 +1256,8 @@ RingQueue_pop_task(void * arg)
             }
         }
     }
-    else if (funcType == FUNC_DISRUPTOR_RINGQUEUE) {
+    else if (funcType == FUNC_DISRUPTOR_RINGQUEUE
+             || funcType == FUNC_DISRUPTOR_RINGQUEUE_BATCH) {
         // C++  Disruptor 3.30
         loop_cnt = 0;
         spin_cnt = 1;
@@ -937,8 +1277,11 @@ RingQueue_pop_task(void * arg)
 
         static const uint32_t DISRUPTOR_YIELD_THRESHOLD = 5;
 
+        int pop_ret;
+
         while (true) {
-            if (disRingQueue->pop(*valueEvent, stackData) == 0) {
+            pop_ret = disRingQueue->pop(*valueEvent, stackData);
+            if (pop_ret == 0) {
                 *dis_record_list++ = *valueEvent;
                 loop_cnt = 0;
                 spin_cnt = 1;
@@ -952,6 +1295,10 @@ RingQueue_pop_task(void * arg)
                 }
 #endif
             }
+            else if (pop_ret == DisruptorRingQueue_t::kHalted) {
+                // The queue was shut down and all the messages are consumed.
+                break;
+            }
             else {
                 fail_cnt++;
 #if 1
@@ -984,16 +1331,18 @@ RingQueue_pop_task(void * arg)
             pTailSequence->setMaxValue();
         }
     }
-    else if (funcType == FUNC_DISRUPTOR_RINGQUEUE_EX) {
-        // C++  Disruptor 3.30, Ľ
+    else if (funcType == FUNC_DISRUPTOR_RINGQUEUE_DRAIN) {
+        // C++  Disruptor 3.30, 
         loop_cnt = 0;
         spin_cnt = 1;
 
-        ValueEvent_t _ValueEvent;
-        valueEvent = &_ValueEvent;
-        DisruptorRingQueueEx_t::PopThreadStackData stackData;
-        DisruptorRingQueueEx_t::Sequence tailSequence;
-        DisruptorRingQueueEx_t::Sequence *pTailSequence = disRingQueueEx->getGatingSequences(idx);
+        int drain_cnt;
+        DisruptorDrainHandler handler;
+        handler.record_list = dis_record_list;
+
+        DisruptorRingQueue_t::PopThreadStackData stackData;
+        DisruptorRingQueue_t::Sequence tailSequence;
+        DisruptorRingQueue_t::Sequence *pTailSequence = disRingQueue->getGatingSequences(idx);
         if (pTailSequence == NULL)
             pTailSequence = &tailSequence;
         tailSequence.set(Sequence::INITIAL_CURSOR_VALUE);
@@ -1005,19 +1354,17 @@ RingQueue_pop_task(void * arg)
         static const uint32_t DISRUPTOR_YIELD_THRESHOLD = 5;
 
         while (true) {
-            if (disRingQueueEx->pop(*valueEvent, stackData) == 0) {
-                *dis_record_list++ = *valueEvent;
+            drain_cnt = disRingQueue->drain(handler, stackData, MAX_POP_MSG_COUNT - pop_cnt);
+            if (drain_cnt > 0) {
                 loop_cnt = 0;
                 spin_cnt = 1;
-                pop_cnt++;
+                pop_cnt += drain_cnt;
                 if (pop_cnt >= MAX_POP_MSG_COUNT)
                     break;
-
-#if defined(DISPLAY_DEBUG_INFO) && (DISPLAY_DEBUG_INFO != 0)
-                if ((pop_cnt & 0x03FF) == 0x03FF) {
-                    printf("Pop():  Thread id = %2d, count = %8d, fail_cnt = %8d\n", idx, pop_cnt, fail_cnt);
-                }
-#endif
+            }
+            else if (drain_cnt == DisruptorRingQueue_t::kHalted) {
+                // The queue was shut down and all the messages are consumed.
+                break;
             }
             else {
                 fail_cnt++;
@@ -1047,14 +1394,90 @@ RingQueue_pop_task(void * arg)
             }
         }
 
+        dis_record_list = handler.record_list;
+
         if (pTailSequence) {
             pTailSequence->setMaxValue();
         }
     }
-    else {
-        // TODO: pop() - Unknown test function type
-    }
-
+    else if (funcType == FUNC_DISRUPTOR_RINGQUEUE_EX) {
+        // C++  Disruptor 3.30, Ľ
+        loop_cnt = 0;
+        spin_cnt = 1;
+
+        ValueEvent_t _ValueEvent;
+        valueEvent = &_ValueEvent;
+        DisruptorRingQueueEx_t::PopThreadStackData stackData;
+        DisruptorRingQueueEx_t::Sequence tailSequence;
+        DisruptorRingQueueEx_t::Sequence *pTailSequence = disRingQueueEx->getGatingSequences(idx);
+        if (pTailSequence == NULL)
+            pTailSequence = &tailSequence;
+        tailSequence.set(Sequence::INITIAL_CURSOR_VALUE);
+        stackData.tailSequence = pTailSequence;
+        stackData.nextSequence = stackData.tailSequence->get();
+        stackData.cachedAvailableSequence = Sequence::INITIAL_CURSOR_VALUE;
+        stackData.processedSequence = true;
+
+        static const uint32_t DISRUPTOR_YIELD_THRESHOLD = 5;
+
+        int pop_ret;
+
+        while (true) {
+            pop_ret = disRingQueueEx->pop(*valueEvent, stackData);
+            if (pop_ret == 0) {
+                *dis_record_list++ = *valueEvent;
+                loop_cnt = 0;
+                spin_cnt = 1;
+                pop_cnt++;
+                if (pop_cnt >= MAX_POP_MSG_COUNT)
+                    break;
+
+#if defined(DISPLAY_DEBUG_INFO) && (DISPLAY_DEBUG_INFO != 0)
+                if ((pop_cnt & 0x03FF) == 0x03FF) {
+                    printf("Pop():  Thread id = %2d, count = %8d, fail_cnt = %8d\n", idx, pop_cnt, fail_cnt);
+                }
+#endif
+            }
+            else if (pop_ret == DisruptorRingQueueEx_t::kHalted) {
+                // The queue was shut down and all the messages are consumed.
+                break;
+            }
+            else {
+                fail_cnt++;
+#if 1
+                if (loop_cnt >= DISRUPTOR_YIELD_THRESHOLD) {
+                    yeild_cnt = loop_cnt - DISRUPTOR_YIELD_THRESHOLD;
+                    if ((yeild_cnt & 63) == 63) {
+                        jimi_wsleep(1);
+                    }
+                    else if ((yeild_cnt & 3) == 3) {
+                        jimi_wsleep(0);
+                    }
+                    else {
+                        if (!jimi_yield()) {
+                            jimi_wsleep(0);
+                        }
+                    }
+                }
+                else {
+                    for (pause_cnt = spin_cnt; pause_cnt > 0; --pause_cnt) {
+                        jimi_mm_pause();
+                    }
+                    spin_cnt = spin_cnt + 1;
+                }
+                loop_cnt++;
+#endif
+            }
+        }
+
+        if (pTailSequence) {
+            pTailSequence->setMaxValue();
+        }
+    }
+    else {
+        // TODO: pop() - Unknown test function type
+    }
+
 #else  /* !TEST_FUNC_TYPE */
 
 #if defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_RINGQUEUE_SPIN2_PUSH \
@@ -1209,6 +1632,12 @@ RingQueue_pop_task(void * arg)
         msg = (message_t *)queue->spin9_pop();
 #elif defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_RINGQUEUE_PUSH)
         msg = (message_t *)queue->pop();
+#elif defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_MPMC_RINGQUEUE)
+        msg = (message_t *)mpmcQueue->pop();
+#elif defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_MESH_RINGQUEUE)
+        msg = (message_t *)meshQueue->pop(idx);
+#elif defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_LINKED_RINGQUEUE)
+        msg = (message_t *)linkedQueue->pop(threadId);
 #else
         msg = NULL;
 #endif
@@ -1274,12 +1703,58 @@ RingQueue_pop_task(void * arg)
     return NULL;
 }
 
+/* single_push_task()  single_pop_task() õ push, pop, flush, Ĭǰֵŵ SingleRingQueue */
+template <typename QueueType>
+static inline
+int single_queue_push(QueueType * queue, ValueEvent_t * valueEvent)
+{
+    return queue->push(*valueEvent);
+}
+
+template <typename QueueType>
+static inline
+int single_queue_pop(QueueType * queue, ValueEvent_t & valueEvent)
+{
+    return queue->pop(valueEvent);
+}
+
+template <typename QueueType>
+static inline
+void single_queue_flush(QueueType * queue)
+{
+    queue->flush();
+}
+
+/* FastForwardQueue ŵָ, û flush() */
+static inline
+int single_queue_push(FastForwardQueue_t * queue, ValueEvent_t * valueEvent)
+{
+    return queue->push(valueEvent);
+}
+
+static inline
+int single_queue_pop(FastForwardQueue_t * queue, ValueEvent_t & valueEvent)
+{
+    ValueEvent_t * pValueEvent = queue->pop();
+    if (pValueEvent == NULL)
+        return -1;
+    valueEvent = *pValueEvent;
+    return 0;
+}
+
+static inline
+void single_queue_flush(FastForwardQueue_t * /* queue */)
+{
+    // Do nothing!
+}
+
+template <typename QueueType>
 static void *
 PTW32_API
 single_push_task(void * arg)
 {
     thread_arg_t *thread_arg;
-    SingleRingQueue_t *queue;
+    QueueType *queue;
     ValueEvent_t *valueEvent = NULL;
     uint64_t start;
     int i, idx, funcType;
@@ -1296,7 +1771,7 @@ single_push_task(void * arg)
     if (thread_arg) {
         idx      = thread_arg->idx;
         funcType = thread_arg->funcType;
-        queue    = (SingleRingQueue_t *)thread_arg->queue;
+        queue    = (QueueType *)thread_arg->queue;
         if (queue == NULL)
             return NULL;
     }
@@ -1313,7 +1788,7 @@ single_push_task(void * arg)
     for (i = 0; i < MAX_MSG_COUNT; ++i) {
         loop_cnt = 0;
         spin_cnt = 1;
-        while (queue->push(*valueEvent) == -1) {
+        while (single_queue_push(queue, valueEvent) == -1) {
 #if 1
             if (loop_cnt >= YIELD_THRESHOLD) {
                 yeild_cnt = loop_cnt - YIELD_THRESHOLD;
@@ -1341,6 +1816,8 @@ single_push_task(void * arg)
         };
         valueEvent++;
     }
+    /* һûϢ */
+    single_queue_flush(queue);
 
     //push_cycles += read_rdtsc() - start;
     jimi_fetch_and_add64(&push_cycles, read_rdtsc() - start);
@@ -1352,12 +1829,13 @@ single_push_task(void * arg)
     return NULL;
 }
 
+template <typename QueueType>
 static void *
 PTW32_API
 single_pop_task(void * arg)
 {
     thread_arg_t *thread_arg;
-    SingleRingQueue_t *queue;
+    QueueType *queue;
     ValueEvent_t *pValueEvent = NULL;
     ValueEvent_t *record_list;
     uint64_t start;
@@ -1376,7 +1854,7 @@ single_pop_task(void * arg)
     if (thread_arg) {
         idx      = thread_arg->idx;
         funcType = thread_arg->funcType;
-        queue    = (SingleRingQueue_t *)thread_arg->queue;
+        queue    = (QueueType *)thread_arg->queue;
         if (queue == NULL)
             return NULL;
     }
@@ -1396,7 +1874,7 @@ single_pop_task(void * arg)
 
     ValueEvent_t valueEvent;
     while (true) {
-        if (queue->pop(valueEvent) == 0) {
+        if (single_queue_pop(queue, valueEvent) == 0) {
             *record_list++ = valueEvent;
             loop_cnt = 0;
             spin_cnt = 1;
@@ -1836,6 +2314,9 @@ void RingQueue_Test(int funcType, bool bContinue = true)
 {
     struct queue *q;
     RingQueue_t ringQueue(true, true);
+    MpmcRingQueue_t mpmcQueue;
+    MeshRingQueue_t meshQueue;
+    LinkedRingQueue_t linkedQueue;
     DisruptorRingQueue_t disRingQueue;
     DisruptorRingQueueEx_t disRingQueueEx;
     
@@ -1879,6 +2360,19 @@ void RingQueue_Test(int funcType, bool bContinue = true)
         // q3.hlock-freeͷ
         printf("RingQueue.push() test (modified base on q3.h): (FuncId = %d)\n", funcType);
     }
+    else if (funcType == FUNC_MPMC_RINGQUEUE) {
+        // Vyukov н MPMC , ÿλԼ
+        printf("MpmcRingQueue.push() test (per-cell sequence): (FuncId = %d)\n", funcType);
+    }
+    else if (funcType == FUNC_MESH_RINGQUEUE) {
+        // N x M  SingleRingQueue ɵ
+        printf("MeshRingQueue.push() test (%d x %d SPSC lanes): (FuncId = %d)\n",
+               PUSH_CNT, POP_CNT, funcType);
+    }
+    else if (funcType == FUNC_LINKED_RINGQUEUE) {
+        // ޽ MPMC , ɶζӶ
+        printf("LinkedRingQueue.push() test (unbounded, linked segments): (FuncId = %d)\n", funcType);
+    }
     else if (funcType == FUNC_RINGQUEUE_SPIN3_PUSH) {
         // ϸȵͨspin_mutex
         printf("RingQueue.spin3_push() test: (FuncId = %d)\n", funcType);
@@ -1895,241 +2389,2622 @@ void RingQueue_Test(int funcType, bool bContinue = true)
         // disruptor 3.3 (C++) Ľ
         printf("DisruptorRingQueueEx test: (FuncId = %d)\n", funcType);
     }
-    else {
-        printf("a unknown test function: (FuncId = %d)\n", funcType);
+    else if (funcType == FUNC_DISRUPTOR_RINGQUEUE_BATCH) {
+        // disruptor 3.3 (C++) /
+        printf("DisruptorRingQueue.push_n() test, batch size = %d: (FuncId = %d)\n",
+               disruptor_batch_size, funcType);
+    }
+    else if (funcType == FUNC_DISRUPTOR_RINGQUEUE_DRAIN) {
+        // disruptor 3.3 (C++) 
+        printf("DisruptorRingQueue.drain() test: (FuncId = %d)\n", funcType);
+    }
+    else {
+        printf("a unknown test function: (FuncId = %d)\n", funcType);
+    }
+
+#if 0
+    //printf("\n");
+#if defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_RINGQUEUE_SPIN_PUSH)
+    printf("RingQueue.spin_push() test: (FuncId = %d)\n", funcType);
+#elif defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_RINGQUEUE_SPIN1_PUSH)
+    printf("RingQueue.spin1_push() test: (FuncId = %d)\n", funcType);
+#elif defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_RINGQUEUE_SPIN2_PUSH)
+    printf("RingQueue.spin2_push() test: (FuncId = %d)\n", funcType);
+#elif defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_RINGQUEUE_MUTEX_PUSH)
+    printf("RingQueue.mutex_push() test: (FuncId = %d)\n", funcType);
+#elif defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_DOUBAN_Q3H)
+    printf("DouBan's q3.h test: (FuncId = %d)\n", funcType);
+#elif defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_RINGQUEUE_SPIN3_PUSH)
+    printf("RingQueue.spin3_push() test: (FuncId = %d)\n", funcType);
+#elif defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_RINGQUEUE_SPIN9_PUSH)
+    printf("RingQueue.spin9_push() test (maybe deadlock): (FuncId = %d)\n", funcType);
+#elif defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_RINGQUEUE_PUSH)
+    printf("RingQueue.push() test (modified base on q3.h): (FuncId = %d)\n", funcType);
+#else
+    printf("a unknown test function: (%d)\n", funcType);
+#endif
+#endif
+
+    printf("---------------------------------------------------------------\n");
+
+    init_globals();
+    setaffinity(0);
+
+    test_msg_reset();
+    pop_list_reset();
+
+    disRingQueue.start();
+
+    startTime = jmc_get_timestamp();
+
+    for (i = 0; i < PUSH_CNT; ++i) {
+        thread_arg = (thread_arg_t *)malloc(sizeof(struct thread_arg_t));
+        thread_arg->idx = i;
+        thread_arg->funcType = funcType;
+        if (funcType == FUNC_DOUBAN_Q3H)
+            thread_arg->queue = (void *)q;
+        else if (funcType == FUNC_DISRUPTOR_RINGQUEUE
+                 || funcType == FUNC_DISRUPTOR_RINGQUEUE_BATCH
+                 || funcType == FUNC_DISRUPTOR_RINGQUEUE_DRAIN)
+            thread_arg->queue = (void *)&disRingQueue;
+        else if (funcType == FUNC_DISRUPTOR_RINGQUEUE_EX)
+            thread_arg->queue = (void *)&disRingQueueEx;
+        else if (funcType == FUNC_MPMC_RINGQUEUE)
+            thread_arg->queue = (void *)&mpmcQueue;
+        else if (funcType == FUNC_MESH_RINGQUEUE)
+            thread_arg->queue = (void *)&meshQueue;
+        else if (funcType == FUNC_LINKED_RINGQUEUE)
+            thread_arg->queue = (void *)&linkedQueue;
+        else
+            thread_arg->queue = (void *)&ringQueue;
+        RingQueue_start_thread(i, RingQueue_push_task, (void *)thread_arg, &kids[i]);
+    }
+    for (i = 0; i < POP_CNT; ++i) {
+        thread_arg = (thread_arg_t *)malloc(sizeof(struct thread_arg_t));
+        thread_arg->idx = i;
+        thread_arg->funcType = funcType;
+        if (funcType == FUNC_DOUBAN_Q3H)
+            thread_arg->queue = (void *)q;
+        else if (funcType == FUNC_DISRUPTOR_RINGQUEUE
+                 || funcType == FUNC_DISRUPTOR_RINGQUEUE_BATCH
+                 || funcType == FUNC_DISRUPTOR_RINGQUEUE_DRAIN)
+            thread_arg->queue = (void *)&disRingQueue;
+        else if (funcType == FUNC_DISRUPTOR_RINGQUEUE_EX)
+            thread_arg->queue = (void *)&disRingQueueEx;
+        else if (funcType == FUNC_MPMC_RINGQUEUE)
+            thread_arg->queue = (void *)&mpmcQueue;
+        else if (funcType == FUNC_MESH_RINGQUEUE)
+            thread_arg->queue = (void *)&meshQueue;
+        else if (funcType == FUNC_LINKED_RINGQUEUE)
+            thread_arg->queue = (void *)&linkedQueue;
+        else
+            thread_arg->queue = (void *)&ringQueue;
+        RingQueue_start_thread(i + PUSH_CNT, RingQueue_pop_task, (void *)thread_arg,
+                               &kids[i + PUSH_CNT]);
+    }
+    for (i = 0; i < PUSH_CNT; ++i)
+        pthread_join(kids[i], NULL);
+
+    if (funcType == FUNC_DISRUPTOR_RINGQUEUE
+        || funcType == FUNC_DISRUPTOR_RINGQUEUE_BATCH
+        || funcType == FUNC_DISRUPTOR_RINGQUEUE_DRAIN)
+        disRingQueue.shutdown();
+    else if (funcType == FUNC_DISRUPTOR_RINGQUEUE_EX)
+        disRingQueueEx.shutdown();
+
+    for (; i < (PUSH_CNT + POP_CNT); ++i)
+        pthread_join(kids[i], NULL);
+
+    stopTime = jmc_get_timestamp();
+    elapsedTime += jmc_get_interval_millisecf(stopTime - startTime);
+
+#if defined(DISPLAY_EXTRA_RESULT) && (DISPLAY_EXTRA_RESULT != 0)
+  #if defined(__clang__) || defined(__CLANG__) || defined(__APPLE__) || defined(__FreeBSD__)
+    printf("\n");
+    printf("push total: %u + %u\n", MAX_MSG_CNT, push_fail_total);
+    printf("push cycles/msg: %u\n", (uint32_t)(push_cycles / MAX_MSG_CNT));
+    printf("pop  total: %u + %u\n", pop_total, pop_fail_total);
+    if (pop_total == 0)
+        printf("pop  cycles/msg: %u\n", 0UL);
+    else
+        printf("pop  cycles/msg: %u\n", (uint32_t)(pop_cycles / pop_total));
+  #else
+    printf("\n");
+    printf("push total: %u + %u\n", MAX_MSG_CNT, push_fail_total);
+    printf("push cycles/msg: %"PRIuFAST64"\n", push_cycles / MAX_MSG_CNT);
+    printf("pop  total: %u + %u\n", pop_total, pop_fail_total);
+    if (pop_total == 0)
+        printf("pop  cycles/msg: %"PRIuFAST64"\n", 0ULL);
+    else
+        printf("pop  cycles/msg: %"PRIuFAST64"\n", pop_cycles / pop_total);
+  #endif
+#endif  /* DISPLAY_EXTRA_RESULT */
+
+    //printf("---------------------------------------------------------------\n");
+
+    printf("\n");
+    printf("time elapsed: %9.3f ms, ", elapsedTime);
+    if (elapsedTime != 0.0)
+        printf("throughput: %u ops/sec\n\n", (uint32_t)((MAX_MSG_CNT * 1000.0) / elapsedTime));
+    else
+        printf("throughput: %u ops/sec\n\n", 0U);
+
+    //jimi_console_readkeyln(false, true, false);
+
+    if (funcType == FUNC_DISRUPTOR_RINGQUEUE || funcType == FUNC_DISRUPTOR_RINGQUEUE_EX
+        || funcType == FUNC_DISRUPTOR_RINGQUEUE_BATCH || funcType == FUNC_DISRUPTOR_RINGQUEUE_DRAIN)
+        disruptor_pop_list_verify();
+    else
+        pop_list_verify();
+
+    if (funcType == FUNC_LINKED_RINGQUEUE) {
+        // ȶ״̬²ٷµĶ, ѺľĶζո
+        linkedQueue.dump_detail();
+        printf("\n");
+    }
+
+    //printf("---------------------------------------------------------------\n\n");
+
+#if 0
+    for (j = 0; j < POP_CNT; ++j) {
+        for (i = 0; i <= 256; ++i) {
+            printf("pop_list[%2d, %3d] = ptr: 0x%08p, %02"PRIuFAST64" : %"PRIuFAST64"\n", j, i,
+                   (struct msg_t *)(popmsg_list[j][i]),
+                   popmsg_list[j][i]->dummy / (MAX_PUSH_MSG_COUNT),
+                   popmsg_list[j][i]->dummy % (MAX_PUSH_MSG_COUNT));
+        }
+        printf("\n");
+        if (j < (POP_CNT - 1)) {
+            jimi_console_readkeyln(false, true, false);
+        }
+    }
+    printf("\n");
+#endif
+
+    qfree(q);
+
+    // if do not need "press any key to continue..." prompt, exit to function directly.
+    if (!bContinue) {
+        printf("---------------------------------------------------------------\n\n");
+
+#if !defined(USE_DOUBAN_QUEUE) || (USE_DOUBAN_QUEUE == 0)
+        jimi_console_readkeyln(false, true, false);
+#else
+        jimi_console_readkeyln(false, true, false);
+#endif
+    }
+}
+
+void DisruptorRingQueue_BatchTest(bool bContinue = true)
+{
+    // Сɨ: ÿֻһ CAS źһη
+    static const int kBatchSizes[] = { 1, 8, 32, 64, 128, 256 };
+    static const int kBatchSizeCnt = sizeof(kBatchSizes) / sizeof(kBatchSizes[0]);
+    int i;
+
+    for (i = 0; i < kBatchSizeCnt; ++i) {
+        disruptor_batch_size = kBatchSizes[i];
+        RingQueue_Test(FUNC_DISRUPTOR_RINGQUEUE_BATCH,
+                       (i < (kBatchSizeCnt - 1)) ? true : bContinue);
+    }
+    disruptor_batch_size = 1;
+}
+
+/* ϵͳ NUMA ڵ (Linux ϶ /sys/devices/system/node), Ϊ 1 */
+static int
+numa_node_count(void)
+{
+    int nodes = 0;
+#if defined(__linux__)
+    char path[64];
+    for (nodes = 0; nodes < 64; ++nodes) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", nodes);
+        if (access(path, F_OK) != 0)
+            break;
+    }
+#endif
+    return JIMI_MAX(nodes, 1);
+}
+
+/* NUMA ڵ node ϵĵһ CPU, Ҳʱ -1 */
+static int
+numa_node_first_cpu(int node)
+{
+#if defined(__linux__)
+    char path[64];
+    FILE * fp;
+    int cpu = -1;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    fp = fopen(path, "r");
+    if (fp == NULL)
+        return (node == 0) ? 0 : -1;
+    if (fscanf(fp, "%d", &cpu) != 1)
+        cpu = -1;
+    fclose(fp);
+    return cpu;
+#else
+    return (node == 0) ? 0 : -1;
+#endif
+}
+
+/* ѵǰ̰߳󶨵 CPU cpu , cpu С 0 ʱ󶨵 CPU () */
+static int
+numa_pin_thread(int cpu)
+{
+#if defined(__linux__)
+    cpu_set_t cpuset;
+    int i;
+
+    CPU_ZERO(&cpuset);
+    if (cpu >= 0) {
+        CPU_SET(cpu, &cpuset);
+    }
+    else {
+        for (i = 0; i < CPU_SETSIZE; ++i)
+            CPU_SET(i, &cpuset);
+    }
+    return (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) == 0) ? 0 : -1;
+#else
+    return -1;
+#endif
+}
+
+///
+/// һ̵߳ pop(entry): SingleRingQueue ȶֱӵ pop(entry),
+/// DisruptorRingQueue  DisruptorRingQueueEx Լ
+/// PopThreadStackData (ʹ id ߵ gating sequence).
+///
+template <typename QueueTy>
+struct ConsumerCursor
+{
+    QueueTy *   queue;
+
+    void init(QueueTy & queue_, int /* id */ = 0) { queue = &queue_; }
+
+    template <typename EventTy>
+    int pop(EventTy & entry) { return queue->pop(entry); }
+};
+
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers,
+          uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy,
+          typename Allocator>
+struct ConsumerCursor<DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers,
+                                         NumThreads, WaitStrategy, ClaimStrategy, Allocator> >
+{
+    typedef DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers,
+                               NumThreads, WaitStrategy, ClaimStrategy, Allocator> queue_type;
+
+    queue_type *                                queue;
+    typename queue_type::PopThreadStackData     stackData;
+
+    void init(queue_type & queue_, int id = 0) {
+        queue = &queue_;
+        stackData.tailSequence = queue->getGatingSequences(id);
+        stackData.nextSequence = stackData.tailSequence->get();
+        stackData.cachedAvailableSequence = queue_type::Sequence::INITIAL_CURSOR_VALUE;
+        stackData.processedSequence = true;
+    }
+
+    int pop(T & entry) { return queue->pop(entry, stackData); }
+};
+
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers,
+          uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
+struct ConsumerCursor<DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers,
+                                           NumThreads, WaitStrategy, Allocator> >
+{
+    typedef DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers,
+                                 NumThreads, WaitStrategy, Allocator> queue_type;
+
+    queue_type *                                queue;
+    typename queue_type::PopThreadStackData     stackData;
+
+    void init(queue_type & queue_, int id = 0) {
+        queue = &queue_;
+        stackData.tailSequence = queue->getGatingSequences(id);
+        stackData.nextSequence = stackData.tailSequence->get();
+        stackData.cachedAvailableSequence = queue_type::Sequence::INITIAL_CURSOR_VALUE;
+        stackData.processedSequence = true;
+    }
+
+    int pop(T & entry) { return queue->pop(entry, stackData); }
+};
+
+/* Կʼǰöе start(), ֻ Disruptor  */
+template <typename QueueTy>
+static inline void
+start_queue(QueueTy & /* queue */)
+{
+    // Do nothing!
+}
+
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers,
+          uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy,
+          typename Allocator>
+static inline void
+start_queue(DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers,
+                               NumThreads, WaitStrategy, ClaimStrategy, Allocator> & queue)
+{
+    queue.start();
+}
+
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers,
+          uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename Allocator>
+static inline void
+start_queue(DisruptorRingQueueEx<T, SequenceType, Capacity, Producers, Consumers,
+                                 NumThreads, WaitStrategy, Allocator> & queue)
+{
+    queue.start();
+}
+
+///
+/// ŶеĲԶ: а cache line ,  C++17 ֮ǰ new
+/// ֤, Դ HeapAllocator .
+///
+struct CacheAligned
+{
+    static void * operator new(size_t size) {
+        void * p = HeapAllocator::allocate(size);
+#if defined(JIMI_HAS_EXCEPTIONS) && (JIMI_HAS_EXCEPTIONS != 0)
+        if (p == NULL)
+            throw std::bad_alloc();
+#endif
+        return p;
+    }
+
+    static void operator delete(void * p) {
+        HeapAllocator::deallocate(p, 0);
+    }
+};
+
+///
+/// ӳٲԵĹǼ ( TestHarness), Ե Fixture ,
+/// ֻҪдԼõ start()  stop().
+///
+struct HarnessFixture : public CacheAligned
+{
+    static const int kMaxThreads = 16;
+
+    int     producers;
+    int     consumers;
+
+    HarnessFixture(int producers_ = 1, int consumers_ = 1)
+        : producers(JIMI_MIN(producers_, (int)kMaxThreads)),
+          consumers(JIMI_MIN(consumers_, (int)kMaxThreads)) {}
+
+    /* ʱ֮ǰ, ط 0 ʱ (ԭ Fixture Լ) */
+    int start() { return 0; }
+
+    /* ߳̽Ժ, ȴ֮߳ǰ,  shutdown() */
+    void stop() {}
+
+    /* û߳ (consumers = 0) ĲԲøд */
+    void consume(int /* id */) {}
+};
+
+///
+/// ӳٲԵĹǼ: Fixture::start() ֮ʼʱ,  consumers 
+/// ̵߳ Fixture::consume(id), producers ̵߳ Fixture::produce(id),
+/// ߶ Fixture::stop(), ٵ߶, ܺʱ Fixture::report().
+/// û (consumers = 0) Ĳ, ֻһ߳.
+///
+template <typename Fixture>
+class TestHarness
+{
+public:
+    struct task_arg
+    {
+        Fixture *   fixture;
+        int         id;
+    };
+
+    static void * PTW32_API producer_task(void * arg) {
+        task_arg * task = (task_arg *)arg;
+        task->fixture->produce(task->id);
+        return NULL;
+    }
+
+    static void * PTW32_API consumer_task(void * arg) {
+        task_arg * task = (task_arg *)arg;
+        task->fixture->consume(task->id);
+        return NULL;
+    }
+
+    static void run(Fixture & fixture, const char * name) {
+        pthread_t producer_threads[HarnessFixture::kMaxThreads];
+        pthread_t consumer_threads[HarnessFixture::kMaxThreads];
+        task_arg producer_args[HarnessFixture::kMaxThreads];
+        task_arg consumer_args[HarnessFixture::kMaxThreads];
+        jmc_timestamp_t startTime, stopTime;
+        int i;
+
+        if (fixture.start() != 0)
+            return;
+
+        startTime = jmc_get_timestamp();
+
+        for (i = 0; i < fixture.consumers; ++i) {
+            consumer_args[i].fixture = &fixture;
+            consumer_args[i].id = i;
+            pthread_create(&consumer_threads[i], NULL, consumer_task, (void *)&consumer_args[i]);
+        }
+        for (i = 0; i < fixture.producers; ++i) {
+            producer_args[i].fixture = &fixture;
+            producer_args[i].id = i;
+            pthread_create(&producer_threads[i], NULL, producer_task, (void *)&producer_args[i]);
+        }
+
+        for (i = 0; i < fixture.producers; ++i)
+            pthread_join(producer_threads[i], NULL);
+        fixture.stop();
+        for (i = 0; i < fixture.consumers; ++i)
+            pthread_join(consumer_threads[i], NULL);
+
+        stopTime = jmc_get_timestamp();
+        fixture.report(name, jmc_get_interval_millisecf(stopTime - startTime));
+    }
+};
+
+/* һ, fixture һ, ɵ new ,  delete */
+template <typename Fixture>
+void Harness_Run(const char * name, Fixture * fixture)
+{
+    TestHarness<Fixture>::run(*fixture, name);
+    delete fixture;
+}
+
+///
+/// Ե push(), DisruptorRingQueue Դ registerProducer() õ
+/// ߲λ, ʹÿԼ gating sequence ,  kSharedProducer,
+/// ߹һ (Ա).
+///
+template <typename QueueTy>
+static inline int
+throughput_register_producer(QueueTy & /* queue */, bool /* bPerProducerCache */)
+{
+    return -1;
+}
+
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers,
+          uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy,
+          typename Allocator>
+static inline int
+throughput_register_producer(DisruptorRingQueue<T, SequenceType, Capacity, Producers,
+                                                Consumers, NumThreads, WaitStrategy,
+                                                ClaimStrategy, Allocator> & queue,
+                             bool bPerProducerCache)
+{
+    typedef DisruptorRingQueue<T, SequenceType, Capacity, Producers, Consumers, NumThreads,
+                               WaitStrategy, ClaimStrategy, Allocator> queue_type;
+    return bPerProducerCache ? queue.registerProducer() : queue_type::kSharedProducer;
+}
+
+template <typename QueueTy>
+static inline int
+throughput_push(QueueTy & queue, const ValueEvent_t & event, int /* producerId */)
+{
+    return queue.push(event);
+}
+
+template <typename T, typename SequenceType, uint32_t Capacity, uint32_t Producers,
+          uint32_t Consumers, uint32_t NumThreads, typename WaitStrategy, typename ClaimStrategy,
+          typename Allocator>
+static inline int
+throughput_push(DisruptorRingQueue<T, SequenceType, Capacity, Producers,
+                                   Consumers, NumThreads, WaitStrategy, ClaimStrategy,
+                                   Allocator> & queue,
+                const ValueEvent_t & event, int producerId)
+{
+    return queue.push(event, producerId);
+}
+
+///
+/// DisruptorRingQueue : producers ߳, consumers ߳,
+/// ÿ push() messages / producers Ϣ,  pop() ֱ shutdown(),
+/// УϢܺ. Աͬһڲͬ Producers ģµ.
+/// bPerProducerCache Ϊ true ʱ, ÿȵ registerProducer(), һ
+/// gating sequence .
+/// producerCpu, consumerCpu С 0 ʱ,  () ̰߳󶨵 CPU .
+///
+template <typename QueueTy>
+class DisruptorThroughputTest : public HarnessFixture
+{
+public:
+    QueueTy             queue;
+    int                 messages;
+    bool                bPerProducerCache;
+    int                 producerCpu;
+    int                 consumerCpu;
+    uint64_t            push_sum[kMaxThreads];
+    uint64_t            pop_sum[kMaxThreads];
+    int                 pop_cnt[kMaxThreads];
+
+    DisruptorThroughputTest(int producers_, int consumers_, int messages_,
+                            bool bPerProducerCache_ = false)
+        : HarnessFixture(producers_, consumers_),
+          messages(messages_), bPerProducerCache(bPerProducerCache_),
+          producerCpu(-1), consumerCpu(-1) {}
+
+    int start() {
+        queue.start();
+        // û߳ʹõŲס.
+        for (int i = consumers; i < (int)QueueTy::kConsumers; ++i)
+            queue.getGatingSequences(i)->setMaxValue();
+        return 0;
+    }
+
+    void produce(int id) {
+        ValueEvent_t event;
+        uint64_t sum = 0;
+        int i, slot, count;
+
+        if (producerCpu >= 0)
+            numa_pin_thread(producerCpu);
+        slot = throughput_register_producer(queue, bPerProducerCache);
+        count = messages / producers;
+        for (i = 1; i <= count; ++i) {
+            event.setValue((uint64_t)i);
+            while (throughput_push(queue, event, slot) == -1) {
+                jimi_yield();
+            }
+            sum += (uint64_t)i;
+        }
+        push_sum[id] = sum;
+    }
+
+    void consume(int id) {
+        ConsumerCursor<QueueTy> cursor;
+        ValueEvent_t event;
+        uint64_t sum = 0;
+        int ret, count = 0;
+
+        if (consumerCpu >= 0)
+            numa_pin_thread(consumerCpu);
+        cursor.init(queue, id);
+
+        while ((ret = cursor.pop(event)) != QueueTy::kHalted) {
+            if (ret == 0) {
+                sum += event.getValue();
+                count++;
+            }
+            else {
+                jimi_yield();
+            }
+        }
+        queue.getGatingSequences(id)->setMaxValue();
+        pop_sum[id] = sum;
+        pop_cnt[id] = count;
+    }
+
+    void stop() {
+        queue.shutdown();
+    }
+
+    void report(const char * name, jmc_timefloat_t elapsedTime) {
+        uint64_t total_push_sum = 0, total_pop_sum = 0;
+        int i, total = 0;
+
+        for (i = 0; i < producers; ++i)
+            total_push_sum += push_sum[i];
+        for (i = 0; i < consumers; ++i) {
+            total_pop_sum += pop_sum[i];
+            total += pop_cnt[i];
+        }
+
+        printf("%-40s time = %9.3f ms, %8.1f msg/ms, sum check: %s\n", name, elapsedTime,
+               (elapsedTime > 0.0) ? ((double)total / elapsedTime) : 0.0,
+               (total_push_sum == total_pop_sum) ? "OK" : "Failed");
+    }
+};
+
+template <typename QueueTy>
+void DisruptorThroughput_Run(const char * name, int producers, int consumers, int messages,
+                             bool bPerProducerCache = false)
+{
+    Harness_Run(name, new DisruptorThroughputTest<QueueTy>(producers, consumers, messages,
+                                                          bPerProducerCache));
+}
+
+///
+/// NUMA ò: 1 , 1 , ֱ󶨵 producerNode, consumerNode ڵ
+/// һ CPU . bFirstTouch Ϊ true ʱ,  memoryNode ڵϹ (first-touch),
+/// еڴ QueueTy  Allocator .
+///
+template <typename QueueTy>
+void NumaPlacement_Run(const char * name, int producerNode, int consumerNode,
+                       int memoryNode, bool bFirstTouch, int messages)
+{
+    DisruptorThroughputTest<QueueTy> * test;
+    char title[128];
+
+    if (bFirstTouch)
+        numa_pin_thread(numa_node_first_cpu(memoryNode));
+    test = new DisruptorThroughputTest<QueueTy>(1, 1, messages);
+    if (bFirstTouch)
+        numa_pin_thread(-1);
+
+    test->producerCpu = numa_node_first_cpu(producerNode);
+    test->consumerCpu = numa_node_first_cpu(consumerNode);
+
+    snprintf(title, sizeof(title), "P%d C%d %s", producerNode, consumerNode, name);
+    Harness_Run(title, test);
+}
+
+void NumaPlacement_Test(int messages = MAX_MSG_COUNT)
+{
+    typedef DisruptorRingQueue<ValueEvent_t, int64_t, QSIZE, 1, 1> first_touch_queue;
+    typedef DisruptorRingQueue<ValueEvent_t, int64_t, QSIZE, 1, 1, 0, DefaultWaitStrategy,
+                               DefaultClaimStrategy, NumaAllocator<NUMA_ALLOC_BIND, 0> > node0_queue;
+    typedef DisruptorRingQueue<ValueEvent_t, int64_t, QSIZE, 1, 1, 0, DefaultWaitStrategy,
+                               DefaultClaimStrategy, NumaAllocator<NUMA_ALLOC_BIND, 1> > node1_queue;
+    typedef DisruptorRingQueue<ValueEvent_t, int64_t, QSIZE, 1, 1, 0, DefaultWaitStrategy,
+                               DefaultClaimStrategy, NumaAllocator<NUMA_ALLOC_INTERLEAVE> > interleave_queue;
+
+    int nodes = numa_node_count();
+
+    printf("---------------------------------------------------------------\n");
+    printf("NUMA placement test (DisruptorRingQueue 1P - 1C, nodes = %d):\n", nodes);
+    printf("---------------------------------------------------------------\n\n");
+
+    NumaPlacement_Run<node0_queue>       ("(mbind node 0)",         0, 0, 0, false, messages);
+    NumaPlacement_Run<first_touch_queue> ("(first-touch node 0)",   0, 0, 0, true,  messages);
+    if (nodes >= 2) {
+        // ߺڲͬĽڵ, Ա ring ڴһ.
+        NumaPlacement_Run<node0_queue>       ("(mbind node 0)",       0, 1, 0, false, messages);
+        NumaPlacement_Run<node1_queue>       ("(mbind node 1)",       0, 1, 1, false, messages);
+        NumaPlacement_Run<first_touch_queue> ("(first-touch node 1)", 0, 1, 1, true,  messages);
+        NumaPlacement_Run<interleave_queue>  ("(interleave)",         0, 1, 0, false, messages);
+    }
+    else {
+        printf("Only one NUMA node, the cross-node runs are skipped.\n");
+    }
+    printf("\n");
+}
+
+void DisruptorSingleProducer_Test(int messages = MAX_MSG_COUNT)
+{
+    printf("---------------------------------------------------------------\n");
+    printf("Disruptor single producer vs multi producer sequencer (1P - 1C):\n");
+    printf("---------------------------------------------------------------\n\n");
+
+    // ͬ 1 ߳, Producers = 1 ʱߵߵ· ( CAS,  availableBuffer ɨ).
+    DisruptorThroughput_Run<DisruptorRingQueue<ValueEvent_t, int64_t, QSIZE, 1, 1> >
+        ("DisruptorRingQueue   (single producer)", 1, 1, messages);
+    DisruptorThroughput_Run<DisruptorRingQueue<ValueEvent_t, int64_t, QSIZE, 2, 1> >
+        ("DisruptorRingQueue   (multi producer)",  1, 1, messages);
+    DisruptorThroughput_Run<DisruptorRingQueueEx<ValueEvent_t, int64_t, QSIZE, 1, 1> >
+        ("DisruptorRingQueueEx (single producer)", 1, 1, messages);
+    DisruptorThroughput_Run<DisruptorRingQueueEx<ValueEvent_t, int64_t, QSIZE, 2, 1> >
+        ("DisruptorRingQueueEx (multi producer)",  1, 1, messages);
+
+    printf("\n");
+}
+
+void DisruptorSingleConsumer_Test(int messages = MAX_MSG_COUNT)
+{
+    printf("---------------------------------------------------------------\n");
+    printf("Disruptor single consumer vs multi consumer path (%dP - 1C):\n", PUSH_CNT);
+    printf("---------------------------------------------------------------\n\n");
+
+    // ͬ 1 ߳, Consumers = 1 ʱߵߵ· ( workSequence  CAS, ).
+    DisruptorThroughput_Run<DisruptorRingQueue<ValueEvent_t, int64_t, QSIZE, PUSH_CNT, 1> >
+        ("DisruptorRingQueue   (single consumer)", PUSH_CNT, 1, messages);
+    DisruptorThroughput_Run<DisruptorRingQueue<ValueEvent_t, int64_t, QSIZE, PUSH_CNT, 2> >
+        ("DisruptorRingQueue   (multi consumer)",  PUSH_CNT, 1, messages);
+    DisruptorThroughput_Run<DisruptorRingQueueEx<ValueEvent_t, int64_t, QSIZE, PUSH_CNT, 1> >
+        ("DisruptorRingQueueEx (single consumer)", PUSH_CNT, 1, messages);
+    DisruptorThroughput_Run<DisruptorRingQueueEx<ValueEvent_t, int64_t, QSIZE, PUSH_CNT, 2> >
+        ("DisruptorRingQueueEx (multi consumer)",  PUSH_CNT, 1, messages);
+
+    printf("\n");
+}
+
+void DisruptorProducerScaling_Test(int messages = MAX_MSG_COUNT)
+{
+    typedef DisruptorRingQueue<ValueEvent_t, int64_t, QSIZE, 16, 1> queue_type;
+
+    static const int kProducerCnts[] = { 1, 2, 4, 8, 16 };
+    static const int kProducerCntSize = sizeof(kProducerCnts) / sizeof(kProducerCnts[0]);
+    char name[64];
+    int i;
+
+    printf("---------------------------------------------------------------\n");
+    printf("Disruptor producer scaling, shared vs per-producer gating cache (nP - 1C):\n");
+    printf("---------------------------------------------------------------\n\n");
+
+    for (i = 0; i < kProducerCntSize; ++i) {
+        sprintf(name, "%2dP - 1C (shared cache)", kProducerCnts[i]);
+        DisruptorThroughput_Run<queue_type>(name, kProducerCnts[i], 1, messages, false);
+        sprintf(name, "%2dP - 1C (per-producer cache)", kProducerCnts[i]);
+        DisruptorThroughput_Run<queue_type>(name, kProducerCnts[i], 1, messages, true);
+    }
+
+    printf("\n");
+}
+
+void DisruptorClaimStrategy_Test(int messages = MAX_MSG_COUNT)
+{
+    typedef DisruptorRingQueue<ValueEvent_t, int64_t, QSIZE, 16, 1, 0,
+                               DefaultWaitStrategy, CasClaimStrategy>           cas_queue_type;
+    typedef DisruptorRingQueue<ValueEvent_t, int64_t, QSIZE, 16, 1, 0,
+                               DefaultWaitStrategy, FetchAddClaimStrategy<> >   faa_queue_type;
+
+    static const int kProducerCnts[] = { 2, 4, 8, 16 };
+    static const int kProducerCntSize = sizeof(kProducerCnts) / sizeof(kProducerCnts[0]);
+    char name[64];
+    int i;
+
+    printf("---------------------------------------------------------------\n");
+    printf("Disruptor multi producer claim, CAS loop vs fetch-and-add (nP - 1C):\n");
+    printf("---------------------------------------------------------------\n\n");
+
+    for (i = 0; i < kProducerCntSize; ++i) {
+        sprintf(name, "%2dP - 1C (CAS claim)", kProducerCnts[i]);
+        DisruptorThroughput_Run<cas_queue_type>(name, kProducerCnts[i], 1, messages);
+        sprintf(name, "%2dP - 1C (fetch-and-add claim)", kProducerCnts[i]);
+        DisruptorThroughput_Run<faa_queue_type>(name, kProducerCnts[i], 1, messages);
+    }
+
+    printf("\n");
+}
+
+///
+/// getHighestPublishedSequence() ɨ:  push() һγΪ burst Ϣ,
+/// Ȼ󷴸ɨ [cursor - burst + 1, cursor], ԱȽϺ SIMD Ƚϵĺʱ.
+///
+void DisruptorSimdScan_Test()
+{
+    typedef DisruptorRingQueue<ValueEvent_t, int64_t, QSIZE, PUSH_CNT, 1> queue_type;
+    typedef queue_type::sequence_type sequence_type;
+
+    static const int kBursts[] = { 4, 16, 64, 256, 1024, 4096 };
+    static const int kBurstCnt = sizeof(kBursts) / sizeof(kBursts[0]);
+    /// ÿһܹɨĲλ
+    static const int kScanSlots = 1 << 26;
+
+    jmc_timestamp_t startTime, stopTime;
+    jmc_timefloat_t scalarTime, simdTime;
+    sequence_type lowerBound, upperBound, scalarSum, simdSum;
+    queue_type::PopThreadStackData stackData;
+    ValueEvent_t event;
+    int i, j, n, loops;
+
+    printf("---------------------------------------------------------------\n");
+#if defined(__AVX2__)
+    printf("Disruptor getHighestPublishedSequence() scan test (scalar vs AVX2):\n");
+#else
+    printf("Disruptor getHighestPublishedSequence() scan test (scalar vs SSE2):\n");
+#endif
+    printf("---------------------------------------------------------------\n\n");
+
+    for (i = 0; i < kBurstCnt; ++i) {
+        queue_type * queue = new_array<queue_type, HeapAllocator>(1);
+        queue->start();
+
+        stackData.tailSequence = queue->getGatingSequences(0);
+        stackData.nextSequence = stackData.tailSequence->get();
+        stackData.cachedAvailableSequence = Sequence::INITIAL_CURSOR_VALUE;
+        stackData.processedSequence = true;
+
+        // ƽĩβ, Ϣĩβ.
+        for (n = 0; n < QSIZE - kBursts[i] / 2; ++n) {
+            queue->push(event);
+            queue->pop(event, stackData);
+        }
+        lowerBound = (sequence_type)(QSIZE - kBursts[i] / 2);
+        upperBound = lowerBound + kBursts[i] - 1;
+        for (n = 0; n < kBursts[i]; ++n) {
+            queue->push(event);
+        }
+        loops = kScanSlots / kBursts[i];
+
+        scalarSum = 0;
+        startTime = jmc_get_timestamp();
+        for (j = 0; j < loops; ++j) {
+            scalarSum += queue->getHighestPublishedSequenceScalar(lowerBound, upperBound);
+        }
+        stopTime = jmc_get_timestamp();
+        scalarTime = jmc_get_interval_millisecf(stopTime - startTime);
+
+        simdSum = 0;
+        startTime = jmc_get_timestamp();
+        for (j = 0; j < loops; ++j) {
+            simdSum += queue->getHighestPublishedSequenceSimd(lowerBound, upperBound);
+        }
+        stopTime = jmc_get_timestamp();
+        simdTime = jmc_get_interval_millisecf(stopTime - startTime);
+
+        printf("burst = %4d, scalar = %8.3f ns/scan, simd = %8.3f ns/scan, speedup = %5.2fx, check: %s\n",
+               kBursts[i],
+               scalarTime * 1000000.0 / loops, simdTime * 1000000.0 / loops,
+               (simdTime > 0.0) ? (scalarTime / simdTime) : 0.0,
+               (scalarSum == simdSum && scalarSum == (sequence_type)loops * upperBound) ? "OK" : "Failed");
+
+        delete_array<queue_type, HeapAllocator>(queue, 1);
+    }
+
+    printf("\n");
+}
+
+/* ǰ߳ĵ CPU ʱ, λ:  */
+static double
+get_thread_cpu_time_ms(void)
+{
+#if defined(__linux__)
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+        return 0.0;
+    return ((double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0);
+#elif defined(_WIN32) || defined(_WIN64)
+    FILETIME createTime, exitTime, kernelTime, userTime;
+    ULARGE_INTEGER kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &createTime, &exitTime, &kernelTime, &userTime))
+        return 0.0;
+    kernel.LowPart  = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart    = userTime.dwLowDateTime;
+    user.HighPart   = userTime.dwHighDateTime;
+    /* FILETIME ĵλ 100  */
+    return ((double)(kernel.QuadPart + user.QuadPart) / 10000.0);
+#else
+    return 0.0;
+#endif
+}
+
+static int
+compare_int64(const void * a, const void * b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+static void
+print_latency_result(const char * name, int64_t * latency, int samples, double consumer_cpu_time)
+{
+    qsort(latency, samples, sizeof(latency[0]), compare_int64);
+
+    printf("%-32s p50 = %9.3f us, p99 = %9.3f us, consumer cpu = %9.3f ms\n", name,
+           (double)latency[samples / 2] / 1000.0,
+           (double)latency[samples * 99 / 100] / 1000.0,
+           consumer_cpu_time);
+}
+
+///
+/// Ը WaitStrategy Ļӳ: ÿһʱ push() һ
+/// ʱϢ,  waitFor() ȴ״̬, ͳ߱ѵ
+/// ӳ (p50/p99) ߳ĵ CPU ʱ.
+///
+template <typename WaitStrategyTy>
+class WaitStrategyLatencyTest : public HarnessFixture
+{
+public:
+    typedef DisruptorRingQueue<ValueEvent_t, int64_t, QSIZE, 1, 1, 0, WaitStrategyTy> queue_type;
+
+    static const int kMaxSamples = 2000;
+
+    queue_type  queue;
+    int         samples;
+    int         producer_usleep;
+    int64_t     latency[kMaxSamples];
+    double      consumer_cpu_time;
+
+    WaitStrategyLatencyTest(int samples_ = kMaxSamples, int producer_usleep_ = 100)
+        : samples(JIMI_MIN(samples_, (int)kMaxSamples)), producer_usleep(producer_usleep_),
+          consumer_cpu_time(0.0) {}
+
+    int start() {
+        queue.start();
+        return 0;
+    }
+
+    void produce(int /* id */) {
+        ValueEvent_t event;
+        int i;
+
+        for (i = 0; i < samples; ++i) {
+            jimi_usleep(producer_usleep);
+            event.setValue((uint64_t)jmc_get_nanosec());
+            while (queue.push(event) == -1) {
+                jimi_yield();
+            }
+        }
+    }
+
+    void consume(int id) {
+        ConsumerCursor<queue_type> cursor;
+        ValueEvent_t event;
+        double startCpuTime;
+        int i, ret;
+
+        cursor.init(queue, id);
+
+        startCpuTime = get_thread_cpu_time_ms();
+        // Consume until the queue is shut down and drained.
+        i = 0;
+        while (true) {
+            ret = cursor.pop(event);
+            if (ret == 0) {
+                if (i < samples)
+                    latency[i++] = (int64_t)jmc_get_nanosec() - (int64_t)event.getValue();
+            }
+            else if (ret == queue_type::kHalted) {
+                break;
+            }
+        }
+        consumer_cpu_time = get_thread_cpu_time_ms() - startCpuTime;
+    }
+
+    void stop() {
+        queue.shutdown();
+    }
+
+    void report(const char * name, jmc_timefloat_t /* elapsedTime */) {
+        print_latency_result(name, latency, samples, consumer_cpu_time);
+    }
+};
+
+void DisruptorWaitStrategy_Test()
+{
+    printf("---------------------------------------------------------------\n");
+    printf("DisruptorRingQueue WaitStrategy wake-up latency test:\n");
+    printf("---------------------------------------------------------------\n\n");
+
+    Harness_Run("BusySpinWaitStrategy",        new WaitStrategyLatencyTest<BusySpinWaitStrategy>());
+    Harness_Run("YieldingWaitStrategy",        new WaitStrategyLatencyTest<YieldingWaitStrategy<> >());
+    Harness_Run("SleepingWaitStrategy",        new WaitStrategyLatencyTest<SleepingWaitStrategy<> >());
+    Harness_Run("PhasedBackoffWaitStrategy",   new WaitStrategyLatencyTest<PhasedBackoffWaitStrategy<> >());
+    Harness_Run("BlockingWaitStrategy",        new WaitStrategyLatencyTest<BlockingWaitStrategy>());
+    Harness_Run("TimeoutBlockingWaitStrategy", new WaitStrategyLatencyTest<TimeoutBlockingWaitStrategy<> >());
+
+    printf("\n");
+}
+
+///
+/// лѲõ push/pop, bUseFutex Ϊ false ʱ, ڶΪʱ
+/// ˻ص jimi_sleep(1) ѯ, Ϊ true ʱ futex_push() / futex_pop().
+///
+static inline int
+idle_test_push(SingleRingQueue_t & queue, message_t * msg, bool bUseFutex)
+{
+    ValueEvent_t event(msg->dummy);
+    return (bUseFutex ? queue.futex_push(event) : queue.push(event));
+}
+
+static inline uint64_t
+idle_test_pop(SingleRingQueue_t & queue, bool bUseFutex)
+{
+    ValueEvent_t event;
+    if (bUseFutex) {
+        queue.futex_pop(event);
+    }
+    else {
+        while (queue.pop(event) != 0) {
+            jimi_sleep(1);
+        }
+    }
+    return event.getValue();
+}
+
+static inline int
+idle_test_push(RingQueue_t & queue, message_t * msg, bool bUseFutex)
+{
+    return (bUseFutex ? queue.futex_push(msg) : queue.spin2_push(msg));
+}
+
+static inline uint64_t
+idle_test_pop(RingQueue_t & queue, bool bUseFutex)
+{
+    message_t * msg;
+    if (bUseFutex) {
+        msg = queue.futex_pop();
+    }
+    else {
+        while ((msg = queue.spin2_pop()) == NULL) {
+            jimi_sleep(1);
+        }
+    }
+    return msg->dummy;
+}
+
+///
+/// Զпһʱ, һϢߵӳ (idle-to-first-message).
+///
+template <typename QueueTy>
+class IdleWakeupLatencyTest : public HarnessFixture
+{
+public:
+    static const int kSamples        = 200;
+    static const int kIdleUSleep     = 2000;
+
+    QueueTy     queue;
+    bool        bUseFutex;
+    message_t   msgs[kSamples];
+    int64_t     latency[kSamples];
+    double      consumer_cpu_time;
+
+    IdleWakeupLatencyTest(bool bUseFutex_) : bUseFutex(bUseFutex_), consumer_cpu_time(0.0) {}
+
+    void produce(int /* id */) {
+        int i;
+
+        for (i = 0; i < kSamples; ++i) {
+            jimi_usleep(kIdleUSleep);
+            msgs[i].dummy = (uint64_t)jmc_get_nanosec();
+            while (idle_test_push(queue, &msgs[i], bUseFutex) == -1) {
+                jimi_yield();
+            }
+        }
+    }
+
+    void consume(int /* id */) {
+        uint64_t timestamp;
+        double startCpuTime;
+        int i;
+
+        startCpuTime = get_thread_cpu_time_ms();
+        for (i = 0; i < kSamples; ++i) {
+            timestamp = idle_test_pop(queue, bUseFutex);
+            latency[i] = (int64_t)jmc_get_nanosec() - (int64_t)timestamp;
+        }
+        consumer_cpu_time = get_thread_cpu_time_ms() - startCpuTime;
+    }
+
+    void report(const char * name, jmc_timefloat_t /* elapsedTime */) {
+        print_latency_result(name, latency, kSamples, consumer_cpu_time);
+    }
+};
+
+void IdleWakeup_Test()
+{
+    static const int kSamples    = IdleWakeupLatencyTest<SingleRingQueue_t>::kSamples;
+    static const int kIdleUSleep = IdleWakeupLatencyTest<SingleRingQueue_t>::kIdleUSleep;
+
+    printf("---------------------------------------------------------------\n");
+    printf("Idle-to-first-message latency test (idle = %d us):\n", kIdleUSleep);
+    printf("---------------------------------------------------------------\n\n");
+
+    Harness_Run("DisruptorRingQueue (default)",
+                new WaitStrategyLatencyTest<DefaultWaitStrategy>(kSamples, kIdleUSleep));
+    Harness_Run("DisruptorRingQueue (futex)",
+                new WaitStrategyLatencyTest<FutexWaitStrategy<> >(kSamples, kIdleUSleep));
+    Harness_Run("SingleRingQueue (sleep)",  new IdleWakeupLatencyTest<SingleRingQueue_t>(false));
+    Harness_Run("SingleRingQueue (futex)",  new IdleWakeupLatencyTest<SingleRingQueue_t>(true));
+    Harness_Run("RingQueue (sleep)",        new IdleWakeupLatencyTest<RingQueue_t>(false));
+    Harness_Run("RingQueue (futex)",        new IdleWakeupLatencyTest<RingQueue_t>(true));
+
+    printf("\n");
+}
+
+///
+/// ༶ˮ (, 1 -> 2 -> 1) : decode -> (enrich1, enrich2) -> persist,
+/// н׶ζͬһ DisruptorRingQueue Ĳλԭش, Ҫڶ֮俽Ϣ.
+///
+struct PipelineEvent
+{
+    uint64_t    value;
+    uint64_t    decoded;
+    uint64_t    enrich1;
+    uint64_t    enrich2;
+};
+
+class DisruptorPipelineTest : public HarnessFixture
+{
+public:
+    /// 1  decode, 2  enrich, 1  persist
+    static const int kStages    = 4;
+
+    typedef DisruptorRingQueue<PipelineEvent, int64_t, QSIZE, 1, kStages> queue_type;
+    typedef queue_type::sequence_type   sequence_type;
+    typedef queue_type::barrier_type    barrier_type;
+
+    struct DecodeHandler {
+        void operator ()(PipelineEvent & event, sequence_type /* sequence */, bool /* endOfBatch */) {
+            event.decoded = event.value * 2;
+        }
+    };
+
+    struct Enrich1Handler {
+        void operator ()(PipelineEvent & event, sequence_type /* sequence */, bool /* endOfBatch */) {
+            event.enrich1 = event.decoded + 1;
+        }
+    };
+
+    struct Enrich2Handler {
+        void operator ()(PipelineEvent & event, sequence_type /* sequence */, bool /* endOfBatch */) {
+            event.enrich2 = event.decoded * 3;
+        }
+    };
+
+    struct PersistHandler {
+        uint64_t    sum;
+        int         count;
+        int         errors;
+
+        PersistHandler() : sum(0), count(0), errors(0) {}
+
+        void operator ()(PipelineEvent & event, sequence_type /* sequence */, bool /* endOfBatch */) {
+            if (event.decoded != event.value * 2 || event.enrich1 != event.decoded + 1
+                || event.enrich2 != event.decoded * 3)
+                errors++;
+            sum += event.value;
+            count++;
+        }
+    };
+
+    queue_type      queue;
+    barrier_type    enrichBarrier;
+    barrier_type    persistBarrier;
+    int             messages;
+    PersistHandler  persist;
+
+    DisruptorPipelineTest(int messages_) : HarnessFixture(1, kStages), messages(messages_) {
+        // enrich1, enrich2  decode, persist  enrich1  enrich2
+        enrichBarrier.addDependent(queue.getGatingSequences(0));
+        persistBarrier.addDependent(queue.getGatingSequences(1));
+        persistBarrier.addDependent(queue.getGatingSequences(2));
+    }
+
+    int start() {
+        queue.start();
+        return 0;
+    }
+
+    void produce(int /* id */) {
+        PipelineEvent event;
+        int i;
+
+        event.decoded = event.enrich1 = event.enrich2 = 0;
+        for (i = 1; i <= messages; ++i) {
+            event.value = (uint64_t)i;
+            while (queue.push(event) == -1) {
+                jimi_yield();
+            }
+        }
+    }
+
+    /* id  stage ı, Ҳ gating sequence ı */
+    void consume(int id) {
+        if (id == 0) {
+            DecodeHandler handler;
+            ConsumerCursor<queue_type> cursor;
+            int ret;
+
+            cursor.init(queue, 0);
+            while ((ret = queue.drain(handler, cursor.stackData)) != queue_type::kHalted) {
+                if (ret < 0)
+                    jimi_yield();
+            }
+            cursor.stackData.tailSequence->setMaxValue();
+        }
+        else if (id == 1) {
+            Enrich1Handler handler;
+            run_stage(handler, enrichBarrier, id);
+        }
+        else if (id == 2) {
+            Enrich2Handler handler;
+            run_stage(handler, enrichBarrier, id);
+        }
+        else {
+            run_stage(persist, persistBarrier, id);
+        }
+    }
+
+    template <typename HandlerTy>
+    void run_stage(HandlerTy & handler, const barrier_type & barrier, int index) {
+        queue_type::Sequence * sequence = queue.getGatingSequences(index);
+        int ret;
+
+        while ((ret = queue.process(handler, barrier, *sequence)) != queue_type::kHalted) {
+            if (ret < 0)
+                jimi_yield();
+        }
+        sequence->setMaxValue();
+    }
+
+    void stop() {
+        queue.shutdown();
+    }
+
+    void report(const char * /* name */, jmc_timefloat_t elapsedTime) {
+        uint64_t expectSum = (uint64_t)messages * ((uint64_t)messages + 1) / 2;
+
+        printf("messages = %d, persisted = %d, errors = %d, sum check: %s\n",
+               messages, persist.count, persist.errors,
+               (persist.sum == expectSum && persist.errors == 0) ? "OK" : "Failed");
+        printf("time spent: %0.3f ms\n", elapsedTime);
+        printf("throughput: %0.1f msg/ms\n\n",
+               (elapsedTime > 0.0) ? ((double)messages / elapsedTime) : 0.0);
+    }
+};
+
+void DisruptorPipeline_Test(int messages = MAX_MSG_COUNT)
+{
+    printf("---------------------------------------------------------------\n");
+    printf("DisruptorRingQueue diamond pipeline test (1 -> 2 -> 1):\n");
+    printf("---------------------------------------------------------------\n\n");
+
+    Harness_Run("diamond pipeline", new DisruptorPipelineTest(messages));
+}
+
+///
+/// 㲥 (ಥ) : ÿ鶼еϢ,  ־,   ҵ߼,
+/// ֻǸ. ÿߵϢԼı, ÿյ
+/// Ϣ, ܺ, ԼÿߵϢǷ˳򵽴.
+///
+template <int FanOut>
+class DisruptorBroadcastTest : public HarnessFixture
+{
+public:
+    static const int kProducers = PUSH_CNT;
+
+    typedef DisruptorRingQueue<ValueEvent_t, int64_t, QSIZE, kProducers, FanOut> queue_type;
+    typedef typename queue_type::sequence_type  sequence_type;
+
+    struct GroupHandler {
+        uint64_t    sum;
+        int         count;
+        int         errors;
+        uint64_t    lastValue[kProducers];
+
+        GroupHandler() : sum(0), count(0), errors(0) {
+            for (int i = 0; i < kProducers; ++i)
+                lastValue[i] = 0;
+        }
+
+        void operator ()(ValueEvent_t & event, sequence_type /* sequence */, bool /* endOfBatch */) {
+            uint64_t value = event.getValue();
+            int producer = (int)(value >> 32);
+            if (producer < 0 || producer >= kProducers
+                || (value & 0xFFFFFFFFULL) != lastValue[producer] + 1)
+                errors++;
+            else
+                lastValue[producer]++;
+            sum += value & 0xFFFFFFFFULL;
+            count++;
+        }
+    };
+
+    queue_type      queue;
+    int             messages;
+    GroupHandler    handlers[FanOut];
+    int             groups[FanOut];
+
+    DisruptorBroadcastTest(int messages_)
+        : HarnessFixture(kProducers, FanOut), messages(messages_) {
+        for (int i = 0; i < FanOut; ++i)
+            groups[i] = queue.addConsumerGroup();
+    }
+
+    int start() {
+        queue.start();
+        return 0;
+    }
+
+    void produce(int id) {
+        int producerId = queue.registerProducer();
+        int i, count = messages / kProducers;
+
+        for (i = 1; i <= count; ++i) {
+            ValueEvent_t event(((uint64_t)id << 32) | (uint64_t)i);
+            while (queue.push(event, producerId) == -1) {
+                jimi_yield();
+            }
+        }
+    }
+
+    void consume(int id) {
+        int ret;
+
+        while ((ret = queue.consume(handlers[id], groups[id])) != queue_type::kHalted) {
+            if (ret < 0)
+                jimi_yield();
+        }
+    }
+
+    void stop() {
+        queue.shutdown();
+    }
+
+    void report(const char * /* name */, jmc_timefloat_t elapsedTime) {
+        uint64_t perProducer = (uint64_t)(messages / kProducers);
+        uint64_t expectSum = perProducer * (perProducer + 1) / 2 * kProducers;
+        int i, expectCount = (int)perProducer * kProducers;
+        bool allOK = true;
+
+        printf("fan-out = %d, messages = %d\n", FanOut, expectCount);
+        for (i = 0; i < FanOut; ++i) {
+            bool ok = (handlers[i].count == expectCount && handlers[i].sum == expectSum
+                       && handlers[i].errors == 0);
+            printf("  group %d: received = %d, errors = %d, sum check: %s\n",
+                   i, handlers[i].count, handlers[i].errors, ok ? "OK" : "Failed");
+            allOK = allOK && ok;
+        }
+        printf("every group saw every event: %s\n", allOK ? "OK" : "Failed");
+        printf("time spent: %0.3f ms\n", elapsedTime);
+        printf("throughput: %0.1f msg/ms (per group)\n\n",
+               (elapsedTime > 0.0) ? ((double)expectCount / elapsedTime) : 0.0);
+    }
+};
+
+void DisruptorBroadcast_Test(int messages = MAX_MSG_COUNT)
+{
+    printf("---------------------------------------------------------------\n");
+    printf("DisruptorRingQueue broadcast consumer groups test (fan-out 1 - 3):\n");
+    printf("---------------------------------------------------------------\n\n");
+
+    Harness_Run("fan-out 1", new DisruptorBroadcastTest<1>(messages));
+    Harness_Run("fan-out 2", new DisruptorBroadcastTest<2>(messages));
+    Harness_Run("fan-out 3", new DisruptorBroadcastTest<3>(messages));
+}
+
+///
+/// 256 ֽڵĴϢ, Ա push()/pop()  claim()/commit(), peek()/release() ԭضд.
+///
+struct LargeEvent
+{
+    uint64_t    data[32];
+};
+
+static inline uint64_t
+large_event_fill(LargeEvent & event, uint64_t value)
+{
+    uint64_t sum = 0;
+    for (int i = 0; i < 32; ++i) {
+        event.data[i] = value + i;
+        sum += value + i;
+    }
+    return sum;
+}
+
+static inline uint64_t
+large_event_sum(const LargeEvent & event)
+{
+    uint64_t sum = 0;
+    for (int i = 0; i < 32; ++i) {
+        sum += event.data[i];
+    }
+    return sum;
+}
+
+struct LargeSingleQueue
+{
+    typedef SingleRingQueue<LargeEvent, uint32_t, QSIZE> queue_type;
+
+    queue_type  queue;
+
+    void start() {}
+
+    int push(uint64_t value, uint64_t & sum, bool bZeroCopy) {
+        if (bZeroCopy) {
+            queue_type::sequence_type sequence;
+            LargeEvent * event = queue.claim(sequence);
+            if (event == NULL)
+                return -1;
+            sum += large_event_fill(*event, value);
+            queue.commit(sequence);
+            return 0;
+        }
+        else {
+            LargeEvent event;
+            uint64_t eventSum = large_event_fill(event, value);
+            if (queue.push(event) != 0)
+                return -1;
+            sum += eventSum;
+            return 0;
+        }
+    }
+
+    int pop(uint64_t & sum, bool bZeroCopy) {
+        if (bZeroCopy) {
+            const LargeEvent * event = queue.peek();
+            if (event == NULL)
+                return -1;
+            sum += large_event_sum(*event);
+            queue.release();
+            return 0;
+        }
+        else {
+            LargeEvent event;
+            if (queue.pop(event) != 0)
+                return -1;
+            sum += large_event_sum(event);
+            return 0;
+        }
+    }
+};
+
+struct LargeDisruptorQueue
+{
+    typedef DisruptorRingQueue<LargeEvent, int64_t, QSIZE, 1, 1> queue_type;
+
+    queue_type                  queue;
+    ConsumerCursor<queue_type>  cursor;
+
+    void start() {
+        queue.start();
+        cursor.init(queue);
+    }
+
+    int push(uint64_t value, uint64_t & sum, bool bZeroCopy) {
+        if (bZeroCopy) {
+            queue_type::sequence_type sequence;
+            LargeEvent * event = queue.claim(sequence);
+            if (event == NULL)
+                return -1;
+            sum += large_event_fill(*event, value);
+            queue.commit(sequence);
+            return 0;
+        }
+        else {
+            LargeEvent event;
+            uint64_t eventSum = large_event_fill(event, value);
+            if (queue.push(event) != 0)
+                return -1;
+            sum += eventSum;
+            return 0;
+        }
+    }
+
+    int pop(uint64_t & sum, bool bZeroCopy) {
+        if (bZeroCopy) {
+            const LargeEvent * event;
+            if (queue.peek(event, cursor.stackData) != 0)
+                return -1;
+            sum += large_event_sum(*event);
+            queue.release(cursor.stackData);
+            return 0;
+        }
+        else {
+            LargeEvent event;
+            if (cursor.pop(event) != 0)
+                return -1;
+            sum += large_event_sum(event);
+            return 0;
+        }
+    }
+};
+
+template <typename QueueTy>
+class ZeroCopyTest : public HarnessFixture
+{
+public:
+    QueueTy     queue;
+    int         messages;
+    bool        bZeroCopy;
+    uint64_t    push_sum;
+    uint64_t    pop_sum;
+
+    ZeroCopyTest(int messages_, bool bZeroCopy_)
+        : messages(messages_), bZeroCopy(bZeroCopy_), push_sum(0), pop_sum(0) {}
+
+    int start() {
+        queue.start();
+        return 0;
+    }
+
+    void produce(int /* id */) {
+        uint64_t sum = 0;
+        int i;
+
+        for (i = 0; i < messages; ++i) {
+            while (queue.push((uint64_t)i, sum, bZeroCopy) != 0) {
+                jimi_yield();
+            }
+        }
+        push_sum = sum;
+    }
+
+    void consume(int /* id */) {
+        uint64_t sum = 0;
+        int i;
+
+        for (i = 0; i < messages; ++i) {
+            while (queue.pop(sum, bZeroCopy) != 0) {
+                jimi_yield();
+            }
+        }
+        pop_sum = sum;
+    }
+
+    void report(const char * name, jmc_timefloat_t elapsedTime) {
+        printf("%-36s time = %9.3f ms, %8.1f MB/s, sum check: %s\n", name, elapsedTime,
+               (elapsedTime > 0.0) ? ((double)messages * sizeof(LargeEvent) / 1024.0 / 1024.0
+                                      / (elapsedTime / 1000.0)) : 0.0,
+               (push_sum == pop_sum) ? "OK" : "Failed");
+    }
+};
+
+void ZeroCopy_Test(int messages = MAX_MSG_COUNT / 4)
+{
+    printf("---------------------------------------------------------------\n");
+    printf("Zero-copy claim/commit, peek/release test (event size = %d bytes):\n",
+           (int)sizeof(LargeEvent));
+    printf("---------------------------------------------------------------\n\n");
+
+    Harness_Run("SingleRingQueue push/pop",      new ZeroCopyTest<LargeSingleQueue>(messages, false));
+    Harness_Run("SingleRingQueue claim/peek",    new ZeroCopyTest<LargeSingleQueue>(messages, true));
+    Harness_Run("DisruptorRingQueue push/pop",   new ZeroCopyTest<LargeDisruptorQueue>(messages, false));
+    Harness_Run("DisruptorRingQueue claim/peek", new ZeroCopyTest<LargeDisruptorQueue>(messages, true));
+
+    printf("\n");
+}
+
+#if defined(JIMI_HAS_CXX11_MOVE) && (JIMI_HAS_CXX11_MOVE != 0)
+
+///
+///  std::string Ϣ, Ա push(const T &) , push(T &&) ƶ emplace() ԭع
+/// ڴ. ü allocator ͳ std::string ķ.
+///
+static volatile uint32_t string_alloc_count = 0;
+
+template <typename T>
+class CountingAllocator
+{
+public:
+    typedef T                   value_type;
+    typedef T *                 pointer;
+    typedef const T *           const_pointer;
+    typedef T &                 reference;
+    typedef const T &           const_reference;
+    typedef size_t              size_type;
+    typedef ptrdiff_t           difference_type;
+
+    template <typename U>
+    struct rebind { typedef CountingAllocator<U> other; };
+
+    CountingAllocator() {}
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U> &) {}
+
+    pointer allocate(size_type n, const void * /* hint */ = 0) {
+        jimi_fetch_and_add32(&string_alloc_count, 1);
+        return (pointer)::operator new(n * sizeof(T));
+    }
+
+    void deallocate(pointer p, size_type /* n */) {
+        ::operator delete((void *)p);
+    }
+
+    size_type max_size() const { return ((size_type)(-1)) / sizeof(T); }
+
+    void construct(pointer p, const T & value) { new ((void *)p) T(value); }
+    void destroy(pointer p) { p->~T(); }
+
+    template <typename U>
+    bool operator == (const CountingAllocator<U> &) const { return true; }
+    template <typename U>
+    bool operator != (const CountingAllocator<U> &) const { return false; }
+};
+
+typedef std::basic_string<char, std::char_traits<char>, CountingAllocator<char> > counted_string;
+
+struct StringEvent
+{
+    counted_string  text;
+    uint64_t        value;
+
+    StringEvent() : value(0) {}
+    StringEvent(const char * text_, size_t length, uint64_t value_)
+        : text(text_, length), value(value_) {}
+};
+
+/// push ķʽ
+#define MOVE_TEST_COPY          0
+#define MOVE_TEST_MOVE          1
+#define MOVE_TEST_EMPLACE       2
+
+template <typename QueueTy>
+class MoveSemanticsTest : public HarnessFixture
+{
+public:
+    ///  std::string  SSO , ÿϢҪڴ
+    static const int kTextLength = 64;
+
+    QueueTy                 queue;
+    ConsumerCursor<QueueTy> cursor;
+    int                     messages;
+    int                     pushMode;
+    char                    text[kTextLength + 1];
+    uint64_t                pop_sum;
+    int                     errors;
+
+    MoveSemanticsTest(int messages_, int pushMode_)
+        : messages(messages_), pushMode(pushMode_), pop_sum(0), errors(0) {
+        for (int i = 0; i < kTextLength; ++i)
+            text[i] = (char)('a' + (i % 26));
+        text[kTextLength] = '\0';
+    }
+
+    int start() {
+        start_queue(queue);
+        cursor.init(queue);
+        string_alloc_count = 0;
+        return 0;
+    }
+
+    void produce(int /* id */) {
+        int i;
+
+        for (i = 1; i <= messages; ++i) {
+            if (pushMode == MOVE_TEST_EMPLACE) {
+                while (queue.emplace(text, (size_t)kTextLength, (uint64_t)i) != 0) {
+                    jimi_yield();
+                }
+            }
+            else {
+                StringEvent event(text, (size_t)kTextLength, (uint64_t)i);
+                if (pushMode == MOVE_TEST_MOVE) {
+                    // push(T &&) only moves the event when it succeeds.
+                    while (queue.push(std::move(event)) != 0) {
+                        jimi_yield();
+                    }
+                }
+                else {
+                    while (queue.push(event) != 0) {
+                        jimi_yield();
+                    }
+                }
+            }
+        }
+    }
+
+    void consume(int /* id */) {
+        uint64_t sum = 0;
+        int i;
+
+        for (i = 0; i < messages; ++i) {
+            StringEvent event;
+            while (cursor.pop(event) != 0) {
+                jimi_yield();
+            }
+            if (event.text.size() != (size_t)kTextLength)
+                errors++;
+            sum += event.value;
+        }
+        pop_sum = sum;
+    }
+
+    void report(const char * name, jmc_timefloat_t elapsedTime) {
+        uint32_t allocCount = string_alloc_count;
+        uint64_t expectSum = (uint64_t)messages * ((uint64_t)messages + 1) / 2;
+
+        printf("%-38s time = %9.3f ms, allocs = %9u (%4.2f / msg), check: %s\n",
+               name, elapsedTime, allocCount, (double)allocCount / messages,
+               (pop_sum == expectSum && errors == 0) ? "OK" : "Failed");
+    }
+};
+
+void MoveSemantics_Test(int messages = MAX_MSG_COUNT / 4)
+{
+    printf("---------------------------------------------------------------\n");
+    printf("Move semantics test (std::string event, copy vs move vs emplace):\n");
+    printf("---------------------------------------------------------------\n\n");
+
+    typedef SingleRingQueue<StringEvent, uint32_t, QSIZE>                   single_queue;
+    typedef DisruptorRingQueue<StringEvent, int64_t, QSIZE, 1, 1>           disruptor_queue;
+    typedef DisruptorRingQueueEx<StringEvent, int64_t, QSIZE, 1, 1>         disruptor_ex_queue;
+
+    Harness_Run("SingleRingQueue push(const T &)",
+                new MoveSemanticsTest<single_queue>(messages, MOVE_TEST_COPY));
+    Harness_Run("SingleRingQueue push(T &&)",
+                new MoveSemanticsTest<single_queue>(messages, MOVE_TEST_MOVE));
+    Harness_Run("SingleRingQueue emplace()",
+                new MoveSemanticsTest<single_queue>(messages, MOVE_TEST_EMPLACE));
+    Harness_Run("DisruptorRingQueue push(const T &)",
+                new MoveSemanticsTest<disruptor_queue>(messages, MOVE_TEST_COPY));
+    Harness_Run("DisruptorRingQueue push(T &&)",
+                new MoveSemanticsTest<disruptor_queue>(messages, MOVE_TEST_MOVE));
+    Harness_Run("DisruptorRingQueue emplace()",
+                new MoveSemanticsTest<disruptor_queue>(messages, MOVE_TEST_EMPLACE));
+    Harness_Run("DisruptorRingQueueEx push(const T &)",
+                new MoveSemanticsTest<disruptor_ex_queue>(messages, MOVE_TEST_COPY));
+    Harness_Run("DisruptorRingQueueEx push(T &&)",
+                new MoveSemanticsTest<disruptor_ex_queue>(messages, MOVE_TEST_MOVE));
+    Harness_Run("DisruptorRingQueueEx emplace()",
+                new MoveSemanticsTest<disruptor_ex_queue>(messages, MOVE_TEST_EMPLACE));
+
+    printf("\n");
+}
+
+#endif  /* JIMI_HAS_CXX11_MOVE */
+
+template <typename QueueType>
+void SingleProducerSingleConsumer_Run(const char * name, bool bContinue)
+{
+    QueueType srq;
+
+    static const int kPushCnt = 1;
+    static const int kPopCnt  = 1;
+    pthread_t kids[kPushCnt + kPopCnt] = { 0 };
+    thread_arg_t *thread_arg;
+    jmc_timestamp_t startTime, stopTime;
+    jmc_timefloat_t elapsedTime = 0.0;
+    int i;
+
+    printf("---------------------------------------------------------------\n");
+    printf("(One Producer + One Consumer) %s test:\n", name);
+    printf("---------------------------------------------------------------\n");
+
+    init_globals();
+    setaffinity(0);
+
+    test_msg_reset();
+    pop_list_reset();
+
+    startTime = jmc_get_timestamp();
+
+    for (i = 0; i < kPushCnt; ++i) {
+        thread_arg = (thread_arg_t *)malloc(sizeof(struct thread_arg_t));
+        thread_arg->idx = i;
+        thread_arg->funcType = FUNC_DOUBAN_Q3H;
+        thread_arg->queue = (void *)&srq;
+        RingQueue_start_thread(i, single_push_task<QueueType>, (void *)thread_arg, &kids[i]);
+    }
+    for (i = 0; i < kPopCnt; ++i) {
+        thread_arg = (thread_arg_t *)malloc(sizeof(struct thread_arg_t));
+        thread_arg->idx = i;
+        thread_arg->funcType = FUNC_DOUBAN_Q3H;
+        thread_arg->queue = (void *)&srq;
+        RingQueue_start_thread(i + kPushCnt, single_pop_task<QueueType>, (void *)thread_arg, &kids[i + kPushCnt]);
+    }
+    for (i = 0; i < (kPushCnt + kPopCnt); ++i)
+        pthread_join(kids[i], NULL);
+
+    stopTime = jmc_get_timestamp();
+    elapsedTime += jmc_get_interval_millisecf(stopTime - startTime);
+
+#if defined(DISPLAY_EXTRA_RESULT) && (DISPLAY_EXTRA_RESULT != 0)
+  #if defined(__clang__) || defined(__CLANG__) || defined(__APPLE__) || defined(__FreeBSD__)
+    printf("\n");
+    printf("push total: %u + %u\n", MAX_MSG_CNT, push_fail_total);
+    printf("push cycles/msg: %u\n", (uint32_t)(push_cycles / MAX_MSG_CNT));
+    printf("pop  total: %u + %u\n", pop_total, pop_fail_total);
+    if (pop_total == 0)
+        printf("pop  cycles/msg: %u\n", 0UL);
+    else
+        printf("pop  cycles/msg: %u\n", (uint32_t)(pop_cycles / pop_total));
+  #else
+    printf("\n");
+    printf("push total: %u + %u\n", MAX_MSG_CNT, push_fail_total);
+    printf("push cycles/msg: %"PRIuFAST64"\n", push_cycles / MAX_MSG_CNT);
+    printf("pop  total: %u + %u\n", pop_total, pop_fail_total);
+    if (pop_total == 0)
+        printf("pop  cycles/msg: %"PRIuFAST64"\n", 0ULL);
+    else
+        printf("pop  cycles/msg: %"PRIuFAST64"\n", pop_cycles / pop_total);
+  #endif
+#endif  /* DISPLAY_EXTRA_RESULT */
+
+    printf("\n");
+    printf("time elapsed: %9.3f ms, ", elapsedTime);
+    if (elapsedTime != 0.0)
+        printf("throughput: %u ops/sec\n", (uint32_t)((MAX_MSG_CNT * 1000.0) / elapsedTime));
+    else
+        printf("throughput: %u ops/sec\n", 0U);
+    printf("\n");
+
+    disruptor_pop_list_verify();
+
+    // if do not need "press any key to continue..." prompt, exit to function directly.
+    if (!bContinue) {
+        printf("---------------------------------------------------------------\n\n");
+
+#if !defined(USE_DOUBAN_QUEUE) || (USE_DOUBAN_QUEUE == 0)
+        jimi_console_readkeyln(false, true, false);
+#else
+        jimi_console_readkeyln(false, true, false);
+#endif
+    }
+}
+
+void SingleProducerSingleConsumer_Test(bool bContinue = true)
+{
+    SingleProducerSingleConsumer_Run<SingleRingQueue_t>("SingleRingQueue", true);
+    /*  headSequence, ߸ٵؿߵ cache line д */
+    SingleProducerSingleConsumer_Run<SingleRingQueueBatch_t>("SingleRingQueue (publish batch = 64)", true);
+    /* ±, λΪռ, ߸ǰ̽ 4  cache line */
+    SingleProducerSingleConsumer_Run<FastForwardQueue_t>("FastForwardQueue", bContinue);
+}
+
+/* fork-join : м fib(n), ÿ worker Լ WorkStealingDeque */
+struct WorkStealingForkJoinTest : public CacheAligned
+{
+    static const int kMaxWorkers    = 8;
+    /* n С kCutoff ʱٲ, ֱӴм */
+    static const int kCutoff        = 14;
+
+    struct FibTask {
+        int         n;
+        FibTask *   next;
+    };
+
+    typedef WorkStealingDeque<FibTask, 256> deque_type;
+
+    struct Worker {
+        deque_type                  deque;
+        WorkStealingForkJoinTest *  test;
+        FibTask *                   freeList;
+        uint64_t                    sum;
+        uint32_t                    tasks;
+        uint32_t                    steals;
+        uint32_t                    seed;
+        int                         id;
+        char                        padding[JIMI_CACHELINE_SIZE];
+    };
+
+    Worker          workers[kMaxWorkers];
+    int             numWorkers;
+    int             fibN;
+    /* ûִ,  0 ʱ worker ˳ */
+    volatile uint32_t pending;
+
+    WorkStealingForkJoinTest(int numWorkers_, int fibN_)
+        : numWorkers(numWorkers_), fibN(fibN_), pending(0) {
+        int i;
+        for (i = 0; i < kMaxWorkers; ++i) {
+            workers[i].test     = this;
+            workers[i].freeList = NULL;
+            workers[i].sum      = 0;
+            workers[i].tasks    = 0;
+            workers[i].steals   = 0;
+            workers[i].seed     = (uint32_t)(i * 2654435761U + 1);
+            workers[i].id       = i;
+        }
+    }
+
+    ~WorkStealingForkJoinTest() {
+        FibTask * task;
+        int i;
+        for (i = 0; i < kMaxWorkers; ++i) {
+            while ((task = workers[i].freeList) != NULL) {
+                workers[i].freeList = task->next;
+                delete task;
+            }
+        }
+    }
+
+    static uint64_t fib_serial(int n) {
+        return (n < 2) ? (uint64_t)n : (fib_serial(n - 1) + fib_serial(n - 2));
+    }
+
+    /* ִŻִ worker  freeList, ֻи worker Լ */
+    static FibTask * alloc_task(Worker * worker, int n) {
+        FibTask * task = worker->freeList;
+        if (task != NULL)
+            worker->freeList = task->next;
+        else
+            task = new FibTask;
+        task->n = n;
+        return task;
+    }
+
+    static void run_task(Worker * worker, FibTask * task) {
+        int n = task->n;
+        task->next = worker->freeList;
+        worker->freeList = task;
+
+        /*  fib(n - 2) Լ deque ȱ͵, Լ fib(n - 1) */
+        while (n >= kCutoff) {
+            jimi_fetch_and_add32(&worker->test->pending, 1);
+            worker->deque.push(alloc_task(worker, n - 2));
+            n = n - 1;
+        }
+        worker->sum += fib_serial(n);
+        worker->tasks++;
+        jimi_fetch_and_add32(&worker->test->pending, -1);
+    }
+
+    static void * PTW32_API worker_task(void * arg) {
+        Worker * worker = (Worker *)arg;
+        WorkStealingForkJoinTest * test = worker->test;
+        FibTask * task;
+        uint32_t idle_cnt = 0;
+        int victim;
+
+        while (test->pending != 0) {
+            task = worker->deque.pop();
+            if (task == NULL && test->numWorkers > 1) {
+                worker->seed = worker->seed * 1103515245U + 12345U;
+                victim = (int)((worker->seed >> 16) % (uint32_t)(test->numWorkers - 1));
+                if (victim >= worker->id)
+                    victim++;
+                task = test->workers[victim].deque.steal();
+                if (task != NULL)
+                    worker->steals++;
+            }
+            if (task != NULL) {
+                run_task(worker, task);
+                idle_cnt = 0;
+            }
+            else {
+                if (++idle_cnt >= 4)
+                    jimi_yield();
+                else
+                    jimi_mm_pause();
+            }
+        }
+        return NULL;
+    }
+
+    void run(uint64_t expectSum) {
+        pthread_t kids[kMaxWorkers];
+        jmc_timestamp_t startTime, stopTime;
+        jmc_timefloat_t elapsedTime;
+        uint64_t sum;
+        uint32_t tasks, steals;
+        int i;
+
+        pending = 1;
+        workers[0].deque.push(alloc_task(&workers[0], fibN));
+
+        startTime = jmc_get_timestamp();
+
+        for (i = 0; i < numWorkers; ++i)
+            pthread_create(&kids[i], NULL, worker_task, (void *)&workers[i]);
+        for (i = 0; i < numWorkers; ++i)
+            pthread_join(kids[i], NULL);
+
+        stopTime = jmc_get_timestamp();
+        elapsedTime = jmc_get_interval_millisecf(stopTime - startTime);
+
+        sum = 0;
+        tasks = steals = 0;
+        for (i = 0; i < numWorkers; ++i) {
+            sum    += workers[i].sum;
+            tasks  += workers[i].tasks;
+            steals += workers[i].steals;
+        }
+
+        printf("workers = %d, fib(%d) = %" PRIuFAST64 ", tasks = %u, steals = %u, check: %s, "
+               "time spent: %0.3f ms\n",
+               numWorkers, fibN, sum, tasks, steals,
+               (sum == expectSum) ? "OK" : "Failed", elapsedTime);
+    }
+};
+
+void WorkStealing_Test(int fibN = 36)
+{
+    uint64_t expectSum;
+    int workers;
+
+    printf("---------------------------------------------------------------\n");
+    printf("WorkStealingDeque fork-join test (parallel fib):\n");
+    printf("---------------------------------------------------------------\n\n");
+
+    expectSum = WorkStealingForkJoinTest::fib_serial(fibN);
+
+    for (workers = 1; workers <= WorkStealingForkJoinTest::kMaxWorkers; workers *= 2) {
+        WorkStealingForkJoinTest * test = new WorkStealingForkJoinTest(workers, fibN);
+        test->run(expectSum);
+        delete test;
+    }
+    printf("\n");
+}
+
+///
+/// ping-pong õ push/pop, bUseFutex Ϊ false ʱ, ʱ jimi_yield() ,
+/// Ϊ true ʱ futex_push() / futex_pop().
+///
+template <typename QueueTy>
+static inline void
+pingpong_send(QueueTy & queue, uint64_t value, bool bUseFutex)
+{
+    ValueEvent_t event(value);
+    while ((bUseFutex ? queue.futex_push(event) : queue.push(event)) != 0) {
+        jimi_yield();
+    }
+}
+
+template <typename QueueTy>
+static inline uint64_t
+pingpong_recv(QueueTy & queue, bool bUseFutex)
+{
+    ValueEvent_t event;
+    if (bUseFutex) {
+        queue.futex_pop(event);
+    }
+    else {
+        while (queue.pop(event) != 0) {
+            jimi_yield();
+        }
+    }
+    return event.getValue();
+}
+
+/* :  ping յʲô, ԭƻ pong  */
+template <typename QueueTy>
+static void
+pingpong_echo(QueueTy & ping, QueueTy & pong, int rounds, bool bUseFutex)
+{
+    int i;
+    for (i = 0; i < rounds; ++i) {
+        pingpong_send(pong, pingpong_recv(ping, bUseFutex), bUseFutex);
+    }
+}
+
+/* :  1  rounds, Ȼ, ػԵĴ */
+template <typename QueueTy>
+static int
+pingpong_issue(QueueTy & ping, QueueTy & pong, int rounds, bool bUseFutex)
+{
+    int i, errors = 0;
+    for (i = 1; i <= rounds; ++i) {
+        pingpong_send(ping, (uint64_t)i, bUseFutex);
+        if (pingpong_recv(pong, bUseFutex) != (uint64_t)i)
+            errors++;
+    }
+    return errors;
+}
+
+static void
+pingpong_print_result(const char * name, int rounds, int errors, jmc_timefloat_t elapsedTime)
+{
+    printf("%-34s rounds = %d, round-trip = %0.3f us, check: %s\n",
+           name, rounds, elapsedTime * 1000.0 / rounds, (errors == 0) ? "OK" : "Failed");
+}
+
+///
+/// ͬһ֮߳ ping-pong, ֮ĽԱ.
+///
+class PingPongThreadTest : public HarnessFixture
+{
+public:
+    SingleRingQueue_t   ping;
+    SingleRingQueue_t   pong;
+    int                 rounds;
+    bool                bUseFutex;
+    int                 errors;
+
+    PingPongThreadTest(int rounds_, bool bUseFutex_)
+        : rounds(rounds_), bUseFutex(bUseFutex_), errors(0) {}
+
+    /* ߷ ping, ߰յֵƻȥ */
+    void produce(int /* id */) {
+        errors = pingpong_issue(ping, pong, rounds, bUseFutex);
+    }
+
+    void consume(int /* id */) {
+        pingpong_echo(ping, pong, rounds, bUseFutex);
+    }
+
+    void report(const char * name, jmc_timefloat_t elapsedTime) {
+        pingpong_print_result(name, rounds, errors, elapsedTime);
+    }
+};
+
+#if defined(JIMI_HAS_POSIX_SHM) && (JIMI_HAS_POSIX_SHM != 0)
+
+///
+/// ֮ ping-pong:  shm_open()  ShmRingQueue, fork() 
+/// ӽ̰ attach(), յֵƻȥ.
+///
+void ShmPingPong_ProcessRun(const char * name, int rounds, bool bUseFutex)
+{
+    char pingName[64], pongName[64];
+    ShmRingQueue_t ping, pong;
+    jmc_timestamp_t startTime, stopTime;
+    pid_t child;
+    int status, errors;
+
+    snprintf(pingName, sizeof(pingName), "/jimi_rq_ping_%d", (int)getpid());
+    snprintf(pongName, sizeof(pongName), "/jimi_rq_pong_%d", (int)getpid());
+
+    if (ping.create(pingName) != 0 || pong.create(pongName) != 0) {
+        printf("%-34s create shared memory failed (errno = %d)\n", name, errno);
+        ShmRingQueue_t::unlink(pingName);
+        ShmRingQueue_t::unlink(pongName);
+        return;
+    }
+
+    fflush(stdout);
+    child = fork();
+    if (child == 0) {
+        // ӽ: ü̳ӳ,  attach.
+        ShmRingQueue_t childPing, childPong;
+        while (childPing.attach(pingName) != 0) {
+            jimi_yield();
+        }
+        while (childPong.attach(pongName) != 0) {
+            jimi_yield();
+        }
+        pingpong_echo(childPing, childPong, rounds, bUseFutex);
+        _exit(0);
+    }
+    else if (child < 0) {
+        printf("%-34s fork() failed (errno = %d)\n", name, errno);
+        ShmRingQueue_t::unlink(pingName);
+        ShmRingQueue_t::unlink(pongName);
+        return;
+    }
+
+    startTime = jmc_get_timestamp();
+    errors = pingpong_issue(ping, pong, rounds, bUseFutex);
+    stopTime = jmc_get_timestamp();
+
+    waitpid(child, &status, 0);
+    ShmRingQueue_t::unlink(pingName);
+    ShmRingQueue_t::unlink(pongName);
+
+    pingpong_print_result(name, rounds, errors, jmc_get_interval_millisecf(stopTime - startTime));
+}
+
+#endif  /* JIMI_HAS_POSIX_SHM */
+
+void ShmPingPong_Test(int rounds = 100000)
+{
+    printf("---------------------------------------------------------------\n");
+    printf("Ping-pong round-trip latency test (threads vs processes):\n");
+    printf("---------------------------------------------------------------\n\n");
+
+    Harness_Run("SingleRingQueue, threads (yield)", new PingPongThreadTest(rounds, false));
+    Harness_Run("SingleRingQueue, threads (futex)", new PingPongThreadTest(rounds, true));
+#if !defined(USE_FORK_PINGPONG_TEST) || (USE_FORK_PINGPONG_TEST == 0)
+    printf("ShmRingQueue: the processes test is off (USE_FORK_PINGPONG_TEST = 0).\n");
+#elif defined(JIMI_HAS_POSIX_SHM) && (JIMI_HAS_POSIX_SHM != 0)
+    ShmPingPong_ProcessRun("ShmRingQueue, processes (yield)", rounds, false);
+    ShmPingPong_ProcessRun("ShmRingQueue, processes (futex)", rounds, true);
+#else
+    printf("ShmRingQueue: shared memory is not supported on this platform.\n");
+#endif
+    printf("\n");
+}
+
+#if defined(JIMI_HAS_MMAP_JOURNAL) && (JIMI_HAS_MMAP_JOURNAL != 0)
+
+/* replay() ¼, ͳƼ¼ܺ */
+struct JournalReplayCounter
+{
+    uint64_t    sum;
+    int         count;
+
+    JournalReplayCounter() : sum(0), count(0) {}
+
+    void operator ()(const ValueEvent_t & event, JournalRingQueue_t::sequence_type /* sequence */) {
+        sum += event.getValue();
+        count++;
+    }
+};
+
+/* ɾ־Ŀ¼ dir ļ (ǰӳĿն), ɾĿ¼ */
+static void
+journal_remove_dir(const char * dir)
+{
+    char path[PATH_MAX];
+    struct dirent * entry;
+    DIR * d;
+    int len;
+
+    if ((d = opendir(dir)) != NULL) {
+        while ((entry = readdir(d)) != NULL) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+                continue;
+            len = snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+            if (len < 0 || len >= (int)sizeof(path)) {
+                // ·Ų, ļ,  rmdir() Ҳʧ
+                printf("journal_remove_dir(): path too long, skip: %s/%s\n", dir, entry->d_name);
+                continue;
+            }
+            unlink(path);
+        }
+        closedir(d);
+    }
+    rmdir(dir);
+}
+
+///
+/// JournalRingQueue : producers ߳, 1 ߳, ̨ roll ߳
+///  msync() ͻ.  replay() ־, У¼ܺ.
+/// ־д baseDir  mkdtemp() ʱĿ¼, Խɾ.
+///
+class JournalThroughputTest : public HarnessFixture
+{
+public:
+    JournalRingQueue_t  journal;
+    const char *        baseDir;
+    char                dir[200];
+    int                 messages;
+    uint64_t            push_sum[kMaxThreads];
+    uint64_t            pop_sum;
+    int                 pop_cnt;
+
+    JournalThroughputTest(const char * baseDir_, int producers_, int messages_)
+        : HarnessFixture(producers_, 1), baseDir(baseDir_), messages(messages_),
+          pop_sum(0), pop_cnt(0) {
+        dir[0] = '\0';
+        for (int i = 0; i < kMaxThreads; ++i)
+            push_sum[i] = 0;
+    }
+
+    ~JournalThroughputTest() {
+        journal.close();
+        if (dir[0] != '\0')
+            journal_remove_dir(dir);
+    }
+
+    int start() {
+        snprintf(dir, sizeof(dir), "%s/jimi_journal_XXXXXX", baseDir);
+        if (mkdtemp(dir) == NULL) {
+            printf("can't create a temp dir in %s (errno = %d)\n", baseDir, errno);
+            dir[0] = '\0';
+            return -1;
+        }
+        if (journal.open(dir) != 0) {
+            printf("can't open the journal in %s (errno = %d)\n", dir, errno);
+            return -1;
+        }
+        journal.start();
+        return 0;
+    }
+
+    void produce(int id) {
+        ValueEvent_t event;
+        uint64_t sum = 0;
+        int i, count = messages / producers;
+
+        for (i = 1; i <= count; ++i) {
+            event.setValue((uint64_t)i);
+            // roll ̻߳ʧ () ʱ push()  -1.
+            if (journal.push(event) != 0)
+                break;
+            sum += (uint64_t)i;
+        }
+        push_sum[id] = sum;
+    }
+
+    void consume(int /* id */) {
+        ValueEvent_t event;
+        uint64_t sum = 0;
+        int count = 0, total = (messages / producers) * producers;
+
+        while (count < total) {
+            if (journal.pop(event) == 0) {
+                sum += event.getValue();
+                count++;
+            }
+            else if (journal.is_failed()) {
+                break;
+            }
+            else {
+                jimi_yield();
+            }
+        }
+        pop_sum = sum;
+        pop_cnt = count;
+    }
+
+    void report(const char * name, jmc_timefloat_t elapsedTime) {
+        jmc_timestamp_t startTime, stopTime;
+        jmc_timefloat_t replayTime;
+        JournalReplayCounter counter;
+        JournalRingQueue_t::sequence_type end;
+        uint64_t total_push_sum = 0;
+        int i;
+
+        journal.close();
+
+        // ͷط־.
+        startTime = jmc_get_timestamp();
+        end = JournalRingQueue_t::replay(dir, 0, counter);
+        stopTime = jmc_get_timestamp();
+        replayTime = jmc_get_interval_millisecf(stopTime - startTime);
+
+        for (i = 0; i < producers; ++i)
+            total_push_sum += push_sum[i];
+
+        printf("%-40s time = %9.3f ms, %8.1f msg/ms, sum check: %s\n", name, elapsedTime,
+               (elapsedTime > 0.0) ? ((double)pop_cnt / elapsedTime) : 0.0,
+               (total_push_sum == pop_sum) ? "OK" : "Failed");
+        printf("%-40s time = %9.3f ms, %8.1f msg/ms, replay check: %s\n", "    replay()", replayTime,
+               (replayTime > 0.0) ? ((double)counter.count / replayTime) : 0.0,
+               (end == (JournalRingQueue_t::sequence_type)pop_cnt && counter.sum == pop_sum) ? "OK" : "Failed");
+    }
+};
+
+#endif  /* JIMI_HAS_MMAP_JOURNAL */
+
+void Journal_Test(int messages = MAX_MSG_COUNT / 4)
+{
+    printf("---------------------------------------------------------------\n");
+    printf("JournalRingQueue throughput test (%d producers, 1 consumer):\n", PUSH_CNT);
+    printf("---------------------------------------------------------------\n\n");
+
+    DisruptorThroughput_Run<DisruptorRingQueue<ValueEvent_t, int64_t, QSIZE, PUSH_CNT, 1> >
+        ("DisruptorRingQueue   (in-memory)", PUSH_CNT, 1, messages);
+#if defined(JIMI_HAS_MMAP_JOURNAL) && (JIMI_HAS_MMAP_JOURNAL != 0)
+    // tmpfs ϵ־ֻ mmap ͻεĿ, /var/tmp (ͨڱش) ĻлдĿ.
+    Harness_Run("JournalRingQueue     (tmpfs, /dev/shm)",
+                new JournalThroughputTest("/dev/shm", PUSH_CNT, messages));
+    Harness_Run("JournalRingQueue     (disk, /var/tmp)",
+                new JournalThroughputTest("/var/tmp", PUSH_CNT, messages));
+#else
+    printf("JournalRingQueue: memory mapped files are not supported on this platform.\n");
+#endif
+    printf("\n");
+}
+
+///
+/// ǰ̵߳ dTLB ȱʧ (Linux  perf_event_open), û USE_PERF_EVENT_COUNTER
+/// ߴ򲻿ʱ (ûȨ, û PMU ) read()  -1.
+///
+struct DTlbMissCounter
+{
+    int     fd;
+
+    DTlbMissCounter() : fd(-1) {
+#if defined(JIMI_HAS_PERF_EVENT) && (JIMI_HAS_PERF_EVENT != 0) && defined(SYS_perf_event_open)
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB
+                    | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                    | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    }
+
+    ~DTlbMissCounter() {
+#if defined(JIMI_HAS_PERF_EVENT) && (JIMI_HAS_PERF_EVENT != 0)
+        if (fd >= 0)
+            close(fd);
+#endif
     }
 
-#if 0
-    //printf("\n");
-#if defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_RINGQUEUE_SPIN_PUSH)
-    printf("RingQueue.spin_push() test: (FuncId = %d)\n", funcType);
-#elif defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_RINGQUEUE_SPIN1_PUSH)
-    printf("RingQueue.spin1_push() test: (FuncId = %d)\n", funcType);
-#elif defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_RINGQUEUE_SPIN2_PUSH)
-    printf("RingQueue.spin2_push() test: (FuncId = %d)\n", funcType);
-#elif defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_RINGQUEUE_MUTEX_PUSH)
-    printf("RingQueue.mutex_push() test: (FuncId = %d)\n", funcType);
-#elif defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_DOUBAN_Q3H)
-    printf("DouBan's q3.h test: (FuncId = %d)\n", funcType);
-#elif defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_RINGQUEUE_SPIN3_PUSH)
-    printf("RingQueue.spin3_push() test: (FuncId = %d)\n", funcType);
-#elif defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_RINGQUEUE_SPIN9_PUSH)
-    printf("RingQueue.spin9_push() test (maybe deadlock): (FuncId = %d)\n", funcType);
-#elif defined(TEST_FUNC_TYPE) && (TEST_FUNC_TYPE == FUNC_RINGQUEUE_PUSH)
-    printf("RingQueue.push() test (modified base on q3.h): (FuncId = %d)\n", funcType);
-#else
-    printf("a unknown test function: (%d)\n", funcType);
+    void start() {
+#if defined(JIMI_HAS_PERF_EVENT) && (JIMI_HAS_PERF_EVENT != 0)
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
 #endif
+    }
+
+    int64_t read() {
+#if defined(JIMI_HAS_PERF_EVENT) && (JIMI_HAS_PERF_EVENT != 0)
+        uint64_t count;
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (::read(fd, &count, sizeof(count)) == (ssize_t)sizeof(count))
+                return (int64_t)count;
+        }
 #endif
+        return -1;
+    }
+};
 
-    printf("---------------------------------------------------------------\n");
+///
+/// еڴ: ĺʱ, һ (ҳһα, ȱҳж)
+/// ͵ڶ push  pop еĺʱ, Լÿһ dTLB ȱʧ.
+/// Disruptor ֻ 1 , 1 ߵİ汾, ߻ס push().
+///
+template <typename QueueTy>
+class LargeRingTest : public HarnessFixture
+{
+public:
+    static const uint32_t kCapacity = QueueTy::kCapacity;
 
-    init_globals();
-    setaffinity(0);
+    QueueTy *               queue;
+    ConsumerCursor<QueueTy> cursor;
+    jmc_timefloat_t         initTime;
+    jmc_timefloat_t         passTime[2];
+    int64_t                 misses[2];
+    uint64_t                sum;
 
-    test_msg_reset();
-    pop_list_reset();
+    /* ֻһ߳, push  pop  */
+    LargeRingTest() : HarnessFixture(1, 0), queue(NULL), initTime(0.0), sum(0) {}
 
-    disRingQueue.start();
+    ~LargeRingTest() {
+        delete_array<QueueTy, HeapAllocator>(queue, 1);
+    }
 
-    startTime = jmc_get_timestamp();
+    int start() {
+        jmc_timestamp_t startTime, stopTime;
 
-    for (i = 0; i < PUSH_CNT; ++i) {
-        thread_arg = (thread_arg_t *)malloc(sizeof(struct thread_arg_t));
-        thread_arg->idx = i;
-        thread_arg->funcType = funcType;
-        if (funcType == FUNC_DOUBAN_Q3H)
-            thread_arg->queue = (void *)q;
-        else if (funcType == FUNC_DISRUPTOR_RINGQUEUE)
-            thread_arg->queue = (void *)&disRingQueue;
-        else if (funcType == FUNC_DISRUPTOR_RINGQUEUE_EX)
-            thread_arg->queue = (void *)&disRingQueueEx;
-        else
-            thread_arg->queue = (void *)&ringQueue;
-        RingQueue_start_thread(i, RingQueue_push_task, (void *)thread_arg, &kids[i]);
+        startTime = jmc_get_timestamp();
+        queue = new_array<QueueTy, HeapAllocator>(1);
+        stopTime = jmc_get_timestamp();
+        initTime = jmc_get_interval_millisecf(stopTime - startTime);
+
+        cursor.init(*queue);
+        return 0;
     }
-    for (i = 0; i < POP_CNT; ++i) {
-        thread_arg = (thread_arg_t *)malloc(sizeof(struct thread_arg_t));
-        thread_arg->idx = i;
-        thread_arg->funcType = funcType;
-        if (funcType == FUNC_DOUBAN_Q3H)
-            thread_arg->queue = (void *)q;
-        else if (funcType == FUNC_DISRUPTOR_RINGQUEUE)
-            thread_arg->queue = (void *)&disRingQueue;
-        else if (funcType == FUNC_DISRUPTOR_RINGQUEUE_EX)
-            thread_arg->queue = (void *)&disRingQueueEx;
-        else
-            thread_arg->queue = (void *)&ringQueue;
-        RingQueue_start_thread(i + PUSH_CNT, RingQueue_pop_task, (void *)thread_arg,
-                               &kids[i + PUSH_CNT]);
+
+    void produce(int /* id */) {
+        // perf ֻͳƴ߳.
+        DTlbMissCounter counter;
+        jmc_timestamp_t startTime, stopTime;
+        ValueEvent_t event;
+        uint32_t i;
+        int pass;
+
+        for (pass = 0; pass < 2; ++pass) {
+            counter.start();
+            startTime = jmc_get_timestamp();
+            for (i = 0; i < kCapacity; ++i) {
+                event.setValue((uint64_t)i);
+                queue->push(event);
+            }
+            for (i = 0; i < kCapacity; ++i) {
+                cursor.pop(event);
+                sum += event.getValue();
+            }
+            stopTime = jmc_get_timestamp();
+            misses[pass] = counter.read();
+            passTime[pass] = jmc_get_interval_millisecf(stopTime - startTime);
+        }
     }
-    for (i = 0; i < PUSH_CNT; ++i)
-        pthread_join(kids[i], NULL);
 
-    disRingQueue.shutdown();
+    void report(const char * name, jmc_timefloat_t /* elapsedTime */) {
+        printf("%-38s init = %8.3f ms, 1st pass = %8.3f ms, 2nd pass = %8.3f ms, ",
+               name, initTime, passTime[0], passTime[1]);
+        if (misses[0] >= 0)
+            printf("dTLB misses = %" PRIu64 " / %" PRIu64 ", ", (uint64_t)misses[0], (uint64_t)misses[1]);
+        else
+            printf("dTLB misses = n/a, ");
+        printf("check: %s\n", (sum == (uint64_t)kCapacity * (kCapacity - 1)) ? "OK" : "Failed");
+    }
+};
 
-    for (; i < (PUSH_CNT + POP_CNT); ++i)
-        pthread_join(kids[i], NULL);
+void LargeRing_Test()
+{
+    /* 2^22 λ, ValueEvent_t Ϊ 8 ֽ, һ 32 MB */
+    static const uint32_t kLargeCapacity = (1U << 22);
 
-    stopTime = jmc_get_timestamp();
-    elapsedTime += jmc_get_interval_millisecf(stopTime - startTime);
+    printf("---------------------------------------------------------------\n");
+    printf("Large ring allocation test (capacity = %u):\n", kLargeCapacity);
+    printf("---------------------------------------------------------------\n\n");
 
-#if defined(DISPLAY_EXTRA_RESULT) && (DISPLAY_EXTRA_RESULT != 0)
-  #if defined(__clang__) || defined(__CLANG__) || defined(__APPLE__) || defined(__FreeBSD__)
-    printf("\n");
-    printf("push total: %u + %u\n", MAX_MSG_CNT, push_fail_total);
-    printf("push cycles/msg: %u\n", (uint32_t)(push_cycles / MAX_MSG_CNT));
-    printf("pop  total: %u + %u\n", pop_total, pop_fail_total);
-    if (pop_total == 0)
-        printf("pop  cycles/msg: %u\n", 0UL);
-    else
-        printf("pop  cycles/msg: %u\n", (uint32_t)(pop_cycles / pop_total));
-  #else
+    typedef SingleRingQueue<ValueEvent_t, uint32_t, kLargeCapacity, 1, HeapAllocator>
+            single_heap_queue;
+    typedef SingleRingQueue<ValueEvent_t, uint32_t, kLargeCapacity, 1,
+                            HugePageAllocator<PAGE_ALLOC_HUGE> >
+            single_huge_queue;
+    typedef SingleRingQueue<ValueEvent_t, uint32_t, kLargeCapacity, 1,
+                            HugePageAllocator<PAGE_ALLOC_HUGE | PAGE_ALLOC_POPULATE> >
+            single_populate_queue;
+    typedef SingleRingQueue<ValueEvent_t, uint32_t, kLargeCapacity, 1,
+                            HugePageAllocator<PAGE_ALLOC_HUGE | PAGE_ALLOC_POPULATE
+                                              | PAGE_ALLOC_LOCK> >
+            single_mlock_queue;
+    typedef DisruptorRingQueue<ValueEvent_t, int64_t, kLargeCapacity, 1, 1, 0,
+                               DefaultWaitStrategy, DefaultClaimStrategy, HeapAllocator>
+            disruptor_heap_queue;
+    typedef DisruptorRingQueue<ValueEvent_t, int64_t, kLargeCapacity, 1, 1, 0,
+                               DefaultWaitStrategy, DefaultClaimStrategy,
+                               HugePageAllocator<PAGE_ALLOC_HUGE> >
+            disruptor_huge_queue;
+    typedef DisruptorRingQueueEx<ValueEvent_t, int64_t, kLargeCapacity, 1, 1, 0,
+                                 DefaultWaitStrategy, HeapAllocator>
+            disruptor_ex_heap_queue;
+    typedef DisruptorRingQueueEx<ValueEvent_t, int64_t, kLargeCapacity, 1, 1, 0,
+                                 DefaultWaitStrategy, HugePageAllocator<PAGE_ALLOC_HUGE> >
+            disruptor_ex_huge_queue;
+
+    Harness_Run("SingleRingQueue, HeapAllocator",         new LargeRingTest<single_heap_queue>());
+    Harness_Run("SingleRingQueue, HugePage (huge)",       new LargeRingTest<single_huge_queue>());
+    Harness_Run("SingleRingQueue, HugePage (populate)",   new LargeRingTest<single_populate_queue>());
+    Harness_Run("SingleRingQueue, HugePage (+ mlock)",    new LargeRingTest<single_mlock_queue>());
+
+    // Disruptor л availableBuffer, ҳһ.
+    Harness_Run("DisruptorRingQueue, HeapAllocator",      new LargeRingTest<disruptor_heap_queue>());
+    Harness_Run("DisruptorRingQueue, HugePage (huge)",    new LargeRingTest<disruptor_huge_queue>());
+    Harness_Run("DisruptorRingQueueEx, HeapAllocator",    new LargeRingTest<disruptor_ex_heap_queue>());
+    Harness_Run("DisruptorRingQueueEx, HugePage (huge)",  new LargeRingTest<disruptor_ex_huge_queue>());
     printf("\n");
-    printf("push total: %u + %u\n", MAX_MSG_CNT, push_fail_total);
-    printf("push cycles/msg: %"PRIuFAST64"\n", push_cycles / MAX_MSG_CNT);
-    printf("pop  total: %u + %u\n", pop_total, pop_fail_total);
-    if (pop_total == 0)
-        printf("pop  cycles/msg: %"PRIuFAST64"\n", 0ULL);
-    else
-        printf("pop  cycles/msg: %"PRIuFAST64"\n", pop_cycles / pop_total);
-  #endif
-#endif  /* DISPLAY_EXTRA_RESULT */
-
-    //printf("---------------------------------------------------------------\n");
+}
 
-    printf("\n");
-    printf("time elapsed: %9.3f ms, ", elapsedTime);
-    if (elapsedTime != 0.0)
-        printf("throughput: %u ops/sec\n\n", (uint32_t)((MAX_MSG_CNT * 1000.0) / elapsedTime));
-    else
-        printf("throughput: %u ops/sec\n\n", 0U);
+///
+/// ܶСеķ:  kQueues , ÿ push  pop һ, Ȼ,
+/// ԱÿиԴӶϷ (HeapAllocator) ʹͬһڴг (ArenaAllocator).
+///
+template <typename QueueTy>
+class ArenaQueuesTest : public HarnessFixture
+{
+public:
+    static const uint32_t kCapacity = QueueTy::kCapacity;
 
-    //jimi_console_readkeyln(false, true, false);
+    QueueTy **      queues;
+    uint32_t        kQueues;
+    jmc_timefloat_t initTime;
+    jmc_timefloat_t passTime;
+    uint64_t        sum;
 
-    if (funcType == FUNC_DISRUPTOR_RINGQUEUE || funcType == FUNC_DISRUPTOR_RINGQUEUE_EX)
-        disruptor_pop_list_verify();
-    else
-        pop_list_verify();
+    /* ֻһ߳,  push  pop ÿһ */
+    ArenaQueuesTest(uint32_t kQueues_)
+        : HarnessFixture(1, 0), queues(NULL), kQueues(kQueues_), initTime(0.0), passTime(0.0), sum(0) {}
 
-    //printf("---------------------------------------------------------------\n\n");
+    ~ArenaQueuesTest() {
+        free_queues();
+    }
 
-#if 0
-    for (j = 0; j < POP_CNT; ++j) {
-        for (i = 0; i <= 256; ++i) {
-            printf("pop_list[%2d, %3d] = ptr: 0x%08p, %02"PRIuFAST64" : %"PRIuFAST64"\n", j, i,
-                   (struct msg_t *)(popmsg_list[j][i]),
-                   popmsg_list[j][i]->dummy / (MAX_PUSH_MSG_COUNT),
-                   popmsg_list[j][i]->dummy % (MAX_PUSH_MSG_COUNT));
-        }
-        printf("\n");
-        if (j < (POP_CNT - 1)) {
-            jimi_console_readkeyln(false, true, false);
+    void free_queues() {
+        if (queues != NULL) {
+            for (uint32_t i = 0; i < kQueues; ++i)
+                delete_array<QueueTy, HeapAllocator>(queues[i], 1);
+            delete[] queues;
+            queues = NULL;
         }
     }
-    printf("\n");
-#endif
 
-    qfree(q);
+    int start() {
+        jmc_timestamp_t startTime, stopTime;
+        uint32_t i;
 
-    // if do not need "press any key to continue..." prompt, exit to function directly.
-    if (!bContinue) {
-        printf("---------------------------------------------------------------\n\n");
+        queues = new QueueTy *[kQueues];
 
-#if !defined(USE_DOUBAN_QUEUE) || (USE_DOUBAN_QUEUE == 0)
-        jimi_console_readkeyln(false, true, false);
-#else
-        jimi_console_readkeyln(false, true, false);
-#endif
+        startTime = jmc_get_timestamp();
+        for (i = 0; i < kQueues; ++i)
+            queues[i] = new_array<QueueTy, HeapAllocator>(1);
+        stopTime = jmc_get_timestamp();
+        initTime = jmc_get_interval_millisecf(stopTime - startTime);
+        return 0;
     }
-}
 
-void SingleProducerSingleConsumer_Test(bool bContinue = true)
-{
-    SingleRingQueue_t srq;
-
-    static const int kPushCnt = 1;
-    static const int kPopCnt  = 1;
-    pthread_t kids[kPushCnt + kPopCnt] = { 0 };
-    thread_arg_t *thread_arg;
-    jmc_timestamp_t startTime, stopTime;
-    jmc_timefloat_t elapsedTime = 0.0;
-    int i;
+    void produce(int /* id */) {
+        ValueEvent_t event;
+        uint32_t i, j;
 
-    printf("---------------------------------------------------------------\n");
-    printf("(One Producer + One Consumer) SingleRingQueue test:\n");
-    printf("---------------------------------------------------------------\n");
+        for (i = 0; i < kQueues; ++i) {
+            for (j = 0; j < kCapacity; ++j) {
+                event.setValue((uint64_t)j);
+                queues[i]->push(event);
+            }
+            for (j = 0; j < kCapacity; ++j) {
+                queues[i]->pop(event);
+                sum += event.getValue();
+            }
+        }
+    }
 
-    init_globals();
-    setaffinity(0);
+    void report(const char * name, jmc_timefloat_t elapsedTime) {
+        jmc_timestamp_t startTime, stopTime;
+        jmc_timefloat_t freeTime;
 
-    test_msg_reset();
-    pop_list_reset();
+        passTime = elapsedTime;
 
-    startTime = jmc_get_timestamp();
+        startTime = jmc_get_timestamp();
+        free_queues();
+        stopTime = jmc_get_timestamp();
+        freeTime = jmc_get_interval_millisecf(stopTime - startTime);
 
-    for (i = 0; i < kPushCnt; ++i) {
-        thread_arg = (thread_arg_t *)malloc(sizeof(struct thread_arg_t));
-        thread_arg->idx = i;
-        thread_arg->funcType = FUNC_DOUBAN_Q3H;
-        thread_arg->queue = (void *)&srq;
-        RingQueue_start_thread(i, single_push_task, (void *)thread_arg, &kids[i]);
-    }
-    for (i = 0; i < kPopCnt; ++i) {
-        thread_arg = (thread_arg_t *)malloc(sizeof(struct thread_arg_t));
-        thread_arg->idx = i;
-        thread_arg->funcType = FUNC_DOUBAN_Q3H;
-        thread_arg->queue = (void *)&srq;
-        RingQueue_start_thread(i + kPushCnt, single_pop_task, (void *)thread_arg, &kids[i + kPushCnt]);
+        printf("%-24s init = %8.3f ms, pass = %8.3f ms, free = %8.3f ms, check: %s\n",
+               name, initTime, passTime, freeTime,
+               (sum == (uint64_t)kQueues * kCapacity * (kCapacity - 1) / 2) ? "OK" : "Failed");
     }
-    for (i = 0; i < (kPushCnt + kPopCnt); ++i)
-        pthread_join(kids[i], NULL);
+};
 
-    stopTime = jmc_get_timestamp();
-    elapsedTime += jmc_get_interval_millisecf(stopTime - startTime);
+void ArenaQueues_Test()
+{
+    static const uint32_t kQueues = 256;
+    static const uint32_t kQueueCapacity = 1024;
 
-#if defined(DISPLAY_EXTRA_RESULT) && (DISPLAY_EXTRA_RESULT != 0)
-  #if defined(__clang__) || defined(__CLANG__) || defined(__APPLE__) || defined(__FreeBSD__)
-    printf("\n");
-    printf("push total: %u + %u\n", MAX_MSG_CNT, push_fail_total);
-    printf("push cycles/msg: %u\n", (uint32_t)(push_cycles / MAX_MSG_CNT));
-    printf("pop  total: %u + %u\n", pop_total, pop_fail_total);
-    if (pop_total == 0)
-        printf("pop  cycles/msg: %u\n", 0UL);
-    else
-        printf("pop  cycles/msg: %u\n", (uint32_t)(pop_cycles / pop_total));
-  #else
-    printf("\n");
-    printf("push total: %u + %u\n", MAX_MSG_CNT, push_fail_total);
-    printf("push cycles/msg: %"PRIuFAST64"\n", push_cycles / MAX_MSG_CNT);
-    printf("pop  total: %u + %u\n", pop_total, pop_fail_total);
-    if (pop_total == 0)
-        printf("pop  cycles/msg: %"PRIuFAST64"\n", 0ULL);
-    else
-        printf("pop  cycles/msg: %"PRIuFAST64"\n", pop_cycles / pop_total);
-  #endif
-#endif  /* DISPLAY_EXTRA_RESULT */
+    typedef ArenaAllocator<0>   QueueArena;
 
-    printf("\n");
-    printf("time elapsed: %9.3f ms, ", elapsedTime);
-    if (elapsedTime != 0.0)
-        printf("throughput: %u ops/sec\n", (uint32_t)((MAX_MSG_CNT * 1000.0) / elapsedTime));
-    else
-        printf("throughput: %u ops/sec\n", 0U);
-    printf("\n");
+    typedef SingleRingQueue<ValueEvent_t, uint32_t, kQueueCapacity, 1, HeapAllocator>  HeapQueue;
+    typedef SingleRingQueue<ValueEvent_t, uint32_t, kQueueCapacity, 1, QueueArena>     ArenaQueue;
 
-    disruptor_pop_list_verify();
+    printf("---------------------------------------------------------------\n");
+    printf("Arena allocation test (%u x SingleRingQueue, capacity = %u):\n", kQueues, kQueueCapacity);
+    printf("---------------------------------------------------------------\n\n");
 
-    // if do not need "press any key to continue..." prompt, exit to function directly.
-    if (!bContinue) {
-        printf("---------------------------------------------------------------\n\n");
+    Harness_Run("HeapAllocator", new ArenaQueuesTest<HeapQueue>(kQueues));
 
-#if !defined(USE_DOUBAN_QUEUE) || (USE_DOUBAN_QUEUE == 0)
-        jimi_console_readkeyln(false, true, false);
-#else
-        jimi_console_readkeyln(false, true, false);
-#endif
+    /* ÿе entries  8 KB,  cache line , arena п϶ */
+    if (QueueArena::init((size_t)kQueues * sizeof(ValueEvent_t) * kQueueCapacity) == 0) {
+        Harness_Run("ArenaAllocator", new ArenaQueuesTest<ArenaQueue>(kQueues));
+        printf("\narena: used = %" PRIuPTR " / %" PRIuPTR " bytes\n",
+               (uintptr_t)QueueArena::used(), (uintptr_t)QueueArena::size());
+        QueueArena::release();
+    }
+    else {
+        printf("ArenaAllocator: init() failed.\n");
     }
+    printf("\n");
 }
 
 void SerialRingQueue_Test()
@@ -4152,11 +7027,81 @@ int main(int argn, char * argv[])
     // , ٶȿ, ȶ, RingQueue.spin2_push().
     RingQueue_Test(FUNC_RINGQUEUE_SPIN2_PUSH, true);
 
+    // Vyukov н MPMC , ÿλԼ, MpmcRingQueue.push().
+    RingQueue_Test(FUNC_MPMC_RINGQUEUE, true);
+
+    // ޽ MPMC , ɶζӶ, LinkedRingQueue.push().
+    RingQueue_Test(FUNC_LINKED_RINGQUEUE, true);
+
+    // PUSH_CNT x POP_CNT  SingleRingQueue ɵ, ÿ - һͨ, MeshRingQueue.push().
+    RingQueue_Test(FUNC_MESH_RINGQUEUE, true);
+
     // C++  Disruptor ( + )ʵַ.
     RingQueue_Test(FUNC_DISRUPTOR_RINGQUEUE, true);
 
     // C++  Disruptor ( + )ʵַ.
-    RingQueue_Test(FUNC_DISRUPTOR_RINGQUEUE_EX, bContinue);
+    RingQueue_Test(FUNC_DISRUPTOR_RINGQUEUE_EX, true);
+
+    // C++  Disruptor, /, DisruptorRingQueue.push_n().
+    DisruptorRingQueue_BatchTest(true);
+
+    // C++  Disruptor, , DisruptorRingQueue.drain().
+    RingQueue_Test(FUNC_DISRUPTOR_RINGQUEUE_DRAIN, bContinue);
+
+    // C++  Disruptor,  (Producers = 1) Ͷߵ/Ա.
+    DisruptorSingleProducer_Test();
+
+    // C++  Disruptor,  +  (Consumers = 1), Աȶߵ·.
+    DisruptorSingleConsumer_Test();
+
+    // C++  Disruptor, 1  16 , ԱȹĺÿԼ gating sequence .
+    DisruptorProducerScaling_Test();
+
+    // C++  Disruptor, 2  16 , Ա CAS ѭ fetch-and-add 뷽ʽ.
+    DisruptorClaimStrategy_Test();
+
+    // C++  Disruptor, getHighestPublishedSequence() ɨ SIMD ɨĶԱ.
+    DisruptorSimdScan_Test();
+
+    // C++  Disruptor, ༶ˮ (), ׶ԭشͬһλ.
+    DisruptorPipeline_Test();
+
+    // C++  Disruptor, 㲥ģʽ, ÿ鶼еϢ (1  3 ·ȳ).
+    DisruptorBroadcast_Test();
+
+    // 256 ֽڵĴϢ, Աȿԭضд (claim/commit, peek/release).
+    ZeroCopy_Test();
+
+#if defined(JIMI_HAS_CXX11_MOVE) && (JIMI_HAS_CXX11_MOVE != 0)
+    //  std::string Ϣ, Աȿ, ƶԭعڴ.
+    MoveSemantics_Test();
+#endif
+
+    // C++  Disruptor,  WaitStrategy Ļӳٺ CPU ռ.
+    DisruptorWaitStrategy_Test();
+
+    // пкһϢĻӳ, Ա jimi_sleep(1) ѯ futex .
+    IdleWakeup_Test();
+
+    // ÿ worker һ Chase-Lev ȡ deque, 1  8  worker  fork-join ( fib).
+    WorkStealing_Test();
+
+    // ̺߳ (ڴ ShmRingQueue) ֮ ping-pong ӳ.
+    ShmPingPong_Test();
+
+#if defined(USE_JOURNAL_TEST) && (USE_JOURNAL_TEST != 0)
+    // 洢Ϊ mmap ļ־, Աڴ Disruptor, tmpfs ͱشϵ.
+    Journal_Test();
+#endif
+
+    // 2^22 λĴ, ԱͨĶڴʹҳ (Ԥȱҳ, mlock) ĵһʱ dTLB ȱʧ.
+    LargeRing_Test();
+
+    // , ߺ ring ڴͬͬ NUMA ڵ (mbind, first-touch, interleave).
+    NumaPlacement_Test();
+
+    // 256 С, ԱÿиԴӶϷʹͬһ arena ڴг.
+    ArenaQueues_Test();
 
     // RingQueue.spin3_push().
     //RingQueue_Test(FUNC_RINGQUEUE_SPIN3_PUSH, bContinue);
@@ -11,6 +11,7 @@
 #elif defined(__linux__) || defined(__GNUC__)
 #include <unistd.h>     // For usleep()
 #include <sched.h>      // For sched_yield()
+#include <time.h>       // For nanosleep()
 #endif  /* __MINGW32__ */
 
 #if defined(_MSC_VER) || defined(__INTEL_COMPILER)
@@ -38,6 +39,11 @@ void jimi_wsleep(unsigned int millisec)
     Sleep(millisec);
 }
 
+void jimi_nsleep(unsigned int nanosec)
+{
+    Sleep((nanosec + 999999) / 1000000);
+}
+
 int jimi_yield()
 {
     /* On success, SwitchToThread() returns 1.  On error, 0 is returned. */
@@ -51,6 +57,19 @@ void jimi_sleep(unsigned int millisec)
     usleep(millisec * 1000);
 }
 
+void jimi_usleep(unsigned int usec)
+{
+    usleep(usec);
+}
+
+void jimi_nsleep(unsigned int nanosec)
+{
+    struct timespec ts;
+    ts.tv_sec  = nanosec / 1000000000U;
+    ts.tv_nsec = nanosec % 1000000000U;
+    nanosleep(&ts, NULL);
+}
+
 void jimi_wsleep(unsigned int millisec)
 {
 #if 0
@@ -96,6 +115,11 @@ void jimi_wsleep(unsigned int millisec)
     Sleep(millisec);
 }
 
+void jimi_nsleep(unsigned int nanosec)
+{
+    Sleep((nanosec + 999999) / 1000000);
+}
+
 ///
 /// MSDN: SwitchToThread
 /// See: http://msdn.microsoft.com/en-us/library/windows/desktop/ms686352%28v=vs.85%29.aspx
@@ -139,6 +163,11 @@ void jimi_wsleep(unsigned int millisec)
     jimi_sleep(millisec);
 }
 
+void jimi_nsleep(unsigned int nanosec)
+{
+    jimi_sleep((nanosec + 999999) / 1000000);
+}
+
 int jimi_yield()
 {
     // Not implemented